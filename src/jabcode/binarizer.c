@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "jabcode.h"
+#include "scratch.h"
 #include <math.h>
 
 #define BLOCK_SIZE_POWER	5
@@ -346,10 +347,11 @@ void calculateBlackPoints(jab_bitmap* bitmap, jab_int32 channel, jab_int32 sub_w
 }
 
 /**
- * @brief Filter out noises in binary bitmap
+ * @brief Filter out noises in binary bitmap using a caller provided buffer
  * @param binary the binarized bitmap
+ * @param tmp the temporary buffer holding at least width*height bytes
 */
-void filterBinary(jab_bitmap* binary)
+void filterBinaryWithBuffer(jab_bitmap* binary, jab_byte* tmp)
 {
 	jab_int32 width = binary->width;
 	jab_int32 height= binary->height;
@@ -357,46 +359,54 @@ void filterBinary(jab_bitmap* binary)
 	jab_int32 filter_size = 5;
 	jab_int32 half_size = (filter_size - 1)/2;
 
-	jab_bitmap* tmp = (jab_bitmap*)malloc(sizeof(jab_bitmap) + width*height*sizeof(jab_byte));
-	if(tmp == NULL)
-	{
-		reportError("Memory allocation for temporary binary bitmap failed");
-		return;
-	}
-
 	//horizontal filtering
-	memcpy(tmp, binary, sizeof(jab_bitmap) + width*height*sizeof(jab_byte));
+	memcpy(tmp, binary->pixel, width*height*sizeof(jab_byte));
 	for(jab_int32 i=half_size; i<height-half_size; i++)
 	{
 		for(jab_int32 j=half_size; j<width-half_size; j++)
 		{
 			jab_int32 sum = 0;
-			sum += tmp->pixel[i*width + j] > 0 ? 1 : 0;
+			sum += tmp[i*width + j] > 0 ? 1 : 0;
 			for(jab_int32 k=1; k<=half_size; k++)
 			{
-				sum += tmp->pixel[i*width + (j - k)] > 0 ? 1 : 0;
-				sum += tmp->pixel[i*width + (j + k)] > 0 ? 1 : 0;
+				sum += tmp[i*width + (j - k)] > 0 ? 1 : 0;
+				sum += tmp[i*width + (j + k)] > 0 ? 1 : 0;
 			}
 			binary->pixel[i*width + j] = sum > half_size ? 255 : 0;
 		}
 	}
 	//vertical filtering
-	memcpy(tmp, binary, sizeof(jab_bitmap) + width*height*sizeof(jab_byte));
+	memcpy(tmp, binary->pixel, width*height*sizeof(jab_byte));
 	for(jab_int32 i=half_size; i<height-half_size; i++)
 	{
 		for(jab_int32 j=half_size; j<width-half_size; j++)
 		{
 			jab_int32 sum = 0;
-			sum += tmp->pixel[i*width + j] > 0 ? 1 : 0;
+			sum += tmp[i*width + j] > 0 ? 1 : 0;
 			for(jab_int32 k=1; k<=half_size; k++)
 			{
-				sum += tmp->pixel[(i - k)*width + j] > 0 ? 1 : 0;
-				sum += tmp->pixel[(i + k)*width + j] > 0 ? 1 : 0;
+				sum += tmp[(i - k)*width + j] > 0 ? 1 : 0;
+				sum += tmp[(i + k)*width + j] > 0 ? 1 : 0;
 			}
 			binary->pixel[i*width + j] = sum > half_size ? 255 : 0;
 		}
 	}
-	free(tmp);
+}
+
+/**
+ * @brief Filter out noises in binary bitmap
+ * @param binary the binarized bitmap
+*/
+void filterBinary(jab_bitmap* binary)
+{
+	jab_byte* tmp = (jab_byte*)scratchMalloc(binary->width*binary->height*sizeof(jab_byte));
+	if(tmp == NULL)
+	{
+		reportError("Memory allocation for temporary binary bitmap failed");
+		return;
+	}
+	filterBinaryWithBuffer(binary, tmp);
+	scratchFree(tmp);
 }
 
 /**
@@ -495,6 +505,28 @@ void getHistMaxMin(jab_int32 hist[256], jab_int32* max, jab_int32* min, jab_int3
 	}
 }
 
+/**
+ * @brief Get the tables stretching the histograms of R, G and B channels
+ * @param hist the histograms of R, G and B channels
+ * @param table the stretched value of each channel value
+*/
+void getBalanceTables(jab_int32 hist[3][256], jab_byte table[3][256])
+{
+    //threshold for the number of pixels having the max or min values
+	jab_int32 count_ths = 20;
+	for(jab_int32 c=0; c<3; c++)
+	{
+		jab_int32 max, min;
+		getHistMaxMin(hist[c], &max, &min, count_ths);
+		for(jab_int32 v=0; v<256; v++)
+		{
+			if		(v < min)	table[c][v] = 0;
+			else if (v > max)	table[c][v] = 255;
+			else 	 table[c][v] = (jab_byte)((jab_double)(v - min) / (jab_double)(max - min) * 255.0);
+		}
+	}
+}
+
 /**
  * @brief Stretch the histograms of R, G and B channels
  * @param bitmap the image
@@ -505,40 +537,213 @@ void balanceRGB(jab_bitmap* bitmap)
     jab_int32 bytes_per_row = bitmap->width * bytes_per_pixel;
 
 	//calculate max and min for each channel
-	jab_int32 max_r, max_g, max_b;
-    jab_int32 min_r, min_g, min_b;
-    jab_int32 hist_r[256], hist_g[256], hist_b[256];
-
-    getHistogram(bitmap, 0, hist_r);
-    getHistogram(bitmap, 1, hist_g);
-    getHistogram(bitmap, 2, hist_b);
-
-    //threshold for the number of pixels having the max or min values
-	jab_int32 count_ths = 20;
-    getHistMaxMin(hist_r, &max_r, &min_r, count_ths);
-    getHistMaxMin(hist_g, &max_g, &min_g, count_ths);
-    getHistMaxMin(hist_b, &max_b, &min_b, count_ths);
+    jab_int32 hist[3][256];
+    getHistogram(bitmap, 0, hist[0]);
+    getHistogram(bitmap, 1, hist[1]);
+    getHistogram(bitmap, 2, hist[2]);
+    jab_byte table[3][256];
+    getBalanceTables(hist, table);
 
 	//normalize each channel
 	for(jab_int32 i=0; i<bitmap->height; i++)
 	{
-		for(jab_int32 j=0; j<bitmap->width; j++)
+		jab_byte* pixel = bitmap->pixel + i * bytes_per_row;
+		for(jab_int32 j=0; j<bitmap->width; j++, pixel+=bytes_per_pixel)
 		{
-			jab_int32 offset = i * bytes_per_row + j * bytes_per_pixel;
-			//R channel
-			if		(bitmap->pixel[offset + 0] < min_r)	bitmap->pixel[offset + 0] = 0;
-			else if (bitmap->pixel[offset + 0] > max_r)	bitmap->pixel[offset + 0] = 255;
-			else 	 bitmap->pixel[offset + 0] = (jab_byte)((jab_double)(bitmap->pixel[offset + 0] - min_r) / (jab_double)(max_r - min_r) * 255.0);
-			//G channel
-			if		(bitmap->pixel[offset + 1] < min_g)	bitmap->pixel[offset + 1] = 0;
-			else if (bitmap->pixel[offset + 1] > max_g)	bitmap->pixel[offset + 1] = 255;
-			else 	 bitmap->pixel[offset + 1] = (jab_byte)((jab_double)(bitmap->pixel[offset + 1] - min_g) / (jab_double)(max_g - min_g) * 255.0);
-			//B channel
-			if		(bitmap->pixel[offset + 2] < min_b) bitmap->pixel[offset + 2] = 0;
-			else if	(bitmap->pixel[offset + 2] > max_b)	bitmap->pixel[offset + 2] = 255;
-			else 	 bitmap->pixel[offset + 2] = (jab_byte)((jab_double)(bitmap->pixel[offset + 2] - min_b) / (jab_double)(max_b - min_b) * 255.0);
+			pixel[0] = table[0][pixel[0]];	//R channel
+			pixel[1] = table[1][pixel[1]];	//G channel
+			pixel[2] = table[2][pixel[2]];	//B channel
+		}
+	}
+}
+
+/**
+ * @brief Get the pixel layout of a pixel format
+ * @param format the pixel format
+ * @param bytes_per_pixel the number of bytes per pixel
+ * @param offset the byte offsets of R, G, B and alpha channels in a pixel, -1 for no alpha channel
+ * @return JAB_SUCCESS | JAB_FAILURE if the format is unknown
+*/
+jab_boolean getPixelLayout(jab_pixel_format format, jab_int32* bytes_per_pixel, jab_int32 offset[4])
+{
+	switch(format)
+	{
+	case JAB_PIXEL_RGBA:
+		*bytes_per_pixel = 4; offset[0] = 0; offset[1] = 1; offset[2] = 2; offset[3] = 3;
+		return JAB_SUCCESS;
+	case JAB_PIXEL_BGRA:
+		*bytes_per_pixel = 4; offset[0] = 2; offset[1] = 1; offset[2] = 0; offset[3] = 3;
+		return JAB_SUCCESS;
+	case JAB_PIXEL_RGB:
+		*bytes_per_pixel = 3; offset[0] = 0; offset[1] = 1; offset[2] = 2; offset[3] = -1;
+		return JAB_SUCCESS;
+	case JAB_PIXEL_BGR:
+		*bytes_per_pixel = 3; offset[0] = 2; offset[1] = 1; offset[2] = 0; offset[3] = -1;
+		return JAB_SUCCESS;
+	}
+	return JAB_FAILURE;
+}
+
+/**
+ * @brief Stretch the histograms of R, G and B channels of a caller-owned image, which is left unchanged
+ * @param view the image view
+ * @param bitmap the stretched image in RGBA, with the pixel buffer for the view size
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean balanceRGBView(const jab_bitmap_view* view, jab_bitmap* bitmap)
+{
+	jab_int32 bytes_per_pixel, offset[4];
+	if(!getPixelLayout(view->format, &bytes_per_pixel, offset))
+	{
+		reportError("Unknown pixel format");
+		return JAB_FAILURE;
+	}
+	bitmap->width = view->width;
+	bitmap->height= view->height;
+	bitmap->bits_per_pixel = BITMAP_BITS_PER_PIXEL;
+	bitmap->bits_per_channel = BITMAP_BITS_PER_CHANNEL;
+	bitmap->channel_count = BITMAP_CHANNEL_COUNT;
+
+	//calculate max and min for each channel
+	jab_int32 hist[3][256];
+	memset(hist, 0, sizeof(hist));
+	for(jab_int32 i=0; i<view->height; i++)
+	{
+		const jab_byte* pixel = view->pixels + (size_t)i * view->stride;
+		for(jab_int32 j=0; j<view->width; j++, pixel+=bytes_per_pixel)
+		{
+			hist[0][pixel[offset[0]]]++;
+			hist[1][pixel[offset[1]]]++;
+			hist[2][pixel[offset[2]]]++;
+		}
+	}
+	jab_byte table[3][256];
+	getBalanceTables(hist, table);
+
+	//normalize each channel into the RGBA bitmap
+	jab_byte* dst = bitmap->pixel;
+	for(jab_int32 i=0; i<view->height; i++)
+	{
+		const jab_byte* pixel = view->pixels + (size_t)i * view->stride;
+		for(jab_int32 j=0; j<view->width; j++, pixel+=bytes_per_pixel, dst+=BITMAP_CHANNEL_COUNT)
+		{
+			dst[0] = table[0][pixel[offset[0]]];
+			dst[1] = table[1][pixel[offset[1]]];
+			dst[2] = table[2][pixel[offset[2]]];
+			dst[3] = offset[3] < 0 ? 255 : pixel[offset[3]];
 		}
 	}
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Clamp a value to the range of a byte
+ * @param value the value
+ * @return the clamped value
+*/
+jab_byte clampByte(jab_int32 value)
+{
+	return (jab_byte)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+/**
+ * @brief Convert a row of a planar YUV frame to RGBA using BT.601 coefficients in 16-bit fixed point
+ * @param yuv the YUV frame
+ * @param row the row index
+ * @param dst the RGBA row
+*/
+void convertYUVRow(const jab_yuv_view* yuv, jab_int32 row, jab_byte* dst)
+{
+	//luma scale, V to R, U to G, V to G, U to B
+	static const jab_int32 full_coef[5] = {65536, 91881, 22554, 46802, 116130};
+	static const jab_int32 video_coef[5]= {76309, 104597, 25675, 53279, 132201};
+	const jab_int32* coef = yuv->video_range ? video_coef : full_coef;
+	jab_int32 y_offset = yuv->video_range ? 16 : 0;
+
+	const jab_byte* y = yuv->planes[0] + (size_t)row * yuv->strides[0];
+	const jab_byte* u;
+	const jab_byte* v;
+	jab_int32 chroma_step;
+	switch(yuv->format)
+	{
+	case JAB_YUV_NV12:
+		u = yuv->planes[1] + (size_t)(row / 2) * yuv->strides[1];
+		v = u + 1;
+		chroma_step = 2;
+		break;
+	case JAB_YUV_NV21:
+		v = yuv->planes[1] + (size_t)(row / 2) * yuv->strides[1];
+		u = v + 1;
+		chroma_step = 2;
+		break;
+	default:
+		u = yuv->planes[1] + (size_t)(row / 2) * yuv->strides[1];
+		v = yuv->planes[2] + (size_t)(row / 2) * yuv->strides[2];
+		chroma_step = 1;
+		break;
+	}
+
+	//each chroma sample is shared by two neighboring pixels
+	jab_int32 r = 0, g = 0, b = 0;
+	for(jab_int32 j=0; j<yuv->width; j++, dst+=BITMAP_CHANNEL_COUNT)
+	{
+		if((j & 1) == 0)
+		{
+			jab_int32 cu = u[(j / 2) * chroma_step] - 128;
+			jab_int32 cv = v[(j / 2) * chroma_step] - 128;
+			r = coef[1] * cv;
+			g = -coef[2] * cu - coef[3] * cv;
+			b = coef[4] * cu;
+		}
+		jab_int32 luma = coef[0] * (y[j] - y_offset) + 32768;
+		dst[0] = clampByte((luma + r) >> 16);
+		dst[1] = clampByte((luma + g) >> 16);
+		dst[2] = clampByte((luma + b) >> 16);
+		dst[3] = 255;
+	}
+}
+
+/**
+ * @brief Convert a planar YUV frame to RGBA and stretch the histograms of R, G and B channels
+ * @param yuv the YUV frame, which is left unchanged
+ * @param bitmap the stretched image in RGBA, with the pixel buffer for the frame size
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean balanceYUVView(const jab_yuv_view* yuv, jab_bitmap* bitmap)
+{
+	bitmap->width = yuv->width;
+	bitmap->height= yuv->height;
+	bitmap->bits_per_pixel = BITMAP_BITS_PER_PIXEL;
+	bitmap->bits_per_channel = BITMAP_BITS_PER_CHANNEL;
+	bitmap->channel_count = BITMAP_CHANNEL_COUNT;
+	jab_int32 bytes_per_row = yuv->width * BITMAP_CHANNEL_COUNT;
+
+	//convert each row once into the bitmap and calculate max and min for each channel while the row is in cache
+	jab_int32 hist[3][256];
+	memset(hist, 0, sizeof(hist));
+	for(jab_int32 i=0; i<yuv->height; i++)
+	{
+		jab_byte* pixel = bitmap->pixel + (size_t)i * bytes_per_row;
+		convertYUVRow(yuv, i, pixel);
+		for(jab_int32 j=0; j<yuv->width; j++, pixel+=BITMAP_CHANNEL_COUNT)
+		{
+			hist[0][pixel[0]]++;
+			hist[1][pixel[1]]++;
+			hist[2][pixel[2]]++;
+		}
+	}
+	jab_byte table[3][256];
+	getBalanceTables(hist, table);
+
+	//normalize each channel of the converted pixels
+	jab_byte* pixel = bitmap->pixel;
+	for(jab_int32 i=0; i<yuv->width * yuv->height; i++, pixel+=BITMAP_CHANNEL_COUNT)
+	{
+		pixel[0] = table[0][pixel[0]];
+		pixel[1] = table[1][pixel[1]];
+		pixel[2] = table[2][pixel[2]];
+	}
+	return JAB_SUCCESS;
 }
 
 /**
@@ -595,22 +800,17 @@ void getMinMax(jab_byte* rgb, jab_byte* min, jab_byte* mid, jab_byte* max, jab_i
 }
 
 /**
- * @brief Binarize a color channel of a bitmap using local binarization algorithm
+ * @brief Binarize the RGB channels of a bitmap into preallocated binary bitmaps
  * @param bitmap the input bitmap
- * @param rgb the binarized RGB channels
+ * @param rgb the binarized RGB channels, each holding at least width*height pixels
  * @param blk_ths the black color thresholds for RGB channels
+ * @param tmp the temporary buffer holding at least width*height bytes | NULL to allocate one internally
  * @return JAB_SUCCESS | JAB_FAILURE
 */
-jab_boolean binarizerRGB(jab_bitmap* bitmap, jab_bitmap* rgb[3], jab_float* blk_ths)
+jab_boolean binarizeRGB(jab_bitmap* bitmap, jab_bitmap* rgb[3], jab_float* blk_ths, jab_byte* tmp)
 {
 	for(jab_int32 i=0; i<3; i++)
 	{
-		rgb[i] = (jab_bitmap*)calloc(1, sizeof(jab_bitmap) + bitmap->width*bitmap->height*sizeof(jab_byte));
-		if(rgb[i] == NULL)
-		{
-			JAB_REPORT_ERROR(("Memory allocation for binary bitmap %d failed", i))
-			return JAB_FAILURE;
-		}
 		rgb[i]->width = bitmap->width;
 		rgb[i]->height= bitmap->height;
 		rgb[i]->bits_per_channel = 8;
@@ -717,8 +917,33 @@ jab_boolean binarizerRGB(jab_bitmap* bitmap, jab_bitmap* rgb[3], jab_float* blk_
 			}
 		}
 	}
-	filterBinary(rgb[0]);
-	filterBinary(rgb[1]);
-	filterBinary(rgb[2]);
+	for(jab_int32 i=0; i<3; i++)
+	{
+		if(tmp)
+			filterBinaryWithBuffer(rgb[i], tmp);
+		else
+			filterBinary(rgb[i]);
+	}
 	return JAB_SUCCESS;
 }
+
+/**
+ * @brief Binarize a color channel of a bitmap using local binarization algorithm
+ * @param bitmap the input bitmap
+ * @param rgb the binarized RGB channels
+ * @param blk_ths the black color thresholds for RGB channels
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean binarizerRGB(jab_bitmap* bitmap, jab_bitmap* rgb[3], jab_float* blk_ths)
+{
+	for(jab_int32 i=0; i<3; i++)
+	{
+		rgb[i] = (jab_bitmap*)calloc(1, sizeof(jab_bitmap) + bitmap->width*bitmap->height*sizeof(jab_byte));
+		if(rgb[i] == NULL)
+		{
+			JAB_REPORT_ERROR(("Memory allocation for binary bitmap %d failed", i))
+			return JAB_FAILURE;
+		}
+	}
+	return binarizeRGB(bitmap, rgb, blk_ths, 0);
+}
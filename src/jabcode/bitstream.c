@@ -0,0 +1,161 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file bitstream.c
+ * @brief Packed bit sequence
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "jabcode.h"
+#include "bitstream.h"
+#include "scratch.h"
+
+/**
+ * @brief Create a bit sequence with all bits cleared
+ * @param length the number of bits
+ * @return the bit sequence | NULL if failed
+*/
+jab_bitstream* createBitstream(jab_int32 length)
+{
+	jab_bitstream* bs = (jab_bitstream*)calloc(1, sizeof(jab_bitstream) + BITSTREAM_WORD_NUMBER(length) * sizeof(jab_uint32));
+	if(bs == NULL)
+	{
+		reportError("Memory allocation for bit stream failed");
+		return NULL;
+	}
+	bs->length = length;
+	return bs;
+}
+
+/**
+ * @brief Create a bit sequence with all bits cleared in the scratch memory of the decoding running on this thread
+ * @param length the number of bits
+ * @return the bit sequence, to be freed by scratchFree | NULL if failed
+*/
+jab_bitstream* createScratchBitstream(jab_int32 length)
+{
+	jab_bitstream* bs = (jab_bitstream*)scratchCalloc(1, sizeof(jab_bitstream) + BITSTREAM_WORD_NUMBER(length) * sizeof(jab_uint32));
+	if(bs == NULL)
+	{
+		reportError("Memory allocation for bit stream failed");
+		return NULL;
+	}
+	bs->length = length;
+	return bs;
+}
+
+/**
+ * @brief Write the lower bits of a value, most significant bit first
+ * @param bs the bit sequence
+ * @param start the position of the first bit
+ * @param value the value to be written
+ * @param length the number of bits, at most 32
+*/
+void writeBits(jab_bitstream* bs, jab_int32 start, jab_uint32 value, jab_int32 length)
+{
+	if(length <= 0) return;
+	jab_int32 word = start >> 5;
+	jab_int32 shift = 64 - (start & 31) - length;
+	jab_uint64 mask = (length == 32 ? 0xFFFFFFFFULL : ((1ULL << length) - 1)) << shift;
+	jab_uint64 bits = ((jab_uint64)bs->words[word] << 32) | bs->words[word + 1];
+	bits = (bits & ~mask) | (((jab_uint64)value << shift) & mask);
+	bs->words[word] = (jab_uint32)(bits >> 32);
+	bs->words[word + 1] = (jab_uint32)bits;
+}
+
+/**
+ * @brief Read bits, most significant bit first
+ * @param bs the bit sequence
+ * @param start the position of the first bit
+ * @param length the number of bits, at most 32
+ * @param value the read value, the bits beyond the end of the sequence are read as 0
+ * @return the number of bits available
+*/
+jab_int32 readBits(const jab_bitstream* bs, jab_int32 start, jab_int32 length, jab_int32* value)
+{
+	jab_int32 n = MIN(length, bs->length - start);
+	if(n <= 0)
+	{
+		*value = 0;
+		return 0;
+	}
+	jab_int32 word = start >> 5;
+	jab_uint64 bits = ((jab_uint64)bs->words[word] << 32) | bs->words[word + 1];
+	bits >>= 64 - (start & 31) - n;
+	bits &= (1ULL << n) - 1;
+	*value = (jab_int32)(bits << (length - n));
+	return n;
+}
+
+/**
+ * @brief Read bits into the most significant bits of a word
+ * @param bs the bit sequence
+ * @param start the position of the first bit
+ * @param length the number of bits, at most 32
+ * @return the read bits, followed by cleared bits
+*/
+jab_uint32 readWord(const jab_bitstream* bs, jab_int32 start, jab_int32 length)
+{
+	jab_int32 value;
+	readBits(bs, start, length, &value);
+	return length < 32 ? (jab_uint32)value << (32 - length) : (jab_uint32)value;
+}
+
+/**
+ * @brief Copy bits word by word, the source and the destination may overlap if the destination does not follow the source
+ * @param dst the destination sequence
+ * @param dst_start the position of the first bit in the destination
+ * @param src the source sequence
+ * @param src_start the position of the first bit in the source
+ * @param length the number of bits
+*/
+void copyBits(jab_bitstream* dst, jab_int32 dst_start, const jab_bitstream* src, jab_int32 src_start, jab_int32 length)
+{
+	for(jab_int32 i=0; i<length; i+=32)
+	{
+		jab_int32 n = MIN(32, length - i);
+		jab_int32 value;
+		readBits(src, src_start + i, n, &value);
+		writeBits(dst, dst_start + i, (jab_uint32)value, n);
+	}
+}
+
+/**
+ * @brief Get the parity of a word
+ * @param word the word
+ * @return 1 if an odd number of bits is set | 0
+*/
+jab_int32 getWordParity(jab_uint32 word)
+{
+	word ^= word >> 16;
+	word ^= word >> 8;
+	word ^= word >> 4;
+	return (0x6996 >> (word & 0x0F)) & 1;
+}
+
+/**
+ * @brief Unpack bits from the bit sequence into one bit per byte
+ * @param bs the bit sequence
+ * @param start the position of the first bit in the sequence
+ * @param bits the output bits
+ * @param length the number of bits
+*/
+void unpackBits(const jab_bitstream* bs, jab_int32 start, jab_char* bits, jab_int32 length)
+{
+	for(jab_int32 i=0; i<length; i+=32)
+	{
+		jab_int32 value;
+		jab_int32 n = readBits(bs, start + i, MIN(32, length - i), &value);
+		for(jab_int32 j=0; j<n; j++)
+		{
+			bits[i + j] = (jab_char)(((jab_uint32)value >> (MIN(32, length - i) - 1 - j)) & 1);
+		}
+	}
+}
@@ -0,0 +1,42 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file bitstream.h
+ * @brief Packed bit sequence header
+ */
+
+#ifndef JABCODE_BITSTREAM_H
+#define JABCODE_BITSTREAM_H
+
+#define BITSTREAM_WORD_NUMBER(length)	(((length) + 31) / 32 + 1)	//one spare word allows reading across the last word boundary
+
+#define GET_BIT(bs, i)		(((bs)->words[(i) >> 5] >> (31 - ((i) & 31))) & 1)
+#define SET_BIT(bs, i)		((bs)->words[(i) >> 5] |= 0x80000000U >> ((i) & 31))
+#define CLEAR_BIT(bs, i)	((bs)->words[(i) >> 5] &= ~(0x80000000U >> ((i) & 31)))
+#define FLIP_BIT(bs, i)		((bs)->words[(i) >> 5] ^= 0x80000000U >> ((i) & 31))
+#define PUT_BIT(bs, i, b)	((b) ? SET_BIT(bs, i) : CLEAR_BIT(bs, i))
+
+/**
+ * @brief Packed bit sequence, the bits are stored from the most significant bit of each word on
+*/
+typedef struct jab_bitstream {
+	jab_int32	length;
+	jab_uint32	words[];
+}jab_bitstream;
+
+extern jab_bitstream* createBitstream(jab_int32 length);
+extern jab_bitstream* createScratchBitstream(jab_int32 length);
+extern void writeBits(jab_bitstream* bs, jab_int32 start, jab_uint32 value, jab_int32 length);
+extern jab_int32 readBits(const jab_bitstream* bs, jab_int32 start, jab_int32 length, jab_int32* value);
+extern jab_uint32 readWord(const jab_bitstream* bs, jab_int32 start, jab_int32 length);
+extern void copyBits(jab_bitstream* dst, jab_int32 dst_start, const jab_bitstream* src, jab_int32 src_start, jab_int32 length);
+extern jab_int32 getWordParity(jab_uint32 word);
+extern void unpackBits(const jab_bitstream* bs, jab_int32 start, jab_char* bits, jab_int32 length);
+
+#endif
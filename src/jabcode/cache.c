@@ -0,0 +1,106 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file cache.c
+ * @brief Keyed cache of immutable objects
+ */
+
+#include <stdlib.h>
+#include "jabcode.h"
+#include "cache.h"
+
+/**
+ * @brief Find a cached object, the cache must be locked
+ * @param cache the cache
+ * @param key the key of the object
+ * @return the cached object | NULL if not cached
+*/
+jab_cache_entry* findCacheEntry(jab_cache* cache, const void* key)
+{
+	for(jab_cache_entry* entry = cache->head; entry; entry = entry->next)
+	{
+		if(cache->match(entry, key))
+			return entry;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Get an object from the cache, or create it if not cached yet.
+ * The object is created without holding the lock, so that threads creating different objects do not wait for each other.
+ * @param cache the cache
+ * @param key the key of the object
+ * @return the immutable object, to be released by releaseCacheEntry | NULL if failed
+*/
+const jab_cache_entry* getCacheEntry(jab_cache* cache, const void* key)
+{
+	pthread_mutex_lock(&cache->lock);
+	jab_cache_entry* entry = findCacheEntry(cache, key);
+	pthread_mutex_unlock(&cache->lock);
+	if(entry)
+		return entry;
+
+	jab_cache_entry* created = cache->create(key);
+	if(created == NULL)
+		return NULL;
+	created->cached = 0;
+	created->next = NULL;
+
+	pthread_mutex_lock(&cache->lock);
+	//another thread may have cached the same object in the meantime
+	entry = findCacheEntry(cache, key);
+	if(entry == NULL && cache->size < cache->capacity)
+	{
+		created->cached = 1;
+		created->next = cache->head;
+		cache->head = created;
+		cache->size++;
+	}
+	pthread_mutex_unlock(&cache->lock);
+	if(entry)
+	{
+		cache->destroy(created);
+		return entry;
+	}
+	//if the cache is full, the object is owned by the caller until it is released
+	return created;
+}
+
+/**
+ * @brief Release an object obtained from getCacheEntry
+ * @param cache the cache
+ * @param entry the object
+*/
+void releaseCacheEntry(jab_cache* cache, const jab_cache_entry* entry)
+{
+	if(entry && !entry->cached)
+	{
+		cache->destroy((jab_cache_entry*)entry);
+	}
+}
+
+/**
+ * @brief Free all cached objects
+ * @param cache the cache
+ * @note No object obtained from the cache may be in use
+*/
+void clearCache(jab_cache* cache)
+{
+	pthread_mutex_lock(&cache->lock);
+	jab_cache_entry* entry = cache->head;
+	while(entry)
+	{
+		jab_cache_entry* next = entry->next;
+		cache->destroy(entry);
+		entry = next;
+	}
+	cache->head = NULL;
+	cache->size = 0;
+	pthread_mutex_unlock(&cache->lock);
+}
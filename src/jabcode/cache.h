@@ -0,0 +1,46 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file cache.h
+ * @brief Keyed cache of immutable objects header
+ */
+
+#ifndef JABCODE_CACHE_H
+#define JABCODE_CACHE_H
+
+#include <pthread.h>
+
+#define JAB_CACHE_INITIALIZER(capacity, match, create, destroy)	{NULL, 0, capacity, PTHREAD_MUTEX_INITIALIZER, match, create, destroy}
+
+/**
+ * @brief Cache entry, the first member of each cached object
+*/
+typedef struct jab_cache_entry {
+	jab_boolean		cached;			//set if the object is owned by the cache, otherwise by the caller
+	struct jab_cache_entry* next;
+}jab_cache_entry;
+
+/**
+ * @brief Thread-safe cache of immutable objects, looked up by a key
+*/
+typedef struct {
+	jab_cache_entry* head;
+	jab_int32		size;
+	jab_int32		capacity;		//the maximal number of cached objects
+	pthread_mutex_t	lock;
+	jab_boolean		(*match)(const jab_cache_entry* entry, const void* key);
+	jab_cache_entry* (*create)(const void* key);
+	void			(*destroy)(jab_cache_entry* entry);
+}jab_cache;
+
+extern const jab_cache_entry* getCacheEntry(jab_cache* cache, const void* key);
+extern void releaseCacheEntry(jab_cache* cache, const jab_cache_entry* entry);
+extern void clearCache(jab_cache* cache);
+
+#endif
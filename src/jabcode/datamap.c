@@ -0,0 +1,305 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file datamap.c
+ * @brief Data module layout
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "jabcode.h"
+#include "encoder.h"
+#include "decoder.h"
+#include "detector.h"
+#include "datamap.h"
+
+/**
+ * @brief Mark the positions of finder patterns and alignment patterns in the data map
+ * @param data_map the data module positions
+ * @param width the width of the data map
+ * @param height the height of the data map
+ * @param type the symbol type, 0: master, 1: slave
+*/
+void fillDataMap(jab_byte* data_map, jab_int32 width, jab_int32 height, jab_int32 type)
+{
+	jab_int32 side_ver_x_index = SIZE2VERSION(width) - 1;
+	jab_int32 side_ver_y_index = SIZE2VERSION(height) - 1;
+    jab_int32 number_of_ap_x = jab_ap_num[side_ver_x_index];
+    jab_int32 number_of_ap_y = jab_ap_num[side_ver_y_index];
+    for(jab_int32 i=0; i<number_of_ap_y; i++)
+    {
+		for(jab_int32 j=0; j<number_of_ap_x; j++)
+		{
+			//the center coordinate
+			jab_int32 x_offset = jab_ap_pos[side_ver_x_index][j] - 1;
+            jab_int32 y_offset = jab_ap_pos[side_ver_y_index][i] - 1;
+			//the cross
+			data_map[y_offset 		* width + x_offset]		  =
+			data_map[y_offset		* width + (x_offset - 1)] =
+			data_map[y_offset		* width + (x_offset + 1)] =
+			data_map[(y_offset - 1) * width + x_offset] 	  =
+			data_map[(y_offset + 1) * width + x_offset] 	  = 1;
+
+			//the diagonal modules
+			if(i == 0 && (j == 0 || j == number_of_ap_x - 1))	//at finder pattern 0 and 1 positions
+			{
+				data_map[(y_offset - 1) * width + (x_offset - 1)] =
+				data_map[(y_offset + 1) * width + (x_offset + 1)] = 1;
+				if(type == 0)	//master symbol
+				{
+					data_map[(y_offset - 2) * width + (x_offset - 2)] =
+					data_map[(y_offset - 2) * width + (x_offset - 1)] =
+					data_map[(y_offset - 2) * width +  x_offset] 	  =
+					data_map[(y_offset - 1) * width + (x_offset - 2)] =
+					data_map[ y_offset		* width + (x_offset - 2)] = 1;
+
+					data_map[(y_offset + 2) * width + (x_offset + 2)] =
+					data_map[(y_offset + 2) * width + (x_offset + 1)] =
+					data_map[(y_offset + 2) * width +  x_offset] 	  =
+					data_map[(y_offset + 1) * width + (x_offset + 2)] =
+					data_map[ y_offset		* width + (x_offset + 2)] = 1;
+				}
+			}
+			else if(i == number_of_ap_y - 1 && (j == 0 || j == number_of_ap_x - 1))	//at finder pattern 2 and 3 positions
+			{
+				data_map[(y_offset - 1) * width + (x_offset + 1)] =
+				data_map[(y_offset + 1) * width + (x_offset - 1)] = 1;
+				if(type == 0) 	//master symbol
+				{
+					data_map[(y_offset - 2) * width + (x_offset + 2)] =
+					data_map[(y_offset - 2) * width + (x_offset + 1)] =
+					data_map[(y_offset - 2) * width +  x_offset] 	  =
+					data_map[(y_offset - 1) * width + (x_offset + 2)] =
+					data_map[ y_offset		* width + (x_offset + 2)] = 1;
+
+					data_map[(y_offset + 2) * width + (x_offset - 2)] =
+					data_map[(y_offset + 2) * width + (x_offset - 1)] =
+					data_map[(y_offset + 2) * width +  x_offset] 	  =
+					data_map[(y_offset + 1) * width + (x_offset - 2)] =
+					data_map[ y_offset		* width + (x_offset - 2)] = 1;
+				}
+			}
+			else	//at other positions
+			{
+				//even row, even column / odd row, odd column
+				if( (i % 2 == 0 && j % 2 == 0) || (i % 2 == 1 && j % 2 == 1))
+				{
+					data_map[(y_offset - 1) * width + (x_offset - 1)] =
+					data_map[(y_offset + 1) * width + (x_offset + 1)] = 1;
+				}
+				//odd row, even column / even row, old column
+				else
+				{
+					data_map[(y_offset - 1) * width + (x_offset + 1)] =
+					data_map[(y_offset + 1) * width + (x_offset - 1)] = 1;
+				}
+			}
+		}
+    }
+}
+
+/**
+ * @brief Mark the positions of metadata and color palette modules in the data map
+ * @param data_map the data module positions
+ * @param width the width of the data map
+ * @param height the height of the data map
+ * @param type the symbol type, 0: master, 1: slave
+ * @param color_number the number of module colors
+ * @param metadata_module_number the number of metadata and palette modules in master symbol
+*/
+void fillMetadataMap(jab_byte* data_map, jab_int32 width, jab_int32 height, jab_int32 type, jab_int32 color_number, jab_int32 metadata_module_number)
+{
+	if(type == 0)
+	{
+		//metadata and color palette modules in master symbol are placed along the metadata module path
+		jab_int32 x = MASTER_METADATA_X;
+		jab_int32 y = MASTER_METADATA_Y;
+		for(jab_int32 i=0; i<metadata_module_number; i++)
+		{
+			data_map[y * width + x] = 1;
+			getNextMetadataModuleInMaster(height, width, i+1, &x, &y);
+		}
+	}
+	else
+	{
+		//color palette modules in slave symbol
+		for(jab_int32 i=2; i<MIN(color_number, 64); i++)
+		{
+			jab_vector2d p = slave_palette_position[i-2];
+			data_map[p.y * width + p.x] = 1;
+			data_map[p.x * width + (width - 1 - p.y)] = 1;
+			data_map[(height - 1 - p.y) * width + (width - 1 - p.x)] = 1;
+			data_map[(height - 1 - p.x) * width + p.y] = 1;
+		}
+	}
+}
+
+/**
+ * @brief Free a symbol layout
+ * @param layout the symbol layout
+*/
+void freeSymbolLayout(jab_symbol_layout* layout)
+{
+	if(layout == NULL) return;
+	free(layout->data_bits);
+	free(layout->modules);
+	free(layout->palette_index);
+	free(layout->row_order);
+	free(layout);
+}
+
+/**
+ * @brief Create the data module layout of a symbol
+ * @param side_size the symbol size in module
+ * @param type the symbol type, 0: master, 1: slave
+ * @param color_number the number of module colors
+ * @param metadata_module_number the number of metadata and palette modules in master symbol
+ * @return the symbol layout | NULL if failed
+*/
+jab_symbol_layout* createSymbolLayout(jab_vector2d side_size, jab_int32 type, jab_int32 color_number, jab_int32 metadata_module_number)
+{
+	jab_int32 width = side_size.x;
+	jab_int32 height= side_size.y;
+	jab_symbol_layout* layout = (jab_symbol_layout*)calloc(1, sizeof(jab_symbol_layout));
+	if(layout == NULL)
+	{
+		reportError("Memory allocation for symbol layout failed");
+		return NULL;
+	}
+	layout->side_size = side_size;
+	layout->type = type;
+	layout->color_number = color_number;
+	layout->metadata_module_number = metadata_module_number;
+	layout->data_bits = (jab_uint32*)calloc((width * height + 31) / 32, sizeof(jab_uint32));
+	layout->modules = (jab_vector2d*)malloc(width * height * sizeof(jab_vector2d));
+	layout->palette_index = (jab_byte*)malloc(width * height * sizeof(jab_byte));
+	layout->row_order = (jab_int32*)malloc(width * height * sizeof(jab_int32));
+	jab_byte* data_map = (jab_byte*)calloc(width * height, sizeof(jab_byte));
+	jab_int32* placement = (jab_int32*)malloc(width * height * sizeof(jab_int32));
+	if(layout->data_bits == NULL || layout->modules == NULL || layout->palette_index == NULL || layout->row_order == NULL ||
+	   data_map == NULL || placement == NULL)
+	{
+		reportError("Memory allocation for symbol layout failed");
+		free(data_map);
+		free(placement);
+		freeSymbolLayout(layout);
+		return NULL;
+	}
+	DECODE_STATS_ADD(bytes_allocated, (jab_int64)(sizeof(jab_symbol_layout) + (width * height + 31) / 32 * sizeof(jab_uint32) +
+					 width * height * (sizeof(jab_vector2d) + 2 * sizeof(jab_byte) + 2 * sizeof(jab_int32))))
+
+	fillDataMap(data_map, width, height, type);
+	fillMetadataMap(data_map, width, height, type, color_number, metadata_module_number);
+
+	//data modules are placed column by column
+	jab_int32 count = 0;
+	for(jab_int32 x=0; x<width; x++)
+	{
+		for(jab_int32 y=0; y<height; y++)
+		{
+			if(data_map[y * width + x] == 0)
+			{
+				layout->modules[count].x = x;
+				layout->modules[count].y = y;
+				layout->palette_index[count] = (jab_byte)getNearestPalette(width, height, x, y);
+				placement[y * width + x] = count;
+				count++;
+				layout->data_bits[(y * width + x) >> 5] |= (jab_uint32)1 << ((y * width + x) & 31);
+			}
+		}
+	}
+	layout->data_module_number = count;
+
+	//the permutation from memory order to placement order
+	count = 0;
+	for(jab_int32 i=0; i<width * height; i++)
+	{
+		if(data_map[i] == 0)
+		{
+			layout->row_order[count++] = placement[i];
+		}
+	}
+	free(data_map);
+	free(placement);
+	return layout;
+}
+
+/**
+ * @brief Check if a cached symbol layout has the parameters of a key layout
+ * @param entry the cached layout
+ * @param key the layout holding only the parameters
+ * @return JAB_SUCCESS if matched | JAB_FAILURE
+*/
+jab_boolean matchSymbolLayout(const jab_cache_entry* entry, const void* key)
+{
+	const jab_symbol_layout* layout = (const jab_symbol_layout*)entry;
+	const jab_symbol_layout* params = (const jab_symbol_layout*)key;
+	return layout->side_size.x == params->side_size.x && layout->side_size.y == params->side_size.y && layout->type == params->type &&
+		   layout->color_number == params->color_number && layout->metadata_module_number == params->metadata_module_number;
+}
+
+/**
+ * @brief Create the symbol layout of a key layout for the cache
+ * @param key the layout holding only the parameters
+ * @return the cache entry of the layout | NULL if failed
+*/
+jab_cache_entry* createCachedSymbolLayout(const void* key)
+{
+	const jab_symbol_layout* params = (const jab_symbol_layout*)key;
+	return (jab_cache_entry*)createSymbolLayout(params->side_size, params->type, params->color_number, params->metadata_module_number);
+}
+
+/**
+ * @brief Free a symbol layout evicted from or not taken by the cache
+ * @param entry the cache entry of the layout
+*/
+void destroyCachedSymbolLayout(jab_cache_entry* entry)
+{
+	freeSymbolLayout((jab_symbol_layout*)entry);
+}
+
+static jab_cache layout_cache = JAB_CACHE_INITIALIZER(MAX_CACHED_LAYOUTS, matchSymbolLayout, createCachedSymbolLayout, destroyCachedSymbolLayout);
+
+/**
+ * @brief Get the data module layout of a symbol from the cache, or create it if not cached yet
+ * @param side_size the symbol size in module
+ * @param type the symbol type, 0: master, 1: slave
+ * @param color_number the number of module colors
+ * @param metadata_module_number the number of metadata and palette modules in master symbol
+ * @return the immutable symbol layout, to be released by releaseSymbolLayout | NULL if failed
+*/
+const jab_symbol_layout* getSymbolLayout(jab_vector2d side_size, jab_int32 type, jab_int32 color_number, jab_int32 metadata_module_number)
+{
+	//only the parameters affecting the layout are used as the key
+	jab_symbol_layout key;
+	memset(&key, 0, sizeof(key));
+	key.side_size = side_size;
+	key.type = type;
+	key.color_number = (type == 0) ? 0 : color_number;
+	key.metadata_module_number = (type == 0) ? metadata_module_number : 0;
+	return (const jab_symbol_layout*)getCacheEntry(&layout_cache, &key);
+}
+
+/**
+ * @brief Release a symbol layout obtained from getSymbolLayout
+ * @param layout the symbol layout
+*/
+void releaseSymbolLayout(const jab_symbol_layout* layout)
+{
+	releaseCacheEntry(&layout_cache, (const jab_cache_entry*)layout);
+}
+
+/**
+ * @brief Free all cached symbol layouts
+ * @note No layout obtained from the cache may be in use
+*/
+void clearSymbolLayoutCache(void)
+{
+	clearCache(&layout_cache);
+}
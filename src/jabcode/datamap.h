@@ -0,0 +1,43 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file datamap.h
+ * @brief Data module layout header
+ */
+
+#ifndef JABCODE_DATAMAP_H
+#define JABCODE_DATAMAP_H
+
+#include "cache.h"
+
+#define MAX_CACHED_LAYOUTS	128		//the maximal number of cached symbol layouts
+
+#define IS_DATA_MODULE(layout, x, y)	(((layout)->data_bits[((y) * (layout)->side_size.x + (x)) >> 5] >> (((y) * (layout)->side_size.x + (x)) & 31)) & 1)
+
+/**
+ * @brief Data module layout of a symbol, which only depends on the symbol geometry
+*/
+typedef struct jab_symbol_layout {
+	jab_cache_entry	entry;						//the cache entry, which must be the first member
+	jab_vector2d	side_size;
+	jab_int32		type;						//0: master, 1: slave
+	jab_int32		color_number;				//the number of module colors, only relevant for slave symbols
+	jab_int32		metadata_module_number;		//the number of metadata and palette modules, only relevant for master symbols
+	jab_int32		data_module_number;
+	jab_uint32*		data_bits;					//bit-packed data map in row-major order, a set bit marks a data module
+	jab_vector2d*	modules;					//the coordinates of the data modules in placement order
+	jab_byte*		palette_index;				//the index of the nearest color palette of the data modules in placement order
+	jab_int32*		row_order;					//the placement indexes of the data modules in row-major order
+}jab_symbol_layout;
+
+extern const jab_symbol_layout* getSymbolLayout(jab_vector2d side_size, jab_int32 type, jab_int32 color_number, jab_int32 metadata_module_number);
+extern void releaseSymbolLayout(const jab_symbol_layout* layout);
+extern void clearSymbolLayoutCache(void);
+
+#endif
@@ -20,6 +20,9 @@
 #include "decoder.h"
 #include "ldpc.h"
 #include "encoder.h"
+#include "datamap.h"
+#include "bitstream.h"
+#include "scratch.h"
 
 /**
  * @brief Copy 16-color sub-blocks of 64-color palette into 32-color blocks of 256-color palette and interpolate into 32 colors
@@ -193,18 +196,17 @@ void getColorPalettePosInFP(jab_int32 p_index, jab_int32 matrix_width, jab_int32
  * @brief Read the color palettes in master symbol
  * @param matrix the symbol matrix
  * @param symbol the master symbol
- * @param data_map the data module positions
  * @param module_count the start module index
  * @param x the x coordinate of the start module
  * @param y the y coordinate of the start module
  * @return JAB_SUCCESS | FATAL_ERROR
 */
-jab_int32 readColorPaletteInMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte* data_map, jab_int32* module_count, jab_int32* x, jab_int32* y)
+jab_int32 readColorPaletteInMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_int32* module_count, jab_int32* x, jab_int32* y)
 {
 	//allocate buffer for palette
 	jab_int32 color_number = (jab_int32)pow(2, symbol->metadata.Nc + 1);
-	free(symbol->palette);
-	symbol->palette = (jab_byte*)malloc(color_number * sizeof(jab_byte) * 3 * COLOR_PALETTE_NUMBER);
+	scratchFree(symbol->palette);
+	symbol->palette = (jab_byte*)scratchMalloc(color_number * sizeof(jab_byte) * 3 * COLOR_PALETTE_NUMBER);
 	if(symbol->palette == NULL)
 	{
 		reportError("Memory allocation for master palette failed");
@@ -232,8 +234,6 @@ jab_int32 readColorPaletteInMaster(jab_bitmap* matrix, jab_decoded_symbol* symbo
 		//color palette 0
 		color_index = master_palette_placement_index[0][color_counter] % color_number; //for 4-color and 8-color symbols
 		writeColorPalette(matrix, symbol, 0, color_index, *x, *y);
-		//set data map
-		data_map[(*y) * matrix->width + (*x)] = 1;
 		//go to the next module
 		(*module_count)++;
 		getNextMetadataModuleInMaster(matrix->height, matrix->width, (*module_count), x, y);
@@ -241,8 +241,6 @@ jab_int32 readColorPaletteInMaster(jab_bitmap* matrix, jab_decoded_symbol* symbo
 		//color palette 1
 		color_index = master_palette_placement_index[1][color_counter] % color_number; //for 4-color and 8-color symbols
 		writeColorPalette(matrix, symbol, 1, color_index, *x, *y);
-		//set data map
-		data_map[(*y) * matrix->width + (*x)] = 1;
 		//go to the next module
 		(*module_count)++;
 		getNextMetadataModuleInMaster(matrix->height, matrix->width, (*module_count), x, y);
@@ -250,8 +248,6 @@ jab_int32 readColorPaletteInMaster(jab_bitmap* matrix, jab_decoded_symbol* symbo
 		//color palette 2
 		color_index = master_palette_placement_index[2][color_counter] % color_number; //for 4-color and 8-color symbols
 		writeColorPalette(matrix, symbol, 2, color_index, *x, *y);
-		//set data map
-		data_map[(*y) * matrix->width + (*x)] = 1;
 		//go to the next module
 		(*module_count)++;
 		getNextMetadataModuleInMaster(matrix->height, matrix->width, (*module_count), x, y);
@@ -259,8 +255,6 @@ jab_int32 readColorPaletteInMaster(jab_bitmap* matrix, jab_decoded_symbol* symbo
 		//color palette 3
 		color_index = master_palette_placement_index[3][color_counter] % color_number; //for 4-color and 8-color symbols
 		writeColorPalette(matrix, symbol, 3, color_index, *x, *y);
-		//set data map
-		data_map[(*y) * matrix->width + (*x)] = 1;
 		//go to the next module
 		(*module_count)++;
 		getNextMetadataModuleInMaster(matrix->height, matrix->width, (*module_count), x, y);
@@ -281,15 +275,14 @@ jab_int32 readColorPaletteInMaster(jab_bitmap* matrix, jab_decoded_symbol* symbo
  * @brief Read the color palettes in master symbol
  * @param matrix the symbol matrix
  * @param symbol the slave symbol
- * @param data_map the data module positions
  * @return JAB_SUCCESS | FATAL_ERROR
 */
-jab_int32 readColorPaletteInSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte* data_map)
+jab_int32 readColorPaletteInSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol)
 {
 	//allocate buffer for palette
 	jab_int32 color_number = (jab_int32)pow(2, symbol->metadata.Nc + 1);
-	free(symbol->palette);
-	symbol->palette = (jab_byte*)malloc(color_number * sizeof(jab_byte) * 3 * COLOR_PALETTE_NUMBER);
+	scratchFree(symbol->palette);
+	symbol->palette = (jab_byte*)scratchMalloc(color_number * sizeof(jab_byte) * 3 * COLOR_PALETTE_NUMBER);
     if(symbol->palette == NULL)
     {
 		reportError("Memory allocation for slave palette failed");
@@ -321,32 +314,24 @@ jab_int32 readColorPaletteInSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol
 		py = slave_palette_position[color_counter-2].y;
 		color_index = slave_palette_placement_index[color_counter] % color_number;
 		writeColorPalette(matrix, symbol, 0, color_index, px, py);
-		//set data map
-		data_map[py * matrix->width + px] = 1;
 
 		//color palette 1
 		px = matrix->width - 1 - slave_palette_position[color_counter-2].y;
 		py = slave_palette_position[color_counter-2].x;
 		color_index = slave_palette_placement_index[color_counter] % color_number;
 		writeColorPalette(matrix, symbol, 1, color_index, px, py);
-		//set data map
-		data_map[py * matrix->width + px] = 1;
 
 		//color palette 2
 		px = matrix->width - 1 - slave_palette_position[color_counter-2].x;
 		py = matrix->height - 1 - slave_palette_position[color_counter-2].y;
 		color_index = slave_palette_placement_index[color_counter] % color_number;
 		writeColorPalette(matrix, symbol, 2, color_index, px, py);
-		//set data map
-		data_map[py * matrix->width + px] = 1;
 
 		//color palette 3
 		px = slave_palette_position[color_counter-2].y;
 		py = matrix->height - 1 - slave_palette_position[color_counter-2].x;
 		color_index = slave_palette_placement_index[color_counter] % color_number;
 		writeColorPalette(matrix, symbol, 3, color_index, px, py);
-		//set data map
-		data_map[py * matrix->width + px] = 1;
 
 		//next color
 		color_counter++;
@@ -362,26 +347,27 @@ jab_int32 readColorPaletteInSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol
 
 /**
  * @brief Get the index of the nearest color palette
- * @param matrix the symbol matrix
+ * @param width the symbol width in module
+ * @param height the symbol height in module
  * @param x the x coordinate of the module
  * @param y the y coordinate of the module
  * @return the index of the nearest color palette
 */
-jab_int32 getNearestPalette(jab_bitmap* matrix, jab_int32 x, jab_int32 y)
+jab_int32 getNearestPalette(jab_int32 width, jab_int32 height, jab_int32 x, jab_int32 y)
 {
 	//set the palette coordinate
 	jab_int32 px[COLOR_PALETTE_NUMBER], py[COLOR_PALETTE_NUMBER];
 	px[0] = DISTANCE_TO_BORDER - 1 + 3;
 	py[0] = DISTANCE_TO_BORDER - 1;
-	px[1] = matrix->width - DISTANCE_TO_BORDER - 3;
+	px[1] = width - DISTANCE_TO_BORDER - 3;
 	py[1] = DISTANCE_TO_BORDER - 1;
-	px[2] = matrix->width - DISTANCE_TO_BORDER - 3;
-	py[2] = matrix->height- DISTANCE_TO_BORDER;
+	px[2] = width - DISTANCE_TO_BORDER - 3;
+	py[2] = height- DISTANCE_TO_BORDER;
 	px[3] = DISTANCE_TO_BORDER - 1 + 3;
-	py[3] = matrix->height- DISTANCE_TO_BORDER;
+	py[3] = height- DISTANCE_TO_BORDER;
 
 	//calculate the nearest palette
-	jab_float min = DIST(0, 0, matrix->width, matrix->height);
+	jab_float min = DIST(0, 0, width, height);
 	jab_int32 p_index = 0;
 	for(jab_int32 i=0; i<COLOR_PALETTE_NUMBER; i++)
 	{
@@ -395,6 +381,53 @@ jab_int32 getNearestPalette(jab_bitmap* matrix, jab_int32 x, jab_int32 y)
 	return p_index;
 }
 
+/**
+ * @brief Get the nearest color in a palette by comparing the normalized RGB values
+ * @param rgb the module RGB values
+ * @param norm_palette the normalized color palette
+ * @param color_number the number of module colors
+ * @return the index of the nearest color
+*/
+jab_byte getNearestColor(jab_byte* rgb, jab_float* norm_palette, jab_int32 color_number)
+{
+	//normalize the RGB values
+	jab_float rgb_max = MAX(rgb[0], MAX(rgb[1], rgb[2]));
+	jab_float r = (jab_float)rgb[0] / rgb_max;
+	jab_float g = (jab_float)rgb[1] / rgb_max;
+	jab_float b = (jab_float)rgb[2] / rgb_max;
+
+	jab_byte index = 0;
+	jab_float min = 255*255*3;
+	for(jab_int32 i=0; i<color_number; i++)
+	{
+		jab_float pr = norm_palette[i*4 + 0];
+		jab_float pg = norm_palette[i*4 + 1];
+		jab_float pb = norm_palette[i*4 + 2];
+		//compare the normalized module color with palette
+		jab_float diff = (pr - r) * (pr - r) + (pg - g) * (pg - g) + (pb - b) * (pb - b);
+		if(diff < min)
+		{
+			min = diff;
+			index = (jab_byte)i;
+		}
+	}
+	return index;
+}
+
+/**
+ * @brief Decide between black and white by comparing the RGB sum with both palette entries
+ * @param rgb the module RGB values
+ * @param palette the color palette
+ * @return the decoded value, 0 or 7
+*/
+jab_byte decideBlackWhite(jab_byte* rgb, jab_byte* palette)
+{
+	jab_int32 rgb_sum = rgb[0] + rgb[1] + rgb[2];
+	jab_int32 p0_sum = palette[0*3 + 0] + palette[0*3 + 1] + palette[0*3 + 2];
+	jab_int32 p7_sum = palette[7*3 + 0] + palette[7*3 + 1] + palette[7*3 + 2];
+	return rgb_sum < ((p0_sum + p7_sum) / 2) ? 0 : 7;
+}
+
 /**
  * @brief Decode a module using hard decision
  * @param matrix the symbol matrix
@@ -409,7 +442,7 @@ jab_int32 getNearestPalette(jab_bitmap* matrix, jab_int32 x, jab_int32 y)
 jab_byte decodeModuleHD(jab_bitmap* matrix, jab_byte* palette, jab_int32 color_number, jab_float* norm_palette, jab_float* pal_ths, jab_int32 x, jab_int32 y)
 {
 	//get the nearest palette
-	jab_int32 p_index = getNearestPalette(matrix, x, y);
+	jab_int32 p_index = getNearestPalette(matrix->width, matrix->height, x, y);
 
 	//read the RGB values
 	jab_byte rgb[3];
@@ -420,95 +453,111 @@ jab_byte decodeModuleHD(jab_bitmap* matrix, jab_byte* palette, jab_int32 color_n
 	rgb[1] = matrix->pixel[mtx_offset + 1];
 	rgb[2] = matrix->pixel[mtx_offset + 2];
 
-	jab_byte index1 = 0, index2 = 0;
-
 	//check black module
 	if(rgb[0] < pal_ths[p_index*3 + 0] && rgb[1] < pal_ths[p_index*3 + 1] && rgb[2] < pal_ths[p_index*3 + 2])
 	{
-		index1 = 0;
-		return index1;
+		return 0;
 	}
 	if(palette)
 	{
-	    //normalize the RGB values
-        jab_float rgb_max = MAX(rgb[0], MAX(rgb[1], rgb[2]));
-        jab_float r = (jab_float)rgb[0] / rgb_max;
-        jab_float g = (jab_float)rgb[1] / rgb_max;
-        jab_float b = (jab_float)rgb[2] / rgb_max;
-        //jab_float l = ((rgb[0] + rgb[1] + rgb[2]) / 3.0f) / 255.0f;
-
-		jab_float min1 = 255*255*3, min2 = 255*255*3;
-		for(jab_int32 i=0; i<color_number; i++)
+		jab_byte index = getNearestColor(rgb, norm_palette + color_number*4*p_index, color_number);
+		if(index == 0 || index == 7)
 		{
-			//normalize the color values in color palette
-			jab_float pr = norm_palette[color_number*4*p_index + i*4 + 0];
-			jab_float pg = norm_palette[color_number*4*p_index + i*4 + 1];
-			jab_float pb = norm_palette[color_number*4*p_index + i*4 + 2];
-			//jab_float pl = norm_palette[color_number*4*p_index + i*4 + 3];
-
-			//compare the normalized module color with palette
-			jab_float diff = (pr - r) * (pr - r) + (pg - g) * (pg - g) + (pb - b) * (pb - b);// + (pl - l) * (pl - l);
-
-			if(diff < min1)
-			{
-				//copy min1 to min2
-				min2 = min1;
-				index2 = index1;
-				//update min1
-				min1 = diff;
-				index1 = (jab_byte)i;
-			}
-			else if(diff < min2)
-			{
-				min2 = diff;
-				index2 = (jab_byte)i;
-			}
+			index = decideBlackWhite(rgb, palette + color_number*3*p_index);
 		}
+		return index;
+	}
+	else	//if no palette is available, decode the module as black/white
+	{
+		return ((rgb[0] > 100 ? 1 : 0) + (rgb[1] > 100 ? 1 : 0) + (rgb[2] > 100 ? 1 : 0)) > 1 ? 1 : 0;
+	}
+}
 
-		if(index1 == 0 || index1 == 7)
-		{
-			jab_int32 rgb_sum = rgb[0] + rgb[1] + rgb[2];
-			jab_int32 p0_sum = palette[color_number*3*p_index + 0*3 + 0] + palette[color_number*3*p_index + 0*3 + 1] + palette[color_number*3*p_index + 0*3 + 2];
-			jab_int32 p7_sum = palette[color_number*3*p_index + 7*3 + 0] + palette[color_number*3*p_index + 7*3 + 1] + palette[color_number*3*p_index + 7*3 + 2];
+/**
+ * @brief Create the module color classifier of a symbol
+ * @param palette the color palettes
+ * @param color_number the number of module colors
+ * @param norm_palette the normalized color palettes
+ * @param pal_ths the palette RGB value thresholds
+ * @return the classifier | NULL if failed
+*/
+jab_color_classifier* createColorClassifier(jab_byte* palette, jab_int32 color_number, jab_float* norm_palette, jab_float* pal_ths)
+{
+	jab_color_classifier* cc = (jab_color_classifier*)scratchMalloc(sizeof(jab_color_classifier) + COLOR_PALETTE_NUMBER * COLOR_LUT_SIZE * sizeof(jab_byte));
+	if(cc == NULL)
+	{
+		reportError("Memory allocation for color classifier failed");
+		return NULL;
+	}
+	cc->palette = palette;
+	cc->color_number = color_number;
+	cc->norm_palette = norm_palette;
+	cc->pal_ths = pal_ths;
+	memset(cc->lut, COLOR_LUT_UNSET, COLOR_PALETTE_NUMBER * COLOR_LUT_SIZE * sizeof(jab_byte));
+	return cc;
+}
 
-			if(rgb_sum < ((p0_sum + p7_sum) / 2))
-			{
-				index1 = 0;
-			}
-			else
-			{
-				index1 = 7;
-			}
-		}
-		//if the minimum is close to the second minimum, do further match
-/*		if(min1 * 1.5 > min2)
-		{
-			//printf("min1(%d) * 1.5 > min2(%d), %d %d %d", index1, index2, rgb[0], rgb[1], rgb[2]);
-			jab_int32 rg = abs(rgb[0] - rgb[1]);
-			jab_int32 rb = abs(rgb[0] - rgb[2]);
-			jab_int32 gb = abs(rgb[1] - rgb[2]);
-
-			jab_int32 c1rg = abs(palette[color_number*3*p_index + index1*3 + 0] - palette[color_number*3*p_index + index1*3 + 1]);
-			jab_int32 c1rb = abs(palette[color_number*3*p_index + index1*3 + 0] - palette[color_number*3*p_index + index1*3 + 2]);
-			jab_int32 c1gb = abs(palette[color_number*3*p_index + index1*3 + 1] - palette[color_number*3*p_index + index1*3 + 2]);
-			jab_int32 diff1 = abs(rg - c1rg) + abs(rb - c1rb) + abs(gb - c1gb);
-
-			jab_int32 c2rg = abs(palette[color_number*3*p_index + index2*3 + 0] - palette[color_number*3*p_index + index2*3 + 1]);
-			jab_int32 c2rb = abs(palette[color_number*3*p_index + index2*3 + 0] - palette[color_number*3*p_index + index2*3 + 2]);
-			jab_int32 c2gb = abs(palette[color_number*3*p_index + index2*3 + 1] - palette[color_number*3*p_index + index2*3 + 2]);
-			jab_int32 diff2 = abs(rg - c2rg) + abs(rb - c2rb) + abs(gb - c2gb);
-
-			if(diff2 < diff1)
-				index1 = index2;
-			//printf("final: %d\n", index1);
-		}
+/**
+ * @brief Fill a color lookup table cell
+ * @param cc the color classifier
+ * @param p_index the palette index
+ * @param cell the cell index
+ * @return the cell value
 */
+jab_byte fillColorLUTCell(jab_color_classifier* cc, jab_int32 p_index, jab_int32 cell)
+{
+	jab_int32 step = 1 << (8 - COLOR_LUT_BITS);
+	jab_int32 mask = (1 << COLOR_LUT_BITS) - 1;
+	jab_int32 r0 = ((cell >> (2*COLOR_LUT_BITS)) & mask) * step;
+	jab_int32 g0 = ((cell >> COLOR_LUT_BITS) & mask) * step;
+	jab_int32 b0 = (cell & mask) * step;
+
+	//the cell is only usable if the nearest color is the same at all its corners
+	jab_byte rgb[3] = {(jab_byte)r0, (jab_byte)g0, (jab_byte)b0};
+	jab_byte value = rgb[0] | rgb[1] | rgb[2] ? getNearestColor(rgb, cc->norm_palette + cc->color_number*4*p_index, cc->color_number) : COLOR_LUT_MIXED;
+	for(jab_int32 c=1; c<8 && value != COLOR_LUT_MIXED; c++)
+	{
+		rgb[0] = (jab_byte)(r0 + ((c >> 2) & 1) * (step - 1));
+		rgb[1] = (jab_byte)(g0 + ((c >> 1) & 1) * (step - 1));
+		rgb[2] = (jab_byte)(b0 + (c & 1) * (step - 1));
+		if(getNearestColor(rgb, cc->norm_palette + cc->color_number*4*p_index, cc->color_number) != value)
+			value = COLOR_LUT_MIXED;
+	}
+	cc->lut[p_index * COLOR_LUT_SIZE + cell] = value;
+	return value;
+}
+
+/**
+ * @brief Decode a module using hard decision with the color lookup table
+ * @param cc the color classifier
+ * @param rgb the module RGB values
+ * @param p_index the index of the nearest palette
+ * @return the decoded value
+*/
+jab_byte classifyModuleColor(jab_color_classifier* cc, jab_byte* rgb, jab_int32 p_index)
+{
+	//check black module
+	if(rgb[0] < cc->pal_ths[p_index*3 + 0] && rgb[1] < cc->pal_ths[p_index*3 + 1] && rgb[2] < cc->pal_ths[p_index*3 + 2])
+	{
+		return 0;
 	}
-	else	//if no palette is available, decode the module as black/white
+	jab_int32 cell = ((rgb[0] >> (8 - COLOR_LUT_BITS)) << (2*COLOR_LUT_BITS)) |
+					 ((rgb[1] >> (8 - COLOR_LUT_BITS)) << COLOR_LUT_BITS) |
+					  (rgb[2] >> (8 - COLOR_LUT_BITS));
+	jab_byte index = cc->lut[p_index * COLOR_LUT_SIZE + cell];
+	if(index == COLOR_LUT_UNSET)
+	{
+		index = fillColorLUTCell(cc, p_index, cell);
+	}
+	if(index == COLOR_LUT_MIXED)
+	{
+		index = getNearestColor(rgb, cc->norm_palette + cc->color_number*4*p_index, cc->color_number);
+	}
+	if(index == 0 || index == 7)
 	{
-		index1 = ((rgb[0] > 100 ? 1 : 0) + (rgb[1] > 100 ? 1 : 0) + (rgb[2] > 100 ? 1 : 0)) > 1 ? 1 : 0;
+		index = decideBlackWhite(rgb, cc->palette + cc->color_number*3*p_index);
 	}
-	return index1;
+	return index;
 }
 
 /**
@@ -638,7 +687,7 @@ void getNextMetadataModuleInMaster(jab_int32 matrix_height, jab_int32 matrix_wid
  * @param offset the metadata start offset in the data stream
  * @return the read metadata bit length | DECODE_METADATA_FAILED
 */
-jab_int32 decodeSlaveMetadata(jab_decoded_symbol* host_symbol, jab_int32 docked_position, jab_data* data, jab_int32 offset)
+jab_int32 decodeSlaveMetadata(jab_decoded_symbol* host_symbol, jab_int32 docked_position, const jab_bitstream* data, jab_int32 offset)
 {
 	//set metadata from host symbol
 	host_symbol->slave_metadata[docked_position].Nc = host_symbol->metadata.Nc;
@@ -651,13 +700,15 @@ jab_int32 decodeSlaveMetadata(jab_decoded_symbol* host_symbol, jab_int32 docked_
 
 	//parse part1
 	if(index < 0) return DECODE_METADATA_FAILED;
-	SS = data->data[index--];//SS
+	SS = GET_BIT(data, index);//SS
+	index--;
 	if(SS == 0)
 	{
 		host_symbol->slave_metadata[docked_position].side_version = host_symbol->metadata.side_version;
 	}
 	if(index < 0) return DECODE_METADATA_FAILED;
-	SE = data->data[index--];//SE
+	SE = GET_BIT(data, index);//SE
+	index--;
 	if(SE == 0)
 	{
 		host_symbol->slave_metadata[docked_position].ecl = host_symbol->metadata.ecl;
@@ -669,8 +720,9 @@ jab_int32 decodeSlaveMetadata(jab_decoded_symbol* host_symbol, jab_int32 docked_
 		V = 0;
 		for(jab_int32 i=0; i<5; i++)
 		{
-			V += data->data[index--] << (4 - i);
+			V += GET_BIT(data, index - i) << (4 - i);
 		}
+		index -= 5;
 		jab_int32 side_version = V + 1;
 		if(docked_position == 2 || docked_position == 3)
 		{
@@ -690,15 +742,17 @@ jab_int32 decodeSlaveMetadata(jab_decoded_symbol* host_symbol, jab_int32 docked_
 		E = 0;
 		for(jab_int32 i=0; i<3; i++)
 		{
-			E += data->data[index--] << (2 - i);
+			E += GET_BIT(data, index - i) << (2 - i);
 		}
+		index -= 3;
 		host_symbol->slave_metadata[docked_position].ecl.x = E + 3;	//wc = E_part1 + 3
 		//get wr (the second half of E)
 		E = 0;
 		for(jab_int32 i=0; i<3; i++)
 		{
-			E += data->data[index--] << (2 - i);
+			E += GET_BIT(data, index - i) << (2 - i);
 		}
+		index -= 3;
 		host_symbol->slave_metadata[docked_position].ecl.y = E + 4;	//wr = E_part2 + 4
 
 		//check wc and wr
@@ -733,13 +787,12 @@ jab_byte decodeNcModuleColor(jab_byte module1_color, jab_byte module2_color)
  * @brief Decode the PartI of master symbol metadata
  * @param matrix the symbol matrix
  * @param symbol the master symbol
- * @param data_map the data module positions
  * @param module_count the index number of the next module
  * @param x the x coordinate of the current and the next module
  * @param y the y coordinate of the current and the next module
  * @return JAB_SUCCESS | JAB_FAILURE | DECODE_METADATA_FAILED
 */
-jab_int32 decodeMasterMetadataPartI(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte* data_map, jab_int32* module_count, jab_int32* x, jab_int32* y)
+jab_int32 decodeMasterMetadataPartI(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_int32* module_count, jab_int32* x, jab_int32* y)
 {
 	//decode Nc module color
 	jab_byte module_color[MASTER_METADATA_PART1_MODULE_NUMBER];
@@ -759,8 +812,6 @@ jab_int32 decodeMasterMetadataPartI(jab_bitmap* matrix, jab_decoded_symbol* symb
 			return DECODE_METADATA_FAILED;
 		}
 		module_color[*module_count] = rgb;
-		//set data map
-		data_map[(*y) * matrix->width + (*x)] = 1;
 		//go to the next module
 		(*module_count)++;
 		getNextMetadataModuleInMaster(matrix->height, matrix->width, (*module_count), x, y);
@@ -778,17 +829,13 @@ jab_int32 decodeMasterMetadataPartI(jab_bitmap* matrix, jab_decoded_symbol* symb
 		return DECODE_METADATA_FAILED;
 	}
 	//set bits in part1
-	jab_byte part1[MASTER_METADATA_PART1_LENGTH] = {0};			//6 encoded bits
-	jab_int32 bit_count = 0;
-	for(jab_int32 n=0; n<2; n++)
+	jab_bitstream* part1 = createScratchBitstream(MASTER_METADATA_PART1_LENGTH);	//6 encoded bits
+	if(part1 == NULL)
 	{
-		for(jab_int32 i=0; i<3; i++)
-		{
-			jab_byte bit = (bits[n] >> (2 - i)) & 0x01;
-			part1[bit_count] = bit;
-			bit_count++;
-		}
+		return JAB_FAILURE;
 	}
+	writeBits(part1, 0, bits[0], 3);
+	writeBits(part1, 3, bits[1], 3);
 
 	//decode ldpc for part1
 	if( !decodeLDPChd(part1, MASTER_METADATA_PART1_LENGTH, MASTER_METADATA_PART1_LENGTH > 36 ? 4 : 3, 0) )
@@ -796,10 +843,14 @@ jab_int32 decodeMasterMetadataPartI(jab_bitmap* matrix, jab_decoded_symbol* symb
 #if TEST_MODE
 		reportError("LDPC decoding for master metadata part 1 failed");
 #endif
+		scratchFree(part1);
 		return JAB_FAILURE;
 	}
 	//parse part1
-	symbol->metadata.Nc = (part1[0] << 2) + (part1[1] << 1) + part1[2];
+	jab_int32 Nc;
+	readBits(part1, 0, 3, &Nc);
+	symbol->metadata.Nc = Nc;
+	scratchFree(part1);
 
 	return JAB_SUCCESS;
 }
@@ -808,7 +859,6 @@ jab_int32 decodeMasterMetadataPartI(jab_bitmap* matrix, jab_decoded_symbol* symb
  * @brief Decode the PartII of master symbol metadata
  * @param matrix the symbol matrix
  * @param symbol the master symbol
- * @param data_map the data module positions
  * @param norm_palette the normalized color palettes
  * @param pal_ths the palette RGB value thresholds
  * @param module_count the index number of the next module
@@ -816,16 +866,20 @@ jab_int32 decodeMasterMetadataPartI(jab_bitmap* matrix, jab_decoded_symbol* symb
  * @param y the y coordinate of the current and the next module
  * @return JAB_SUCCESS | JAB_FAILURE | DECODE_METADATA_FAILED | FATAL_ERROR
 */
-jab_int32 decodeMasterMetadataPartII(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte* data_map, jab_float* norm_palette, jab_float* pal_ths, jab_int32* module_count, jab_int32* x, jab_int32* y)
+jab_int32 decodeMasterMetadataPartII(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_float* norm_palette, jab_float* pal_ths, jab_int32* module_count, jab_int32* x, jab_int32* y)
 {
-	jab_byte part2[MASTER_METADATA_PART2_LENGTH] = {0};			//38 encoded bits
 	jab_int32 part2_bit_count = 0;
-	jab_uint32 V, E;
-	jab_uint32 V_length = 10, E_length = 6;
+	jab_int32 V, E;
+	jab_int32 V_length = 10, E_length = 6;
 
 	jab_int32 color_number = (jab_int32)pow(2, symbol->metadata.Nc + 1);
 	jab_int32 bits_per_module = (jab_int32)(log(color_number) / log(2));
 
+	jab_bitstream* part2 = createScratchBitstream(MASTER_METADATA_PART2_LENGTH);	//38 encoded bits
+	if(part2 == NULL)
+	{
+		return FATAL_ERROR;
+	}
     //read part2
     while(part2_bit_count < MASTER_METADATA_PART2_LENGTH)
     {
@@ -837,7 +891,7 @@ jab_int32 decodeMasterMetadataPartII(jab_bitmap* matrix, jab_decoded_symbol* sym
 			jab_byte bit = (bits >> (bits_per_module - 1 - i)) & 0x01;
 			if(part2_bit_count < MASTER_METADATA_PART2_LENGTH)
 			{
-				part2[part2_bit_count] = bit;
+				PUT_BIT(part2, part2_bit_count, bit);
 				part2_bit_count++;
 			}
 			else	//if part2 is full, stop
@@ -845,8 +899,6 @@ jab_int32 decodeMasterMetadataPartII(jab_bitmap* matrix, jab_decoded_symbol* sym
 				break;
 			}
 		}
-		//set data map
-		data_map[(*y) * matrix->width + (*x)] = 1;
 		//go to the next module
 		(*module_count)++;
 		getNextMetadataModuleInMaster(matrix->height, matrix->width, (*module_count), x, y);
@@ -858,46 +910,34 @@ jab_int32 decodeMasterMetadataPartII(jab_bitmap* matrix, jab_decoded_symbol* sym
 #if TEST_MODE
 		reportError("LDPC decoding for master metadata part 2 failed");
 #endif
+		scratchFree(part2);
 		return DECODE_METADATA_FAILED;
 	}
 
     //parse part2
 	//read V
 	//get horizontal side version
-	V = 0;
-	for(jab_int32 i=0; i<V_length/2; i++)
-	{
-		V += part2[i] << (V_length/2 - 1 - i);
-	}
+	readBits(part2, 0, V_length/2, &V);
 	symbol->metadata.side_version.x = V + 1;
 	//get vertical side version
-	V = 0;
-	for(jab_int32 i=0; i<V_length/2; i++)
-	{
-		V += part2[i+V_length/2] << (V_length/2 - 1 - i);
-	}
+	readBits(part2, V_length/2, V_length/2, &V);
 	symbol->metadata.side_version.y = V + 1;
 
 	//read E
 	jab_int32 bit_index = V_length;
 	//get wc (the first half of E)
-	E = 0;
-	for(jab_int32 i=bit_index; i<(bit_index+E_length/2); i++)
-	{
-		E += part2[i] << (E_length/2 - 1 - (i - bit_index));
-	}
+	readBits(part2, bit_index, E_length/2, &E);
 	symbol->metadata.ecl.x = E + 3;		//wc = E_part1 + 3
 	//get wr (the second half of E)
-	E = 0;
-	for(jab_int32 i=bit_index; i<(bit_index+E_length/2); i++)
-	{
-		E += part2[i+E_length/2] << (E_length/2 - 1 - (i - bit_index));
-	}
+	readBits(part2, bit_index+E_length/2, E_length/2, &E);
 	symbol->metadata.ecl.y = E + 4;		//wr = E_part2 + 4
 
 	//read MSK
 	bit_index = V_length + E_length;
-	symbol->metadata.mask_type = (part2[bit_index+0] << 2) + (part2[bit_index+1] << 1) + part2[bit_index+2];
+	jab_int32 MSK;
+	readBits(part2, bit_index, 3, &MSK);
+	symbol->metadata.mask_type = MSK;
+	scratchFree(part2);
 
 	symbol->metadata.docked_position = 0;
 
@@ -924,16 +964,15 @@ jab_int32 decodeMasterMetadataPartII(jab_bitmap* matrix, jab_decoded_symbol* sym
  * @brief Decode data modules
  * @param matrix the symbol matrix
  * @param symbol the symbol to be decoded
- * @param data_map the data module positions
+ * @param layout the data module layout
  * @param norm_palette the normalized color palettes
  * @param pal_ths the palette RGB value thresholds
  * @return the decoded data | NULL if failed
 */
-jab_data* readRawModuleData(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte* data_map, jab_float* norm_palette, jab_float* pal_ths)
+jab_data* readRawModuleData(jab_bitmap* matrix, jab_decoded_symbol* symbol, const jab_symbol_layout* layout, jab_float* norm_palette, jab_float* pal_ths)
 {
     jab_int32 color_number = (jab_int32)pow(2, symbol->metadata.Nc + 1);
-	jab_int32 module_count = 0;
-    jab_data* data = (jab_data*)malloc(sizeof(jab_data) + matrix->width * matrix->height * sizeof(jab_char));
+    jab_data* data = (jab_data*)scratchMalloc(sizeof(jab_data) + layout->data_module_number * sizeof(jab_char));
     if(data == NULL)
 	{
 		reportError("Memory allocation for raw module data failed");
@@ -942,32 +981,43 @@ jab_data* readRawModuleData(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_
 
 #if TEST_MODE
 	jab_byte decoded_module_color_index[matrix->height * matrix->width];
+	memset(decoded_module_color_index, 255, matrix->height * matrix->width);
 #endif
 
-	for(jab_int32 j=0; j<matrix->width; j++)
+	//the module colors are classified by a lookup table which is filled on demand
+	jab_color_classifier* cc = NULL;
+	if(symbol->palette)
+	{
+		cc = createColorClassifier(symbol->palette, color_number, norm_palette, pal_ths);
+	}
+	jab_int32 mtx_bytes_per_pixel = matrix->bits_per_pixel / 8;
+	jab_int32 mtx_bytes_per_row = matrix->width * mtx_bytes_per_pixel;
+
+	//the data modules are read row by row in memory order and written to their placement positions
+	jab_int32 k = 0;
+	for(jab_int32 y=0; y<matrix->height; y++)
 	{
-		for(jab_int32 i=0; i<matrix->height; i++)
+		const jab_byte* row = matrix->pixel + y * mtx_bytes_per_row;
+		for(jab_int32 x=0; x<matrix->width; x++)
 		{
-			if(data_map[i*matrix->width + j] == 0)
-			{
-				//decode bits out of the module at (x,y)
-				jab_byte bits = decodeModuleHD(matrix, symbol->palette, color_number, norm_palette, pal_ths, j, i);
-				//write the bits into data
-				data->data[module_count] = (jab_char)bits;
-				module_count++;
-#if TEST_MODE
-				decoded_module_color_index[i*matrix->width + j] = bits;
-#endif
-			}
+			if(!IS_DATA_MODULE(layout, x, y))
+				continue;
+			jab_int32 p = layout->row_order[k++];
+			//decode bits out of the module at (x,y)
+			jab_byte bits;
+			if(cc)
+				bits = classifyModuleColor(cc, (jab_byte*)&row[x * mtx_bytes_per_pixel], layout->palette_index[p]);
 			else
-			{
+				bits = decodeModuleHD(matrix, symbol->palette, color_number, norm_palette, pal_ths, x, y);
+			//write the bits into data
+			data->data[p] = (jab_char)bits;
 #if TEST_MODE
-				decoded_module_color_index[i*matrix->width + j] = 255;
+			decoded_module_color_index[y*matrix->width + x] = bits;
 #endif
-			}
 		}
 	}
-	data->length = module_count;
+	data->length = layout->data_module_number;
+	scratchFree(cc);
 
 #if TEST_MODE
 	FILE* fp1 = fopen("jab_dec_module_sampled_rgb.raw", "wb");
@@ -984,7 +1034,7 @@ jab_data* readRawModuleData(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_
 			rgb1[1] = matrix->pixel[mtx_offset + 1];
 			rgb1[2] = matrix->pixel[mtx_offset + 2];
 
-			if(data_map[i*matrix->width + j] == 0)
+			if(IS_DATA_MODULE(layout, j, i))
 			{
 				jab_int32 index = decoded_module_color_index[i*matrix->width + j];
 				rgb2[0] = jab_default_palette[index*3 + 0];
@@ -1012,116 +1062,25 @@ jab_data* readRawModuleData(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_
 }
 
 /**
- * @brief Convert multi-bit-per-byte raw module data to one-bit-per-byte raw data
+ * @brief Convert multi-bit-per-byte raw module data to packed raw data
  * @param raw_module_data the input raw module data
  * @param bits_per_module the number of bits per module
  * @return the converted data | NULL if failed
 */
-jab_data* rawModuleData2RawData(jab_data* raw_module_data, jab_int32 bits_per_module)
+jab_bitstream* rawModuleData2RawData(jab_data* raw_module_data, jab_int32 bits_per_module)
 {
-	//
-	jab_data* raw_data = (jab_data *)malloc(sizeof(jab_data) + raw_module_data->length * bits_per_module * sizeof(jab_char));
+	jab_bitstream* raw_data = createScratchBitstream(raw_module_data->length * bits_per_module);
     if(raw_data == NULL)
 	{
-		reportError("Memory allocation for raw data failed");
 		return NULL;
 	}
 	for(jab_int32 i=0; i<raw_module_data->length; i++)
 	{
-		for(jab_int32 j=0; j<bits_per_module; j++)
-		{
-			raw_data->data[i * bits_per_module + j] = (raw_module_data->data[i] >> (bits_per_module - 1 - j)) & 0x01;
-		}
+		writeBits(raw_data, i * bits_per_module, (jab_byte)raw_module_data->data[i], bits_per_module);
 	}
-	raw_data->length = raw_module_data->length * bits_per_module;
 	return raw_data;
 }
 
-/**
- * @brief Mark the positions of finder patterns and alignment patterns in the data map
- * @param data_map the data module positions
- * @param width the width of the data map
- * @param height the height of the data map
- * @param type the symbol type, 0: master, 1: slave
-*/
-void fillDataMap(jab_byte* data_map, jab_int32 width, jab_int32 height, jab_int32 type)
-{
-	jab_int32 side_ver_x_index = SIZE2VERSION(width) - 1;
-	jab_int32 side_ver_y_index = SIZE2VERSION(height) - 1;
-    jab_int32 number_of_ap_x = jab_ap_num[side_ver_x_index];
-    jab_int32 number_of_ap_y = jab_ap_num[side_ver_y_index];
-    for(jab_int32 i=0; i<number_of_ap_y; i++)
-    {
-		for(jab_int32 j=0; j<number_of_ap_x; j++)
-		{
-			//the center coordinate
-			jab_int32 x_offset = jab_ap_pos[side_ver_x_index][j] - 1;
-            jab_int32 y_offset = jab_ap_pos[side_ver_y_index][i] - 1;
-			//the cross
-			data_map[y_offset 		* width + x_offset]		  =
-			data_map[y_offset		* width + (x_offset - 1)] =
-			data_map[y_offset		* width + (x_offset + 1)] =
-			data_map[(y_offset - 1) * width + x_offset] 	  =
-			data_map[(y_offset + 1) * width + x_offset] 	  = 1;
-
-			//the diagonal modules
-			if(i == 0 && (j == 0 || j == number_of_ap_x - 1))	//at finder pattern 0 and 1 positions
-			{
-				data_map[(y_offset - 1) * width + (x_offset - 1)] =
-				data_map[(y_offset + 1) * width + (x_offset + 1)] = 1;
-				if(type == 0)	//master symbol
-				{
-					data_map[(y_offset - 2) * width + (x_offset - 2)] =
-					data_map[(y_offset - 2) * width + (x_offset - 1)] =
-					data_map[(y_offset - 2) * width +  x_offset] 	  =
-					data_map[(y_offset - 1) * width + (x_offset - 2)] =
-					data_map[ y_offset		* width + (x_offset - 2)] = 1;
-
-					data_map[(y_offset + 2) * width + (x_offset + 2)] =
-					data_map[(y_offset + 2) * width + (x_offset + 1)] =
-					data_map[(y_offset + 2) * width +  x_offset] 	  =
-					data_map[(y_offset + 1) * width + (x_offset + 2)] =
-					data_map[ y_offset		* width + (x_offset + 2)] = 1;
-				}
-			}
-			else if(i == number_of_ap_y - 1 && (j == 0 || j == number_of_ap_x - 1))	//at finder pattern 2 and 3 positions
-			{
-				data_map[(y_offset - 1) * width + (x_offset + 1)] =
-				data_map[(y_offset + 1) * width + (x_offset - 1)] = 1;
-				if(type == 0) 	//master symbol
-				{
-					data_map[(y_offset - 2) * width + (x_offset + 2)] =
-					data_map[(y_offset - 2) * width + (x_offset + 1)] =
-					data_map[(y_offset - 2) * width +  x_offset] 	  =
-					data_map[(y_offset - 1) * width + (x_offset + 2)] =
-					data_map[ y_offset		* width + (x_offset + 2)] = 1;
-
-					data_map[(y_offset + 2) * width + (x_offset - 2)] =
-					data_map[(y_offset + 2) * width + (x_offset - 1)] =
-					data_map[(y_offset + 2) * width +  x_offset] 	  =
-					data_map[(y_offset + 1) * width + (x_offset - 2)] =
-					data_map[ y_offset		* width + (x_offset - 2)] = 1;
-				}
-			}
-			else	//at other positions
-			{
-				//even row, even column / odd row, odd column
-				if( (i % 2 == 0 && j % 2 == 0) || (i % 2 == 1 && j % 2 == 1))
-				{
-					data_map[(y_offset - 1) * width + (x_offset - 1)] =
-					data_map[(y_offset + 1) * width + (x_offset + 1)] = 1;
-				}
-				//odd row, even column / even row, old column
-				else
-				{
-					data_map[(y_offset - 1) * width + (x_offset + 1)] =
-					data_map[(y_offset + 1) * width + (x_offset - 1)] = 1;
-				}
-			}
-		}
-    }
-}
-
 /**
  * @brief Load default metadata values and color palettes for master symbol
  * @param matrix the symbol matrix
@@ -1147,13 +1106,12 @@ void loadDefaultMasterMetadata(jab_bitmap* matrix, jab_decoded_symbol* symbol)
  * @brief Decode symbol
  * @param matrix the symbol matrix
  * @param symbol the symbol to be decoded
- * @param data_map the data module positions
  * @param norm_palette the normalized color palettes
  * @param pal_ths the palette RGB value thresholds
  * @param type the symbol type, 0: master, 1: slave
  * @return JAB_SUCCESS | JAB_FAILURE | DECODE_METADATA_FAILED | FATAL_ERROR
 */
-jab_int32 decodeSymbol(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte* data_map, jab_float* norm_palette, jab_float* pal_ths, jab_int32 type)
+jab_int32 decodeSymbol(jab_bitmap* matrix, jab_decoded_symbol* symbol, const jab_symbol_layout* layout, jab_float* norm_palette, jab_float* pal_ths, jab_int32 type)
 {
 #if TEST_MODE
 	jab_int32 color_number = (jab_int32)pow(2, symbol->metadata.Nc + 1);
@@ -1179,15 +1137,13 @@ jab_int32 decodeSymbol(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte*
 	}
 #endif // TEST_MODE
 
-	//fill data map
-	fillDataMap(data_map, matrix->width, matrix->height, type);
-
 	//read raw data
-	jab_data* raw_module_data = readRawModuleData(matrix, symbol, data_map, norm_palette, pal_ths);
+	DECODE_STATS_START(module_start)
+	jab_data* raw_module_data = readRawModuleData(matrix, symbol, layout, norm_palette, pal_ths);
+	DECODE_STATS_STOP(module_start, module_time)
 	if(raw_module_data == NULL)
 	{
 		JAB_REPORT_ERROR(("Reading raw module data in symbol %d failed", symbol->index))
-		free(data_map);
 		return FATAL_ERROR;
 	}
 #if TEST_MODE
@@ -1197,17 +1153,16 @@ jab_int32 decodeSymbol(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte*
 #endif // TEST_MODE
 
 	//demask
-	demaskSymbol(raw_module_data, data_map, symbol->side_size, symbol->metadata.mask_type, (jab_int32)pow(2, symbol->metadata.Nc + 1));
-	free(data_map);
+	demaskSymbol(raw_module_data, layout, symbol->metadata.mask_type, (jab_int32)pow(2, symbol->metadata.Nc + 1));
 #if TEST_MODE
 	fp = fopen("jab_demasked_module_data.bin", "wb");
 	fwrite(raw_module_data->data, raw_module_data->length, 1, fp);
 	fclose(fp);
 #endif // TEST_MODE
 
-	//change to one-bit-per-byte representation
-	jab_data* raw_data = rawModuleData2RawData(raw_module_data, symbol->metadata.Nc + 1);
-	free(raw_module_data);
+	//change to packed bit representation
+	jab_bitstream* raw_data = rawModuleData2RawData(raw_module_data, symbol->metadata.Nc + 1);
+	scratchFree(raw_module_data);
 	if(raw_data == NULL)
 	{
 		JAB_REPORT_ERROR(("Reading raw data in symbol %d failed", symbol->index))
@@ -1222,26 +1177,43 @@ jab_int32 decodeSymbol(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte*
 
 	//deinterleave data
 	raw_data->length = Pg;	//drop the padding bits
-    deinterleaveData(raw_data);
+	DECODE_STATS_START(deinterleave_start)
+	jab_bitstream* data = createScratchBitstream(Pg);
+	if(data == NULL || !deinterleaveData(raw_data, data))
+	{
+		JAB_REPORT_ERROR(("Deinterleaving data in symbol %d failed", symbol->index))
+		scratchFree(data);
+		scratchFree(raw_data);
+		return FATAL_ERROR;
+	}
+	scratchFree(raw_data);
+	DECODE_STATS_STOP(deinterleave_start, deinterleave_time)
 
 #if TEST_MODE
 	JAB_REPORT_INFO(("wc:%d, wr:%d, Pg:%d, Pn: %d", wc, wr, Pg, Pn))
 	fp = fopen("jab_dec_bit_data.bin", "wb");
-	fwrite(raw_data->data, raw_data->length, 1, fp);
+	for(jab_int32 i=0; i<data->length; i++)
+	{
+		jab_byte bit = GET_BIT(data, i);
+		fwrite(&bit, 1, 1, fp);
+	}
 	fclose(fp);
 #endif // TEST_MODE
 
 	//decode ldpc
-    if(decodeLDPChd((jab_byte*)raw_data->data, Pg, symbol->metadata.ecl.x, symbol->metadata.ecl.y) != Pn)
+	DECODE_STATS_START(ldpc_start)
+	jab_int32 ldpc_length = decodeLDPChd(data, Pg, symbol->metadata.ecl.x, symbol->metadata.ecl.y);
+	DECODE_STATS_STOP(ldpc_start, ldpc_time)
+    if(ldpc_length != Pn)
     {
 		JAB_REPORT_ERROR(("LDPC decoding for data in symbol %d failed", symbol->index))
-		free(raw_data);
+		scratchFree(data);
 		return JAB_FAILURE;
 	}
 
 	//find the start flag of metadata
 	jab_int32 metadata_offset = Pn - 1;
-	while(raw_data->data[metadata_offset] == 0)
+	while(GET_BIT(data, metadata_offset) == 0)
 	{
 		metadata_offset--;
 	}
@@ -1255,37 +1227,27 @@ jab_int32 decodeSymbol(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte*
 		{
 			if(i == symbol->host_position) continue; //skip host position
 		}
-		symbol->metadata.docked_position += raw_data->data[metadata_offset--] << (3 - i);
+		symbol->metadata.docked_position += GET_BIT(data, metadata_offset) << (3 - i);
+		metadata_offset--;
 	}
 	//decode metadata for docked slave symbols
 	for(jab_int32 i=0; i<4; i++)
 	{
 		if(symbol->metadata.docked_position & (0x08 >> i))
 		{
-			jab_int32 read_bit_length = decodeSlaveMetadata(symbol, i, raw_data, metadata_offset);
+			jab_int32 read_bit_length = decodeSlaveMetadata(symbol, i, data, metadata_offset);
 			if(read_bit_length == DECODE_METADATA_FAILED)
 			{
-				free(raw_data);
+				scratchFree(data);
 				return DECODE_METADATA_FAILED;
 			}
 			metadata_offset -= read_bit_length;
 		}
 	}
 
-	//copy the decoded data to symbol
-	jab_int32 net_data_length = metadata_offset + 1;
-	symbol->data = (jab_data *)malloc(sizeof(jab_data) + net_data_length * sizeof(jab_char));
-	if(symbol->data == NULL)
-	{
-		reportError("Memory allocation for symbol data failed");
-		free(raw_data);
-		return FATAL_ERROR;
-	}
-	symbol->data->length = net_data_length;
-	memcpy(symbol->data->data, raw_data->data, net_data_length);
-
-	//clean memory
-	free(raw_data);
+	//the decoded data is kept in place, followed by the metadata bits
+	data->length = metadata_offset + 1;
+	symbol->data = data;
 	return JAB_SUCCESS;
 }
 
@@ -1315,21 +1277,13 @@ jab_int32 decodeMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol)
 		return FATAL_ERROR;
 	}
 
-	//create data map
-	jab_byte* data_map = (jab_byte*)calloc(1, matrix->width*matrix->height*sizeof(jab_byte));
-	if(data_map == NULL)
-	{
-		reportError("Memory allocation for data map in master failed");
-		return FATAL_ERROR;
-	}
-
 	//decode metadata and color palette
 	jab_int32 x = MASTER_METADATA_X;
 	jab_int32 y = MASTER_METADATA_Y;
 	jab_int32 module_count = 0;
 
 	//decode metadata PartI (Nc)
-	jab_int32 decode_partI_ret = decodeMasterMetadataPartI(matrix, symbol, data_map, &module_count, &x, &y);
+	jab_int32 decode_partI_ret = decodeMasterMetadataPartI(matrix, symbol, &module_count, &x, &y);
 	if(decode_partI_ret == JAB_FAILURE)
 	{
 		return JAB_FAILURE;
@@ -1340,14 +1294,15 @@ jab_int32 decodeMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol)
 		x = MASTER_METADATA_X;
 		y = MASTER_METADATA_Y;
 		module_count = 0;
-		//clear data_map
-		memset(data_map, 0, matrix->width*matrix->height*sizeof(jab_byte));
 		//load default metadata and color palette
 		loadDefaultMasterMetadata(matrix, symbol);
 	}
 
 	//read color palettes
-    if(readColorPaletteInMaster(matrix, symbol, data_map, &module_count, &x, &y) < 0)
+	DECODE_STATS_START(palette_start)
+	jab_int32 palette_result = readColorPaletteInMaster(matrix, symbol, &module_count, &x, &y);
+	DECODE_STATS_STOP(palette_start, palette_time)
+    if(palette_result < 0)
 	{
 		reportError("Reading color palettes in master symbol failed");
 		return JAB_FAILURE;
@@ -1368,14 +1323,24 @@ jab_int32 decodeMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol)
 	//decode metadata PartII
 	if(decode_partI_ret == JAB_SUCCESS)
 	{
-		if(decodeMasterMetadataPartII(matrix, symbol, data_map, norm_palette, pal_ths, &module_count, &x, &y) <= 0)
+		if(decodeMasterMetadataPartII(matrix, symbol, norm_palette, pal_ths, &module_count, &x, &y) <= 0)
 		{
 			return JAB_FAILURE;
 		}
 	}
 
+	//get the data module layout, the metadata and palette modules precede the data modules
+	jab_vector2d side_size = {matrix->width, matrix->height};
+	const jab_symbol_layout* layout = getSymbolLayout(side_size, 0, color_number, module_count);
+	if(layout == NULL)
+	{
+		return FATAL_ERROR;
+	}
+
 	//decode master symbol
-	return decodeSymbol(matrix, symbol, data_map, norm_palette, pal_ths, 0);
+	jab_int32 ret = decodeSymbol(matrix, symbol, layout, norm_palette, pal_ths, 0);
+	releaseSymbolLayout(layout);
+	return ret;
 }
 
 /**
@@ -1392,19 +1357,13 @@ jab_int32 decodeSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol)
 		return FATAL_ERROR;
 	}
 
-	//create data map
-	jab_byte* data_map = (jab_byte*)calloc(1, matrix->width*matrix->height*sizeof(jab_byte));
-	if(data_map == NULL)
-	{
-		reportError("Memory allocation for data map in slave failed");
-		return FATAL_ERROR;
-	}
-
 	//read color palettes
-	if(readColorPaletteInSlave(matrix, symbol, data_map) < 0)
+	DECODE_STATS_START(palette_start)
+	jab_int32 palette_result = readColorPaletteInSlave(matrix, symbol);
+	DECODE_STATS_STOP(palette_start, palette_time)
+	if(palette_result < 0)
 	{
 		reportError("Reading color palettes in slave symbol failed");
-		free(data_map);
 		return FATAL_ERROR;
 	}
 
@@ -1420,44 +1379,28 @@ jab_int32 decodeSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol)
 		getPaletteThreshold(symbol->palette + i*3, color_number, &pal_ths[i*3]);
 	}
 
-	//decode slave symbol
-	return decodeSymbol(matrix, symbol, data_map, norm_palette, pal_ths, 1);
-}
-
-/**
- * @brief Read bit data
- * @param data the data buffer
- * @param start the start reading offset
- * @param length the length of the data to be read
- * @param value the read data
- * @return the length of the read data
-*/
-jab_int32 readData(jab_data* data, jab_int32 start, jab_int32 length, jab_int32* value)
-{
-	jab_int32 i;
-	jab_int32 val = 0;
-	for(i=start; i<(start + length) && i<data->length; i++)
+	//get the data module layout
+	jab_vector2d side_size = {matrix->width, matrix->height};
+	const jab_symbol_layout* layout = getSymbolLayout(side_size, 1, color_number, 0);
+	if(layout == NULL)
 	{
-		val += data->data[i] << (length - 1 - (i - start));
+		return FATAL_ERROR;
 	}
-	*value = val;
-	return (i - start);
+
+	//decode slave symbol
+	jab_int32 ret = decodeSymbol(matrix, symbol, layout, norm_palette, pal_ths, 1);
+	releaseSymbolLayout(layout);
+	return ret;
 }
 
 /**
- * @brief Interpret decoded bits
- * @param bits the input bits
- * @return the data message
+ * @brief Interpret decoded bits into a caller provided buffer
+ * @param bits the input bit sequence
+ * @param decoded_bytes the output buffer holding at least as many bytes as there are input bits
+ * @return the number of decoded bytes | -1 if failed
 */
-jab_data* decodeData(jab_data* bits)
+jab_int32 decodeDataInto(const jab_bitstream* bits, jab_byte* decoded_bytes)
 {
-	jab_byte* decoded_bytes = (jab_byte *)malloc(bits->length * sizeof(jab_byte));
-	if(decoded_bytes == NULL)
-	{
-		reportError("Memory allocation for decoded bytes failed");
-		return NULL;
-	}
-
 	jab_encode_mode mode = Upper;
 	jab_encode_mode pre_mode = None;
 	jab_int32 index = 0;	//index of input bits
@@ -1471,7 +1414,7 @@ jab_data* decodeData(jab_data* bits)
         jab_int32 n;
         if(mode != Byte)
         {
-            n = readData(bits, index, character_size[mode], &value);
+            n = readBits(bits, index, character_size[mode], &value);
             if(n < character_size[mode])	//did not read enough bits
                 break;
             //update index
@@ -1510,7 +1453,7 @@ jab_data* decodeData(jab_data* bits)
 							break;
 						case 31:
 							//read 2 bits more
-							n = readData(bits, index, 2, &value);
+							n = readBits(bits, index, 2, &value);
 							if(n < 2)	//did not read enough bits
 							{
 								flag = 1;
@@ -1539,8 +1482,7 @@ jab_data* decodeData(jab_data* bits)
 							break;
 						default:
 							reportError("Invalid value decoded");
-							free(decoded_bytes);
-							return NULL;
+							return -1;
 					}
 				}
 				break;
@@ -1573,7 +1515,7 @@ jab_data* decodeData(jab_data* bits)
 							break;
 						case 31:
 							//read 2 bits more
-							n = readData(bits, index, 2, &value);
+							n = readBits(bits, index, 2, &value);
 							if(n < 2)	//did not read enough bits
 							{
 								flag = 1;
@@ -1603,8 +1545,7 @@ jab_data* decodeData(jab_data* bits)
 							break;
 						default:
 							reportError("Invalid value decoded");
-							free(decoded_bytes);
-							return NULL;
+							return -1;
 					}
 				}
 				break;
@@ -1629,7 +1570,7 @@ jab_data* decodeData(jab_data* bits)
 							break;
 						case 15:
 							//read 2 bits more
-							n = readData(bits, index, 2, &value);
+							n = readBits(bits, index, 2, &value);
 							if(n < 2)	//did not read enough bits
 							{
 								flag = 1;
@@ -1659,8 +1600,7 @@ jab_data* decodeData(jab_data* bits)
 							break;
 						default:
 							reportError("Invalid value decoded");
-							free(decoded_bytes);
-							return NULL;
+							return -1;
 					}
 				}
 				break;
@@ -1673,8 +1613,7 @@ jab_data* decodeData(jab_data* bits)
 				else
 				{
 					reportError("Invalid value decoded");
-					free(decoded_bytes);
-					return NULL;
+					return -1;
 				}
 				break;
 			case Mixed:
@@ -1709,8 +1648,7 @@ jab_data* decodeData(jab_data* bits)
 				else
 				{
 					reportError("Invalid value decoded");
-					free(decoded_bytes);
-					return NULL;
+					return -1;
 				}
 				break;
 			case Alphanumeric:
@@ -1723,7 +1661,7 @@ jab_data* decodeData(jab_data* bits)
 				else if(value == 63)
 				{
 					//read 2 bits more
-					n = readData(bits, index, 2, &value);
+					n = readBits(bits, index, 2, &value);
 					if(n < 2)	//did not read enough bits
 					{
 						flag = 1;
@@ -1754,31 +1692,28 @@ jab_data* decodeData(jab_data* bits)
 				else
 				{
 					reportError("Invalid value decoded");
-					free(decoded_bytes);
-					return NULL;
+					return -1;
 				}
 				break;
 			case Byte:
 			{
 				//read 4 bits more
-				n = readData(bits, index, 4, &value);
+				n = readBits(bits, index, 4, &value);
 				if(n < 4)	//did not read enough bits
 				{
                     reportError("Not enough bits to decode");
-					free(decoded_bytes);
-					return NULL;
+					return -1;
 				}
 				//update index
 				index += 4;
 				if(value == 0)		//read the next 13 bits
 				{
 					//read 13 bits more
-					n = readData(bits, index, 13, &value);
+					n = readBits(bits, index, 13, &value);
 					if(n < 13)	//did not read enough bits
 					{
                         reportError("Not enough bits to decode");
-						free(decoded_bytes);
-						return NULL;
+						return -1;
 					}
                     value += 15+1;	//the number of encoded bytes = value + 15
 					//update index
@@ -1788,12 +1723,11 @@ jab_data* decodeData(jab_data* bits)
 				//read the next (byte_length * 8) bits
 				for(jab_int32 i=0; i<byte_length; i++)
 				{
-					n = readData(bits, index, 8, &value);
+					n = readBits(bits, index, 8, &value);
 					if(n < 8)	//did not read enough bits
 					{
                         reportError("Not enough bits to decode");
-						free(decoded_bytes);
-						return NULL;
+						return -1;
 					}
 					//update index
 					index += 8;
@@ -1818,15 +1752,27 @@ jab_data* decodeData(jab_data* bits)
 		if(flag) break;
 	}
 
-	//copy decoded data
-	jab_data* decoded_data = (jab_data *)malloc(sizeof(jab_data) + count * sizeof(jab_byte));
-	if(decoded_data == NULL){
-        reportError("Memory allocation for decoded data failed");
-        return NULL;
-    }
-    decoded_data->length = count;
-    memcpy(decoded_data->data, decoded_bytes, count);
+	return count;
+}
 
-	free(decoded_bytes);
+/**
+ * @brief Interpret decoded bits
+ * @param bits the input bit sequence
+ * @return the data message
+*/
+jab_data* decodeData(const jab_bitstream* bits)
+{
+	jab_data* decoded_data = (jab_data *)malloc(sizeof(jab_data) + bits->length * sizeof(jab_byte));
+	if(decoded_data == NULL)
+	{
+		reportError("Memory allocation for decoded data failed");
+		return NULL;
+	}
+	decoded_data->length = decodeDataInto(bits, (jab_byte*)decoded_data->data);
+	if(decoded_data->length < 0)
+	{
+		free(decoded_data);
+		return NULL;
+	}
 	return decoded_data;
 }
@@ -61,13 +61,34 @@ typedef enum {
 	FNC1
 }jab_encode_mode;
 
+#define COLOR_LUT_BITS		5								//the number of quantization bits per channel in the color lookup table
+#define COLOR_LUT_SIZE		(1 << (3 * COLOR_LUT_BITS))		//the number of cells in the color lookup table of each palette
+#define COLOR_LUT_UNSET		0xFF							//the cell has not been filled yet
+#define COLOR_LUT_MIXED		0xFE							//the cell spans several colors and the module is classified directly
+
+/**
+ * @brief Module color classifier of a symbol, holding a quantized RGB lookup table for each color palette
+*/
+typedef struct {
+	jab_byte*	palette;
+	jab_int32	color_number;
+	jab_float*	norm_palette;
+	jab_float*	pal_ths;
+	jab_byte	lut[];
+}jab_color_classifier;
+
+typedef struct jab_symbol_layout jab_symbol_layout;
+typedef struct jab_bitstream jab_bitstream;
+
 extern jab_int32 decodeMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol);
 extern jab_int32 decodeSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol);
-extern jab_data* decodeData(jab_data* bits);
-extern void deinterleaveData(jab_data* data);
+extern jab_data* decodeData(const jab_bitstream* bits);
+extern jab_int32 decodeDataInto(const jab_bitstream* bits, jab_byte* decoded_bytes);
+extern jab_boolean deinterleaveData(const jab_bitstream* data, jab_bitstream* deinterleaved);
 extern void getNextMetadataModuleInMaster(jab_int32 matrix_height, jab_int32 matrix_width, jab_int32 next_module_count, jab_int32* x, jab_int32* y);
-extern void demaskSymbol(jab_data* data, jab_byte* data_map, jab_vector2d symbol_size, jab_int32 mask_type, jab_int32 color_number);
-extern jab_int32 readColorPaletteInMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte* data_map, jab_int32* module_count, jab_int32* x, jab_int32* y);
-extern jab_int32 readColorPaletteInSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte* data_map);
+extern void demaskSymbol(jab_data* data, const jab_symbol_layout* layout, jab_int32 mask_type, jab_int32 color_number);
+extern jab_int32 readColorPaletteInMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_int32* module_count, jab_int32* x, jab_int32* y);
+extern jab_int32 readColorPaletteInSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol);
+extern jab_int32 getNearestPalette(jab_int32 width, jab_int32 height, jab_int32 x, jab_int32 y);
 
 #endif
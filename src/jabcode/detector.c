@@ -15,10 +15,89 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 #include "jabcode.h"
 #include "detector.h"
 #include "decoder.h"
 #include "encoder.h"
+#include "bitstream.h"
+#include "scratch.h"
+
+_Thread_local jab_decode_stats* decode_stats = NULL;	//the stats collected by the decoding running on this thread
+
+/**
+ * @brief Get the wall time for the decoding stats
+ * @return the time in milliseconds
+*/
+jab_double getStatsTime(void)
+{
+	struct timespec t;
+	timespec_get(&t, TIME_UTC);
+	return (jab_double)t.tv_sec * 1000.0 + (jab_double)t.tv_nsec / 1000000.0;
+}
+
+/**
+ * @brief Record the iterations of an LDPC sub-block in the decoding stats
+ * @param iterations the number of bit-flipping iterations
+*/
+void recordLDPCBlock(jab_int32 iterations)
+{
+	if(decode_stats == NULL) return;
+	if(decode_stats->ldpc_blocks < JAB_STATS_LDPC_BLOCKS)
+		decode_stats->ldpc_block_iterations[decode_stats->ldpc_blocks] = iterations;
+	decode_stats->ldpc_blocks++;
+	decode_stats->ldpc_iterations += iterations;
+}
+
+/**
+ * @brief Add the stats collected by a decoding thread to the decoding stats
+ * @param stats the decoding stats
+ * @param thread_stats the stats of the thread
+*/
+void mergeDecodeStats(jab_decode_stats* stats, const jab_decode_stats* thread_stats)
+{
+	stats->balance_time		+= thread_stats->balance_time;
+	stats->binarize_time	+= thread_stats->binarize_time;
+	stats->detect_time		+= thread_stats->detect_time;
+	stats->sample_time		+= thread_stats->sample_time;
+	stats->palette_time		+= thread_stats->palette_time;
+	stats->module_time		+= thread_stats->module_time;
+	stats->deinterleave_time+= thread_stats->deinterleave_time;
+	stats->ldpc_time		+= thread_stats->ldpc_time;
+	stats->data_time		+= thread_stats->data_time;
+	stats->detect_passes	+= thread_stats->detect_passes;
+	stats->finder_candidates+= thread_stats->finder_candidates;
+	stats->retries			+= thread_stats->retries;
+	for(jab_int32 i=0; i<MIN(thread_stats->ldpc_blocks, JAB_STATS_LDPC_BLOCKS) && stats->ldpc_blocks + i < JAB_STATS_LDPC_BLOCKS; i++)
+		stats->ldpc_block_iterations[stats->ldpc_blocks + i] = thread_stats->ldpc_block_iterations[i];
+	stats->ldpc_blocks		+= thread_stats->ldpc_blocks;
+	stats->ldpc_iterations	+= thread_stats->ldpc_iterations;
+	stats->bytes_allocated	+= thread_stats->bytes_allocated;
+}
+
+/**
+ * @brief Start collecting the stats of a decoding on this thread
+ * @param stats the decoding stats | NULL if not collected
+ * @return the start time
+*/
+jab_double beginDecodeStats(jab_decode_stats* stats)
+{
+	decode_stats = stats;
+	if(stats == NULL) return 0;
+	memset(stats, 0, sizeof(jab_decode_stats));
+	return getStatsTime();
+}
+
+/**
+ * @brief Finish collecting the stats of a decoding on this thread
+ * @param stats the decoding stats | NULL if not collected
+ * @param start the start time
+*/
+void endDecodeStats(jab_decode_stats* stats, jab_double start)
+{
+	if(stats) stats->total_time = getStatsTime() - start;
+	decode_stats = NULL;
+}
 
 /**
  * @brief Check the proportion of layer sizes in finder pattern
@@ -1349,10 +1428,12 @@ void seekMissingFinderPattern(jab_bitmap* bitmap, jab_finder_pattern* fps, jab_i
 	jab_bitmap* rgb[3];
 	for(jab_int32 i=0; i<3; i++)
 	{
-		rgb[i] = (jab_bitmap*)calloc(1, sizeof(jab_bitmap) + area_height*area_width*sizeof(jab_byte));
+		rgb[i] = (jab_bitmap*)scratchCalloc(1, sizeof(jab_bitmap) + area_height*area_width*sizeof(jab_byte));
 		if(rgb[i] == NULL)
 		{
 			JAB_REPORT_INFO(("Memory allocation for binary bitmap failed, the missing finder pattern can not be found."))
+			for(jab_int32 j=0; j<i; j++)
+				scratchFree(rgb[j]);
 			return;
 		}
 		rgb[i]->width = area_width;
@@ -1431,10 +1512,12 @@ void seekMissingFinderPattern(jab_bitmap* bitmap, jab_finder_pattern* fps, jab_i
 		break;
 	}
 	//search for the missing finder pattern
-	jab_finder_pattern* fps_miss = (jab_finder_pattern*)calloc(MAX_FINDER_PATTERNS, sizeof(jab_finder_pattern));
+	jab_finder_pattern* fps_miss = (jab_finder_pattern*)scratchCalloc(MAX_FINDER_PATTERNS, sizeof(jab_finder_pattern));
     if(fps_miss == NULL)
     {
         reportError("Memory allocation for finder patterns failed, the missing finder pattern can not be found.");
+        for(jab_int32 i=0; i<3; i++)
+            scratchFree(rgb[i]);
         return;
     }
     jab_int32 total_finder_patterns = 0;
@@ -1559,6 +1642,9 @@ void seekMissingFinderPattern(jab_bitmap* bitmap, jab_finder_pattern* fps, jab_i
         fps[miss_fp_index].center.x += start_x;
         fps[miss_fp_index].center.y += start_y;
     }
+    scratchFree(fps_miss);
+    for(jab_int32 i=0; i<3; i++)
+        scratchFree(rgb[i]);
 }
 
 /**
@@ -1575,7 +1661,7 @@ jab_finder_pattern* findMasterSymbol(jab_bitmap* bitmap, jab_bitmap* ch[], jab_d
     jab_int32 min_module_size = ch[0]->height / (2 * MAX_SYMBOL_ROWS * MAX_MODULES);
     if(min_module_size < 1 || mode == INTENSIVE_DETECT) min_module_size = 1;
 
-    jab_finder_pattern* fps = (jab_finder_pattern*)calloc(MAX_FINDER_PATTERNS, sizeof(jab_finder_pattern));
+    jab_finder_pattern* fps = (jab_finder_pattern*)scratchCalloc(MAX_FINDER_PATTERNS, sizeof(jab_finder_pattern));
     if(fps == NULL)
     {
         reportError("Memory allocation for finder patterns failed");
@@ -1731,6 +1817,7 @@ jab_finder_pattern* findMasterSymbol(jab_bitmap* bitmap, jab_bitmap* ch[], jab_d
 		fps[i].direction = fps[i].direction >=0 ? 1 : -1;
 	}
 	//select best patterns
+	DECODE_STATS_ADD(finder_candidates, total_finder_patterns)
 	jab_int32 missing_fp_count = selectBestPatterns(fps, total_finder_patterns, fp_type_count);
 
 	//if more than one finder patterns are missing, detection fails
@@ -2299,7 +2386,7 @@ jab_alignment_pattern findAlignmentPattern(jab_bitmap* ch[], jab_float x, jab_fl
 
     for(; radius<radius_max; radius<<=1)
     {
-        jab_alignment_pattern* aps = (jab_alignment_pattern*)calloc(MAX_FINDER_PATTERNS, sizeof(jab_alignment_pattern));
+        jab_alignment_pattern* aps = (jab_alignment_pattern*)scratchCalloc(MAX_FINDER_PATTERNS, sizeof(jab_alignment_pattern));
         if(aps == NULL)
         {
             reportError("Memory allocation for alignment patterns failed");
@@ -2390,11 +2477,11 @@ jab_alignment_pattern findAlignmentPattern(jab_bitmap* ch[], jab_float x, jab_fl
             if(index >= 0) //if found twice, done!
             {
                 ap = aps[index];
-                free(aps);
+                scratchFree(aps);
                 return ap;
             }
         }
-        free(aps);
+        scratchFree(aps);
     }
     ap.type = -1;
     ap.found_count = 0;
@@ -2412,7 +2499,7 @@ jab_alignment_pattern findAlignmentPattern(jab_bitmap* ch[], jab_float x, jab_fl
 */
 jab_boolean findSlaveSymbol(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol* host_symbol, jab_decoded_symbol* slave_symbol, jab_int32 docked_position)
 {
-    jab_alignment_pattern* aps = (jab_alignment_pattern*)calloc(4, sizeof(jab_alignment_pattern));
+    jab_alignment_pattern* aps = (jab_alignment_pattern*)scratchCalloc(4, sizeof(jab_alignment_pattern));
     if(aps == NULL)
     {
         reportError("Memory allocation for alignment patterns failed");
@@ -2578,7 +2665,7 @@ jab_boolean findSlaveSymbol(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_sy
     //if neither ap3 nor ap4 is found, failed
     if(aps[ap3].found_count == 0 && aps[ap4].found_count == 0)
     {
-        free(aps);
+        scratchFree(aps);
         return JAB_FAILURE;
     }
     //if only 3 aps are found, try anyway by estimating the coordinate of the fourth one
@@ -2594,7 +2681,7 @@ jab_boolean findSlaveSymbol(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_sy
         if(aps[ap3].center.x > bitmap->width - 1 || aps[ap3].center.y > bitmap->height - 1)
         {
 			JAB_REPORT_ERROR(("Alignment pattern %d out of image", ap3))
-			free(aps);
+			scratchFree(aps);
 			return JAB_FAILURE;
         }
     }
@@ -2610,7 +2697,7 @@ jab_boolean findSlaveSymbol(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_sy
         if(aps[ap4].center.x > bitmap->width - 1 || aps[ap4].center.y > bitmap->height - 1)
         {
 			JAB_REPORT_ERROR(("Alignment pattern %d out of image", ap4))
-			free(aps);
+			scratchFree(aps);
 			return JAB_FAILURE;
         }
     }
@@ -2632,7 +2719,7 @@ jab_boolean findSlaveSymbol(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_sy
 	saveImage(test_mode_bitmap, "jab_detector_result_slave.png");
 #endif
 
-    free(aps);
+    scratchFree(aps);
     return JAB_SUCCESS;
 }
 
@@ -2969,7 +3056,7 @@ jab_bitmap* sampleSymbolByAlignmentPattern(jab_bitmap* bitmap, jab_bitmap* ch[],
     jab_int32 number_of_ap_y = jab_ap_num[side_ver_y_index];
 
     //buffer for all possible alignment patterns
-	jab_alignment_pattern* aps = (jab_alignment_pattern *)malloc(number_of_ap_x * number_of_ap_y *sizeof(jab_alignment_pattern));
+	jab_alignment_pattern* aps = (jab_alignment_pattern *)scratchMalloc(number_of_ap_x * number_of_ap_y *sizeof(jab_alignment_pattern));
 	if(aps == NULL)
 	{
 		reportError("Memory allocation for alignment patterns failed");
@@ -3132,7 +3219,7 @@ jab_bitmap* sampleSymbolByAlignmentPattern(jab_bitmap* bitmap, jab_bitmap* ch[],
 	jab_int32 height= symbol->side_size.y;
 	jab_int32 mtx_bytes_per_pixel = bitmap->bits_per_pixel / 8;
 	jab_int32 mtx_bytes_per_row = width * mtx_bytes_per_pixel;
-	jab_bitmap* matrix = (jab_bitmap*)malloc(sizeof(jab_bitmap) + width*height*mtx_bytes_per_pixel*sizeof(jab_byte));
+	jab_bitmap* matrix = (jab_bitmap*)scratchMalloc(sizeof(jab_bitmap) + width*height*mtx_bytes_per_pixel*sizeof(jab_byte));
 	if(matrix == NULL)
 	{
 		reportError("Memory allocation for symbol bitmap matrix failed");
@@ -3193,7 +3280,7 @@ jab_bitmap* sampleSymbolByAlignmentPattern(jab_bitmap* bitmap, jab_bitmap* ch[],
 			p2.x = (jab_float)blk_size.x - 3.5f;
 		}
 		//calculate perspective transform matrix for the current block
-		jab_perspective_transform* pt = perspectiveTransform(
+		jab_perspective_transform pt = quad2QuadTransform(
 					p0.x, p0.y,
 					p1.x, p1.y,
 					p2.x, p2.y,
@@ -3202,23 +3289,16 @@ jab_bitmap* sampleSymbolByAlignmentPattern(jab_bitmap* bitmap, jab_bitmap* ch[],
 					aps[rect[i+0].y*number_of_ap_x + rect[i+1].x].center.x, aps[rect[i+0].y*number_of_ap_x + rect[i+1].x].center.y,
 					aps[rect[i+1].y*number_of_ap_x + rect[i+1].x].center.x, aps[rect[i+1].y*number_of_ap_x + rect[i+1].x].center.y,
 					aps[rect[i+1].y*number_of_ap_x + rect[i+0].x].center.x, aps[rect[i+1].y*number_of_ap_x + rect[i+0].x].center.y);
-		if(pt == NULL)
-		{
-			free(aps);
-			free(matrix);
-			return NULL;
-		}
 		//sample the current block
 #if TEST_MODE
 		test_mode_color = 0;
 #endif
-		jab_bitmap* block = sampleSymbol(bitmap, pt, blk_size);
-		free(pt);
+		jab_bitmap* block = sampleSymbol(bitmap, &pt, blk_size);
 		if(block == NULL)
 		{
 			reportError("Sampling block failed");
-			free(aps);
-			free(matrix);
+			scratchFree(aps);
+			scratchFree(matrix);
 			return NULL;
 		}
 		//save the sampled block in the matrix
@@ -3242,13 +3322,13 @@ jab_bitmap* sampleSymbolByAlignmentPattern(jab_bitmap* bitmap, jab_bitmap* ch[],
 				matrix->pixel[mtx_offset + 3] = block->pixel[blk_offset + 3];
 			}
 		}
-		free(block);
+		scratchFree(block);
 	}
 #if TEST_MODE
     saveImage(test_mode_bitmap, "jab_sample_pos_ap.png");
 #endif
 
-	free(aps);
+	scratchFree(aps);
 	return matrix;
 }
 
@@ -3332,7 +3412,10 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
     //find master symbol
     jab_finder_pattern* fps;
     jab_int32 status;
+    DECODE_STATS_START(detect_start)
     fps = findMasterSymbol(bitmap, ch, INTENSIVE_DETECT, &status);
+    DECODE_STATS_STOP(detect_start, detect_time)
+    DECODE_STATS_ADD(detect_passes, 1)
     if(status == FATAL_ERROR) return JAB_FAILURE;
     else if(status == JAB_FAILURE)
     {
@@ -3342,18 +3425,24 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
         //calculate the average pixel value around the found FPs
         jab_float rgb_ave[3];
         getAveragePixelValue(bitmap, fps, rgb_ave);
-        free(fps);
+        scratchFree(fps);
         //binarize the bitmap using the average pixel values as thresholds
-        for(jab_int32 i=0; i<3; free(ch[i++]));
-        if(!binarizerRGB(bitmap, ch, rgb_ave))
+        DECODE_STATS_ADD(retries, 1)
+        DECODE_STATS_START(binarize_start)
+        jab_boolean binarized = binarizeRGB(bitmap, ch, rgb_ave, 0);
+        DECODE_STATS_STOP(binarize_start, binarize_time)
+        if(!binarized)
         {
             return JAB_FAILURE;
         }
         //find master symbol
+        DECODE_STATS_START(redetect_start)
         fps = findMasterSymbol(bitmap, ch, INTENSIVE_DETECT, &status);
+        DECODE_STATS_STOP(redetect_start, detect_time)
+        DECODE_STATS_ADD(detect_passes, 1)
         if(status == JAB_FAILURE || status == FATAL_ERROR)
         {
-            free(fps);
+            scratchFree(fps);
             return JAB_FAILURE;
         }
     }
@@ -3363,7 +3452,7 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
     if(side_size.x == -1 || side_size.y == -1)
     {
 		reportError("Calculating side size failed");
-        free(fps);
+        scratchFree(fps);
 		return JAB_FAILURE;
     }
 #if TEST_MODE
@@ -3371,28 +3460,22 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
 #endif
     //try decoding using only finder patterns
 	//calculate perspective transform matrix
-	jab_perspective_transform* pt = getPerspectiveTransform(fps[0].center, fps[1].center,
-															fps[2].center, fps[3].center,
-															side_size);
-	if(pt == NULL)
-	{
-		free(fps);
-		return JAB_FAILURE;
-	}
+	jab_perspective_transform pt = symbolTransform(fps[0].center, fps[1].center,
+												   fps[2].center, fps[3].center,
+												   side_size);
 
 	//sample master symbol
 #if TEST_MODE
 	test_mode_color = 255;
 #endif
-	jab_bitmap* matrix = sampleSymbol(bitmap, pt, side_size);
-	free(pt);
+	jab_bitmap* matrix = sampleSymbol(bitmap, &pt, side_size);
 #if TEST_MODE
 	saveImage(test_mode_bitmap, "jab_sample_pos_fp.png");
 #endif
 	if(matrix == NULL)
 	{
 		reportError("Sampling master symbol failed");
-		free(fps);
+		scratchFree(fps);
 		return JAB_FAILURE;
 	}
 
@@ -3408,15 +3491,15 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
 
 	//decode master symbol
 	jab_int32 decode_result = decodeMaster(matrix, master_symbol);
-	free(matrix);
+	scratchFree(matrix);
 	if(decode_result == JAB_SUCCESS)
 	{
-		free(fps);
+		scratchFree(fps);
 		return JAB_SUCCESS;
 	}
 	else if(decode_result < 0)	//fatal error occurred
 	{
-		free(fps);
+		scratchFree(fps);
 		return JAB_FAILURE;
 	}
 	else	//if decoding using only finder patterns failed, try decoding using alignment patterns
@@ -3424,10 +3507,11 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
 #if TEST_MODE
 		JAB_REPORT_INFO(("Trying to sample master symbol using alignment pattern..."))
 #endif // TEST_MODE
+		DECODE_STATS_ADD(retries, 1)
 		master_symbol->side_size.x = VERSION2SIZE(master_symbol->metadata.side_version.x);
 		master_symbol->side_size.y = VERSION2SIZE(master_symbol->metadata.side_version.y);
 		matrix = sampleSymbolByAlignmentPattern(bitmap, ch, master_symbol, fps);
-		free(fps);
+		scratchFree(fps);
 		if(matrix == NULL)
 		{
 #if TEST_MODE
@@ -3436,7 +3520,7 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
 			return JAB_FAILURE;
 		}
 		decode_result = decodeMaster(matrix, master_symbol);
-		free(matrix);
+		scratchFree(matrix);
 		if(decode_result == JAB_SUCCESS)
 			return JAB_SUCCESS;
 		else
@@ -3470,28 +3554,165 @@ jab_bitmap* detectSlave(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol
     }
 
     //calculate perspective transform matrix
-    jab_perspective_transform* pt = getPerspectiveTransform(slave_symbol->pattern_positions[0], slave_symbol->pattern_positions[1],
-                                                            slave_symbol->pattern_positions[2], slave_symbol->pattern_positions[3],
-                                                            slave_symbol->side_size);
-    if(pt == NULL)
-    {
-        return NULL;
-    }
+    jab_perspective_transform pt = symbolTransform(slave_symbol->pattern_positions[0], slave_symbol->pattern_positions[1],
+                                                   slave_symbol->pattern_positions[2], slave_symbol->pattern_positions[3],
+                                                   slave_symbol->side_size);
 
     //sample slave symbol
 #if TEST_MODE
 	test_mode_color = 255;
 #endif
-    jab_bitmap* matrix = sampleSymbol(bitmap, pt, slave_symbol->side_size);
+    jab_bitmap* matrix = sampleSymbol(bitmap, &pt, slave_symbol->side_size);
     if(matrix == NULL)
     {
         JAB_REPORT_ERROR(("Sampling slave symbol %d failed", slave_symbol->index))
-        free(pt);
+        return NULL;
+    }
+    return matrix;
+}
+
+/**
+ * @brief Schedule the docked slave symbols of a decoded host symbol as new tasks
+ * @param sched the slave scheduler
+ * @param host the task index of the host symbol
+*/
+void scheduleDockedSlaves(jab_slave_scheduler* sched, jab_int32 host)
+{
+    jab_slave_task* host_task = &sched->tasks[host];
+    for(jab_int32 j=0; j<4; j++)
+    {
+        host_task->children[j] = -1;
+        if((host_task->symbol.metadata.docked_position & (0x08 >> j)) && sched->count < sched->capacity)
+        {
+            jab_slave_task* task = &sched->tasks[sched->count];
+            memset(task, 0, sizeof(jab_slave_task));
+            task->symbol.index = sched->count;
+            task->symbol.host_index = host;
+            task->symbol.metadata = host_task->symbol.slave_metadata[j];
+            task->host = host;
+            task->position = j;
+            task->state = SLAVE_TASK_PENDING;
+            for(jab_int32 k=0; k<4; task->children[k++] = -1);
+            host_task->children[j] = sched->count;
+            sched->count++;
+        }
+    }
+}
+
+/**
+ * @brief Detect and decode a slave symbol
+ * @param bitmap the image bitmap
+ * @param ch the binarized color channels of the image
+ * @param host_symbol the host symbol
+ * @param slave_symbol the slave symbol
+ * @param docked_position the docked position
+ * @return SLAVE_TASK_DONE | SLAVE_TASK_DETECT_FAILED | SLAVE_TASK_DECODE_FAILED
+*/
+jab_slave_task_state decodeSlaveSymbol(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol* host_symbol, jab_decoded_symbol* slave_symbol, jab_int32 docked_position)
+{
+    jab_bitmap* matrix = detectSlave(bitmap, ch, host_symbol, slave_symbol, docked_position);
+    if(matrix == NULL)
+    {
+        return SLAVE_TASK_DETECT_FAILED;
+    }
+    jab_int32 decode_result = decodeSlave(matrix, slave_symbol);
+    scratchFree(matrix);
+    return decode_result > 0 ? SLAVE_TASK_DONE : SLAVE_TASK_DECODE_FAILED;
+}
+
+/**
+ * @brief Worker thread running slave decoding tasks until no task is left
+ * @param arg the slave scheduler
+ * @return NULL
+*/
+void* slaveDecodingWorker(void* arg)
+{
+    jab_slave_scheduler* sched = (jab_slave_scheduler*)arg;
+    //the stats of this thread are added to the decoding stats when the worker ends
+    jab_decode_stats thread_stats;
+    if(sched->stats)
+    {
+        memset(&thread_stats, 0, sizeof(jab_decode_stats));
+        decode_stats = &thread_stats;
+    }
+    decode_scratch = sched->scratch;
+    pthread_mutex_lock(&sched->lock);
+    while(1)
+    {
+        //wait until a task is available or all tasks are finished
+        while(sched->next == sched->count && sched->running > 0)
+        {
+            pthread_cond_wait(&sched->cond, &sched->lock);
+        }
+        if(sched->next == sched->count)
+        {
+            break;
+        }
+        jab_slave_task* task = &sched->tasks[sched->next++];
+        sched->running++;
+        pthread_mutex_unlock(&sched->lock);
+
+        //the host task is finished, so its symbol is not modified any more
+        jab_slave_task_state state = decodeSlaveSymbol(sched->bitmap, sched->ch, &sched->tasks[task->host].symbol, &task->symbol, task->position);
+
+        pthread_mutex_lock(&sched->lock);
+        task->state = state;
+        if(state == SLAVE_TASK_DONE)
+        {
+            //the slaves of this symbol can be scheduled as soon as its metadata is decoded
+            scheduleDockedSlaves(sched, (jab_int32)(task - sched->tasks));
+        }
+        sched->running--;
+        pthread_cond_broadcast(&sched->cond);
+    }
+    if(sched->stats)
+    {
+        mergeDecodeStats(sched->stats, &thread_stats);
+        decode_stats = NULL;
+    }
+    decode_scratch = NULL;
+    pthread_mutex_unlock(&sched->lock);
+    return NULL;
+}
+
+/**
+ * @brief Detect and decode all docked slave symbols concurrently
+ * @param sched the slave scheduler, whose first task holds the decoded master symbol
+ * @param thread_number the number of worker threads
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean runSlaveScheduler(jab_slave_scheduler* sched, jab_int32 thread_number)
+{
+    if(pthread_mutex_init(&sched->lock, NULL) != 0)
+    {
+        return JAB_FAILURE;
+    }
+    if(pthread_cond_init(&sched->cond, NULL) != 0)
+    {
+        pthread_mutex_destroy(&sched->lock);
         return JAB_FAILURE;
     }
+    sched->next = 1;
+    sched->running = 0;
 
-    free(pt);
-    return matrix;
+    pthread_t threads[thread_number];
+    jab_int32 started = 0;
+    for(jab_int32 i=0; i<thread_number; i++)
+    {
+        if(pthread_create(&threads[started], NULL, slaveDecodingWorker, sched) == 0)
+        {
+            started++;
+        }
+    }
+    //if no thread could be started, the slave symbols will be decoded serially by the caller
+    for(jab_int32 i=0; i<started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&sched->cond);
+    pthread_mutex_destroy(&sched->lock);
+    return started > 0 ? JAB_SUCCESS : JAB_FAILURE;
 }
 
 /**
@@ -3501,9 +3722,12 @@ jab_bitmap* detectSlave(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol
  * @param symbols the symbol list
  * @param host_index the index number of the host symbol
  * @param total the number of symbols in the list
+ * @param sched the slave scheduler holding the concurrently decoded slave symbols | NULL if not available
+ * @param task_index the task index of each symbol in the list, -1 if the symbol is not a scheduled task
  * @return JAB_SUCCESS | JAB_FAILURE
 */
-jab_boolean decodeDockedSlaves(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol* symbols, jab_int32 host_index, jab_int32* total)
+jab_boolean decodeDockedSlaves(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol* symbols, jab_int32 host_index, jab_int32* total,
+							   jab_slave_scheduler* sched, jab_int32* task_index)
 {
     jab_int32 docked_positions[4] = {0};
     docked_positions[0] = symbols[host_index].metadata.docked_position & 0x08;
@@ -3515,43 +3739,133 @@ jab_boolean decodeDockedSlaves(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded
     {
         if(docked_positions[j] > 0 && (*total)<MAX_SYMBOL_NUMBER)
         {
+            jab_slave_task_state state;
+            jab_int32 task = -1;
+            if(sched && task_index[host_index] >= 0)
+            {
+                task = sched->tasks[task_index[host_index]].children[j];
+            }
+            if(task >= 0)
+            {
+                //take over the concurrently decoded slave symbol
+                symbols[*total] = sched->tasks[task].symbol;
+                sched->tasks[task].symbol.palette = NULL;
+                sched->tasks[task].symbol.data = NULL;
+                state = sched->tasks[task].state;
+            }
+            else
+            {
+                symbols[*total].metadata = symbols[host_index].slave_metadata[j];
+                state = decodeSlaveSymbol(bitmap, ch, &symbols[host_index], &symbols[*total], j);
+            }
             symbols[*total].index = *total;
             symbols[*total].host_index = host_index;
-            symbols[*total].metadata = symbols[host_index].slave_metadata[j];
-            jab_bitmap* matrix = detectSlave(bitmap, ch, &symbols[host_index], &symbols[*total], j);
-            if(matrix == NULL)
+            task_index[*total] = task;
+            if(state == SLAVE_TASK_DETECT_FAILED)
             {
                 JAB_REPORT_ERROR(("Detecting slave symbol %d failed", symbols[*total].index))
                 return JAB_FAILURE;
             }
-            if(decodeSlave(matrix, &symbols[*total]) > 0)
+            if(state != SLAVE_TASK_DONE)
             {
-                (*total)++;
-                free(matrix);
-            }
-            else
-            {
-                free(matrix);
                 return JAB_FAILURE;
             }
+            (*total)++;
         }
     }
     return JAB_SUCCESS;
 }
 
 /**
- * @brief Extended function to decode a JAB Code
+ * @brief Make sure the binarized channel buffers of a decoder hold a bitmap
+ * @param dec the decoder
+ * @param bitmap the image bitmap
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean reserveDecoderChannels(jab_decoder* dec, jab_bitmap* bitmap)
+{
+	jab_int32 pixel_number = bitmap->width * bitmap->height;
+	if(pixel_number <= dec->ch_capacity)
+		return JAB_SUCCESS;
+	for(jab_int32 i=0; i<3; i++)
+	{
+		free(dec->ch[i]);
+		dec->ch[i] = (jab_bitmap*)malloc(sizeof(jab_bitmap) + pixel_number * sizeof(jab_byte));
+	}
+	free(dec->ch_tmp);
+	dec->ch_tmp = (jab_byte*)malloc(pixel_number * sizeof(jab_byte));
+	if(dec->ch[0] == NULL || dec->ch[1] == NULL || dec->ch[2] == NULL || dec->ch_tmp == NULL)
+	{
+		reportError("Memory allocation for binary bitmap failed");
+		dec->ch_capacity = 0;
+		return JAB_FAILURE;
+	}
+	dec->ch_capacity = pixel_number;
+	DECODE_STATS_ADD(bytes_allocated, (jab_int64)(3 * sizeof(jab_bitmap) + 4 * (size_t)pixel_number))
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Make sure a decoder buffer holds a number of elements
+ * @param buffer the buffer, freed if it has to be replaced
+ * @param capacity the number of elements the buffer holds
+ * @param number the required number of elements
+ * @param header_size the size of the buffer header
+ * @param element_size the size of an element
+ * @return the buffer holding the required number of elements | NULL if failed
+*/
+void* reserveDecoderBuffer(void* buffer, jab_int32* capacity, jab_int32 number, size_t header_size, size_t element_size)
+{
+	if(buffer && number <= *capacity)
+		return buffer;
+	free(buffer);
+	buffer = malloc(header_size + number * element_size);
+	if(buffer == NULL)
+	{
+		reportError("Memory allocation for decoder buffer failed");
+		*capacity = 0;
+		return NULL;
+	}
+	DECODE_STATS_ADD(bytes_allocated, (jab_int64)(header_size + number * element_size))
+	*capacity = number;
+	return buffer;
+}
+
+/**
+ * @brief Free the buffers held by a decoder
+ * @param dec the decoder
+*/
+void releaseDecoderBuffers(jab_decoder* dec)
+{
+	for(jab_int32 i=0; i<3; i++)
+	{
+		free(dec->ch[i]);
+	}
+	free(dec->ch_tmp);
+	free(dec->frame);
+	free(dec->tasks);
+	free(dec->bits);
+	free(dec->result);
+	releaseScratch(&dec->scratch);
+	memset(dec, 0, sizeof(jab_decoder));
+}
+
+/**
+ * @brief Decode a JAB Code using the buffers of a decoder
+ * @param dec the decoder
  * @param bitmap the image bitmap
  * @param mode the decoding mode(NORMAL_DECODE: only output completely decoded data when all symbols are correctly decoded
  *								 COMPATIBLE_DECODE: also output partly decoded data even if some symbols are not correctly decoded
  * @param status the decoding status code (0: not detectable, 1: not decodable, 2: partly decoded with COMPATIBLE_DECODE mode, 3: fully decoded)
  * @param symbols the decoded symbols
  * @param max_symbol_number the maximal possible number of symbols to be decoded
- * @return the decoded data | NULL if failed
+ * @param balanced set if the colors of the bitmap are already balanced
+ * @return the decoded data held by the decoder | NULL if failed
 */
-jab_data* decodeJABCodeEx(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number)
+jab_data* decodeWithDecoderBuffers(jab_decoder* dec, jab_bitmap* bitmap, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number, jab_boolean balanced)
 {
 	if(status) *status = 0;
+	dec->symbol_number = 0;
 	if(!symbols)
 	{
 		reportError("Invalid symbol buffer");
@@ -3559,9 +3873,21 @@ jab_data* decodeJABCodeEx(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status,
 	}
 
 	//binarize r, g, b channels
-	jab_bitmap* ch[3];
-	balanceRGB(bitmap);
-    if(!binarizerRGB(bitmap, ch, 0))
+	if(!reserveDecoderChannels(dec, bitmap))
+	{
+		return NULL;
+	}
+	jab_bitmap** ch = dec->ch;
+	if(!balanced)
+	{
+		DECODE_STATS_START(balance_start)
+		balanceRGB(bitmap);
+		DECODE_STATS_STOP(balance_start, balance_time)
+	}
+	DECODE_STATS_START(binarize_start)
+	jab_boolean binarized = binarizeRGB(bitmap, ch, 0, dec->ch_tmp);
+	DECODE_STATS_STOP(binarize_start, binarize_time)
+    if(!binarized)
 	{
 		return NULL;
 	}
@@ -3595,27 +3921,67 @@ jab_data* decodeJABCodeEx(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status,
     //detect and decode docked slave symbols recursively
     if(total>0)
     {
+    	//decode the docked slave symbols concurrently, as a slave can be decoded as soon as its host is decoded
+    	jab_slave_scheduler sched_buf;
+    	jab_slave_scheduler* sched = NULL;
+#if !TEST_MODE
+    	jab_int32 slave_threads = dec->slave_threads > 0 ? dec->slave_threads : SLAVE_DECODE_THREADS;
+    	if(symbols[0].metadata.docked_position > 0 && max_symbol_number > 1 && slave_threads > 1)
+    	{
+    		dec->tasks = (jab_slave_task*)reserveDecoderBuffer(dec->tasks, &dec->task_capacity, max_symbol_number, 0, sizeof(jab_slave_task));
+    		if(dec->tasks)
+    		{
+    			sched_buf.tasks = dec->tasks;
+    			sched_buf.bitmap = bitmap;
+    			sched_buf.ch = ch;
+    			sched_buf.stats = decode_stats;
+    			sched_buf.scratch = decode_scratch;
+    			sched_buf.capacity = max_symbol_number;
+    			memset(&sched_buf.tasks[0], 0, sizeof(jab_slave_task));
+    			sched_buf.tasks[0].symbol = symbols[0];
+    			sched_buf.tasks[0].state = SLAVE_TASK_DONE;
+    			sched_buf.count = 1;
+    			scheduleDockedSlaves(&sched_buf, 0);
+    			if(runSlaveScheduler(&sched_buf, slave_threads))
+    			{
+    				sched = &sched_buf;
+    			}
+    		}
+    	}
+#endif
+    	//collect the slave symbols in breadth-first order, which keeps the symbol order deterministic
+    	jab_int32 task_index[max_symbol_number];
+    	task_index[0] = 0;
         for(jab_int32 i=0; i<total && total<max_symbol_number; i++)
         {
-            if(!decodeDockedSlaves(bitmap, ch, symbols, i, &total))
+            if(!decodeDockedSlaves(bitmap, ch, symbols, i, &total, sched, task_index))
             {
                 res = 0;
                 break;
             }
         }
+        if(sched)
+        {
+        	//release the slave symbols not taken over
+        	for(jab_int32 i=1; i<sched->count; i++)
+        	{
+        		scratchFree(sched->tasks[i].symbol.palette);
+        		scratchFree(sched->tasks[i].symbol.data);
+        	}
+        }
     }
 
     //check result
+    dec->symbol_number = total;
 	if(total == 0 || (mode == NORMAL_DECODE && res == 0 ))
 	{
 		if(symbols[0].module_size > 0 && status)
 			*status = 1;
 		//clean memory
-		for(jab_int32 i=0; i<3; free(ch[i++]));
 		for(jab_int32 i=0; i<=MIN(total, max_symbol_number-1); i++)
 		{
-			free(symbols[i].palette);
-			free(symbols[i].data);
+			scratchFree(symbols[i].palette);
+			scratchFree(symbols[i].data);
 		}
         return NULL;
 	}
@@ -3625,31 +3991,38 @@ jab_data* decodeJABCodeEx(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status,
 		res = 1;
 	}
 
-	//concatenate the decoded data
+	//concatenate the decoded data, the data of a single symbol is decoded in place
     jab_int32 total_data_length = 0;
     for(jab_int32 i=0; i<total; i++)
     {
         total_data_length += symbols[i].data->length;
     }
-    jab_data* decoded_bits = (jab_data *)malloc(sizeof(jab_data) + total_data_length * sizeof(jab_char));
-    if(decoded_bits == NULL){
-        reportError("Memory allocation for decoded bits failed");
+    dec->result = (jab_data*)reserveDecoderBuffer(dec->result, &dec->result_capacity, total_data_length, sizeof(jab_data), sizeof(jab_char));
+    if(total > 1)
+        dec->bits = (jab_bitstream*)reserveDecoderBuffer(dec->bits, &dec->bits_capacity, BITSTREAM_WORD_NUMBER(total_data_length), sizeof(jab_bitstream), sizeof(jab_uint32));
+    if(dec->result == NULL || (total > 1 && dec->bits == NULL))
+    {
         if(status) *status = 1;
         return NULL;
     }
-    jab_int32 offset = 0;
-    for(jab_int32 i=0; i<total; i++)
+    jab_bitstream* decoded_bits = symbols[0].data;
+    if(total > 1)
     {
-        jab_char* src = symbols[i].data->data;
-        jab_char* dst = decoded_bits->data;
-        dst += offset;
-        memcpy(dst, src, symbols[i].data->length);
-        offset += symbols[i].data->length;
+        decoded_bits = dec->bits;
+        decoded_bits->length = total_data_length;
+        jab_int32 offset = 0;
+        for(jab_int32 i=0; i<total; i++)
+        {
+            copyBits(decoded_bits, offset, symbols[i].data, 0, symbols[i].data->length);
+            offset += symbols[i].data->length;
+        }
     }
-    decoded_bits->length = total_data_length;
     //decode data
-    jab_data* decoded_data = decodeData(decoded_bits);
-    if(decoded_data == NULL)
+    jab_data* decoded_data = dec->result;
+    DECODE_STATS_START(data_start)
+    decoded_data->length = decodeDataInto(decoded_bits, (jab_byte*)decoded_data->data);
+    DECODE_STATS_STOP(data_start, data_time)
+    if(decoded_data->length < 0)
 	{
 		reportError("Decoding data failed");
 		if(status) *status = 1;
@@ -3657,13 +4030,11 @@ jab_data* decodeJABCodeEx(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status,
 	}
 
     //clean memory
-    for(jab_int32 i=0; i<3; free(ch[i++]));
     for(jab_int32 i=0; i<=MIN(total, max_symbol_number-1); i++)
     {
-		free(symbols[i].palette);
-		free(symbols[i].data);
+		scratchFree(symbols[i].palette);
+		scratchFree(symbols[i].data);
     }
-    free(decoded_bits);
 #if TEST_MODE
 	free(test_mode_bitmap);
 #endif // TEST_MODE
@@ -3676,6 +4047,228 @@ jab_data* decodeJABCodeEx(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status,
     return decoded_data;
 }
 
+/**
+ * @brief Decode a JAB Code using the buffers and the scratch memory of a decoder
+ * @param dec the decoder
+ * @param bitmap the image bitmap
+ * @param mode the decoding mode(NORMAL_DECODE: only output completely decoded data when all symbols are correctly decoded
+ *								 COMPATIBLE_DECODE: also output partly decoded data even if some symbols are not correctly decoded
+ * @param status the decoding status code (0: not detectable, 1: not decodable, 2: partly decoded with COMPATIBLE_DECODE mode, 3: fully decoded)
+ * @param symbols the decoded symbols
+ * @param max_symbol_number the maximal possible number of symbols to be decoded
+ * @param balanced set if the colors of the bitmap are already balanced
+ * @return the decoded data held by the decoder | NULL if failed
+*/
+jab_data* decodeWithDecoder(jab_decoder* dec, jab_bitmap* bitmap, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number, jab_boolean balanced)
+{
+	//the per-decoding buffers are taken from the scratch memory of the decoder on this thread
+	decode_scratch = &dec->scratch;
+	jab_data* decoded_data = decodeWithDecoderBuffers(dec, bitmap, mode, status, symbols, max_symbol_number, balanced);
+	decode_scratch = NULL;
+	return decoded_data;
+}
+
+/**
+ * @brief Extended function to decode a JAB Code
+ * @param bitmap the image bitmap
+ * @param mode the decoding mode(NORMAL_DECODE: only output completely decoded data when all symbols are correctly decoded
+ *								 COMPATIBLE_DECODE: also output partly decoded data even if some symbols are not correctly decoded
+ * @param status the decoding status code (0: not detectable, 1: not decodable, 2: partly decoded with COMPATIBLE_DECODE mode, 3: fully decoded)
+ * @param symbols the decoded symbols
+ * @param max_symbol_number the maximal possible number of symbols to be decoded
+ * @return the decoded data | NULL if failed
+*/
+jab_data* decodeJABCodeEx(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number)
+{
+	jab_decoder dec;
+	memset(&dec, 0, sizeof(jab_decoder));
+	if(!initScratch(&dec.scratch))
+	{
+		if(status) *status = 0;
+		return NULL;
+	}
+	jab_data* decoded_data = decodeWithDecoder(&dec, bitmap, mode, status, symbols, max_symbol_number, 0);
+	if(decoded_data)
+	{
+		dec.result = NULL;	//the decoded data is handed over to the caller
+	}
+	releaseDecoderBuffers(&dec);
+	return decoded_data;
+}
+
+/**
+ * @brief Create a reusable decoder
+ * @return the decoder | NULL if failed
+*/
+jab_decoder* createDecoder(void)
+{
+	jab_decoder* dec = (jab_decoder*)calloc(1, sizeof(jab_decoder));
+	if(dec == NULL)
+	{
+		reportError("Memory allocation for decoder failed");
+		return NULL;
+	}
+	if(!initScratch(&dec->scratch))
+	{
+		free(dec);
+		return NULL;
+	}
+	return dec;
+}
+
+/**
+ * @brief Destroy a decoder
+ * @param dec the decoder
+*/
+void destroyDecoder(jab_decoder* dec)
+{
+	if(dec == NULL) return;
+	releaseDecoderBuffers(dec);
+	free(dec);
+}
+
+/**
+ * @brief Decode a JAB Code reusing the buffers of a decoder
+ * @param dec the decoder
+ * @param bitmap the image bitmap
+ * @param mode the decoding mode(NORMAL_DECODE: only output completely decoded data when all symbols are correctly decoded
+ *								 COMPATIBLE_DECODE: also output partly decoded data even if some symbols are not correctly decoded
+ * @param status the decoding status code (0: not detectable, 1: not decodable, 2: partly decoded with COMPATIBLE_DECODE mode, 3: fully decoded)
+ * @return the decoded data, owned by the decoder and valid until its next use | NULL if failed
+*/
+jab_data* decodeJABCodeWithDecoder(jab_decoder* dec, jab_bitmap* bitmap, jab_int32 mode, jab_int32* status)
+{
+	if(dec == NULL)
+	{
+		reportError("Invalid decoder");
+		if(status) *status = 0;
+		return NULL;
+	}
+	jab_double start = beginDecodeStats(dec->stats);
+	jab_data* decoded_data = decodeWithDecoder(dec, bitmap, mode, status, dec->symbols, MAX_SYMBOL_NUMBER, 0);
+	endDecodeStats(dec->stats, start);
+	return decoded_data;
+}
+
+/**
+ * @brief Let a decoder fill per-stage timing and counters in each decoding
+ * @param dec the decoder
+ * @param stats the stats filled by each decoding | NULL to stop collecting
+*/
+void setDecoderStats(jab_decoder* dec, jab_decode_stats* stats)
+{
+	if(dec) dec->stats = stats;
+}
+
+/**
+ * @brief Set the number of threads a decoder uses to decode the docked slave symbols
+ * @param dec the decoder
+ * @param thread_number the number of threads, 1 to decode the slave symbols inline | 0 for the default
+*/
+void setDecoderSlaveThreads(jab_decoder* dec, jab_int32 thread_number)
+{
+	if(dec) dec->slave_threads = MAX(thread_number, 0);
+}
+
+/**
+ * @brief Get the number of symbols found in the last decoding of a decoder
+ * @param dec the decoder
+ * @return the number of decoded symbols
+*/
+jab_int32 getDecodedSymbolNumber(const jab_decoder* dec)
+{
+	return dec ? dec->symbol_number : 0;
+}
+
+/**
+ * @brief Decode a JAB Code in a caller-owned image buffer, which is left unchanged
+ * @param dec the decoder, holding the color balanced copy of the image
+ * @param view the image view
+ * @param mode the decoding mode(NORMAL_DECODE: only output completely decoded data when all symbols are correctly decoded
+ *								 COMPATIBLE_DECODE: also output partly decoded data even if some symbols are not correctly decoded
+ * @param status the decoding status code (0: not detectable, 1: not decodable, 2: partly decoded with COMPATIBLE_DECODE mode, 3: fully decoded)
+ * @return the decoded data, owned by the decoder and valid until its next use | NULL if failed
+*/
+jab_data* decodeJABCodeView(jab_decoder* dec, const jab_bitmap_view* view, jab_int32 mode, jab_int32* status)
+{
+	if(status) *status = 0;
+	jab_int32 bytes_per_pixel, offset[4];
+	if(dec == NULL || view == NULL || view->pixels == NULL || view->width <= 0 || view->height <= 0 ||
+	   !getPixelLayout(view->format, &bytes_per_pixel, offset) || view->stride < view->width * bytes_per_pixel)
+	{
+		reportError("Invalid decoder or image view");
+		return NULL;
+	}
+	//the color balancing reads the view and writes the only copy of the image
+	jab_double start = beginDecodeStats(dec->stats);
+	jab_data* decoded_data = NULL;
+	dec->frame = (jab_bitmap*)reserveDecoderBuffer(dec->frame, &dec->frame_capacity, view->width * view->height, sizeof(jab_bitmap), BITMAP_CHANNEL_COUNT);
+	if(dec->frame)
+	{
+		DECODE_STATS_START(balance_start)
+		jab_boolean balanced = balanceRGBView(view, dec->frame);
+		DECODE_STATS_STOP(balance_start, balance_time)
+		if(balanced)
+			decoded_data = decodeWithDecoder(dec, dec->frame, mode, status, dec->symbols, MAX_SYMBOL_NUMBER, 1);
+	}
+	endDecodeStats(dec->stats, start);
+	return decoded_data;
+}
+
+/**
+ * @brief Decode a JAB Code in a caller-owned planar YUV frame, which is left unchanged
+ * @param dec the decoder, holding the color balanced RGB copy of the frame
+ * @param yuv the YUV frame
+ * @param mode the decoding mode(NORMAL_DECODE: only output completely decoded data when all symbols are correctly decoded
+ *								 COMPATIBLE_DECODE: also output partly decoded data even if some symbols are not correctly decoded
+ * @param status the decoding status code (0: not detectable, 1: not decodable, 2: partly decoded with COMPATIBLE_DECODE mode, 3: fully decoded)
+ * @return the decoded data, owned by the decoder and valid until its next use | NULL if failed
+*/
+jab_data* decodeJABCodeYUV(jab_decoder* dec, const jab_yuv_view* yuv, jab_int32 mode, jab_int32* status)
+{
+	if(status) *status = 0;
+	if(dec == NULL || yuv == NULL || yuv->width <= 0 || yuv->height <= 0 ||
+	   yuv->planes[0] == NULL || yuv->planes[1] == NULL || yuv->strides[0] < yuv->width)
+	{
+		reportError("Invalid decoder or YUV frame");
+		return NULL;
+	}
+	jab_int32 chroma_width = (yuv->width + 1) / 2;
+	jab_boolean valid_chroma;
+	switch(yuv->format)
+	{
+	case JAB_YUV_NV12:
+	case JAB_YUV_NV21:
+		valid_chroma = yuv->strides[1] >= chroma_width * 2;
+		break;
+	case JAB_YUV_I420:
+		valid_chroma = yuv->planes[2] != NULL && yuv->strides[1] >= chroma_width && yuv->strides[2] >= chroma_width;
+		break;
+	default:
+		valid_chroma = 0;
+		break;
+	}
+	if(!valid_chroma)
+	{
+		reportError("Invalid chroma planes of YUV frame");
+		return NULL;
+	}
+	//the color conversion and balancing read the planes and write the only RGB copy of the frame
+	jab_double start = beginDecodeStats(dec->stats);
+	jab_data* decoded_data = NULL;
+	dec->frame = (jab_bitmap*)reserveDecoderBuffer(dec->frame, &dec->frame_capacity, yuv->width * yuv->height, sizeof(jab_bitmap), BITMAP_CHANNEL_COUNT);
+	if(dec->frame)
+	{
+		DECODE_STATS_START(balance_start)
+		jab_boolean balanced = balanceYUVView(yuv, dec->frame);
+		DECODE_STATS_STOP(balance_start, balance_time)
+		if(balanced)
+			decoded_data = decodeWithDecoder(dec, dec->frame, mode, status, dec->symbols, MAX_SYMBOL_NUMBER, 1);
+	}
+	endDecodeStats(dec->stats, start);
+	return decoded_data;
+}
+
 /**
  * @brief Decode a JAB Code
  * @param bitmap the image bitmap
@@ -14,6 +14,9 @@
 #ifndef JABCODE_DETECTOR_H
 #define JABCODE_DETECTOR_H
 
+#include <pthread.h>
+#include "scratch.h"
+
 #define TEST_MODE			0
 #if TEST_MODE
 jab_bitmap* test_mode_bitmap;
@@ -26,9 +29,15 @@ jab_int32	test_mode_color;
 #define MAX_FINDER_PATTERNS 500
 #define PI 					3.14159265
 #define CROSS_AREA_WIDTH	14	//the width of the area across the host and slave symbols
+#define SLAVE_DECODE_THREADS 4	//the default number of worker threads decoding docked slave symbols
 
 #define DIST(x1, y1, x2, y2) (jab_float)(sqrt((x1-x2)*(x1-x2) + (y1-y2)*(y1-y2)))
 
+//stage timing and counters, only a test of the thread-local stats pointer if no stats are collected
+#define DECODE_STATS_START(t)		jab_double t = decode_stats ? getStatsTime() : 0;
+#define DECODE_STATS_STOP(t, field)	{ if(decode_stats) decode_stats->field += getStatsTime() - t; }
+#define DECODE_STATS_ADD(field, n)	{ if(decode_stats) decode_stats->field += (n); }
+
 /**
  * @brief Detection modes
 */
@@ -65,13 +74,102 @@ typedef struct {
 	jab_float a33;
 }jab_perspective_transform;
 
+/**
+ * @brief States of a slave decoding task
+*/
+typedef enum
+{
+	SLAVE_TASK_PENDING = 0,
+	SLAVE_TASK_DONE,
+	SLAVE_TASK_DETECT_FAILED,
+	SLAVE_TASK_DECODE_FAILED
+}jab_slave_task_state;
+
+/**
+ * @brief Slave decoding task, i.e. a node in the symbol docking graph
+*/
+typedef struct {
+	jab_decoded_symbol	symbol;
+	jab_int32			host;			//task index of the host symbol
+	jab_int32			position;		//docked position at the host symbol
+	jab_int32			children[4];	//task indexes of the docked slave symbols, -1 if not scheduled
+	jab_slave_task_state state;
+}jab_slave_task;
+
+/**
+ * @brief Scheduler of the slave decoding tasks
+*/
+typedef struct {
+	jab_bitmap*		bitmap;
+	jab_bitmap**	ch;
+	jab_decode_stats* stats;		//the decoding stats the workers add to, NULL if not collected
+	jab_scratch*	scratch;		//the scratch memory of the decoding, shared by the workers
+	jab_slave_task*	tasks;
+	jab_int32		capacity;		//the maximal number of tasks
+	jab_int32		count;			//the number of scheduled tasks
+	jab_int32		next;			//the index of the next task to be run
+	jab_int32		running;		//the number of tasks being run
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+}jab_slave_scheduler;
+
+/**
+ * @brief Reusable decoder, holding the buffers sized to the largest frame and code decoded so far
+*/
+struct jab_decoder {
+	jab_bitmap*		ch[3];			//the binarized color channels
+	jab_byte*		ch_tmp;			//the temporary buffer for filtering the binarized channels
+	jab_int32		ch_capacity;	//the number of pixels each channel buffer holds
+	jab_bitmap*		frame;			//the color balanced copy of an image view
+	jab_int32		frame_capacity;	//the number of pixels the frame buffer holds
+	jab_slave_task*	tasks;
+	jab_int32		task_capacity;
+	struct jab_bitstream* bits;
+	jab_int32		bits_capacity;	//the number of words the bit buffer holds
+	jab_data*		result;
+	jab_int32		result_capacity;
+	jab_decoded_symbol symbols[MAX_SYMBOL_NUMBER];
+	jab_int32		symbol_number;	//the number of symbols found in the last decoding
+	jab_decode_stats* stats;		//the stats filled by each decoding, NULL if not collected
+	jab_int32		slave_threads;	//the number of threads decoding the docked slave symbols, 0 for the default, 1 to decode them inline
+	jab_scratch		scratch;		//the memory of the per-decoding buffers, kept for the next decoding
+};
+
+extern _Thread_local jab_decode_stats* decode_stats;
+
+extern jab_double getStatsTime(void);
+extern void recordLDPCBlock(jab_int32 iterations);
 extern void getAveVar(jab_byte* rgb, jab_double* ave, jab_double* var);
 extern void getMinMax(jab_byte* rgb, jab_byte* min, jab_byte* mid, jab_byte* max, jab_int32* index_min, jab_int32* index_mid, jab_int32* index_max);
 extern void balanceRGB(jab_bitmap* bitmap);
+extern jab_boolean balanceRGBView(const jab_bitmap_view* view, jab_bitmap* bitmap);
+extern jab_boolean getPixelLayout(jab_pixel_format format, jab_int32* bytes_per_pixel, jab_int32 offset[4]);
+extern jab_boolean balanceYUVView(const jab_yuv_view* yuv, jab_bitmap* bitmap);
 extern jab_boolean binarizerRGB(jab_bitmap* bitmap, jab_bitmap* rgb[3], jab_float* blk_ths);
+extern jab_boolean binarizeRGB(jab_bitmap* bitmap, jab_bitmap* rgb[3], jab_float* blk_ths, jab_byte* tmp);
 extern jab_bitmap* binarizer(jab_bitmap* bitmap, jab_int32 channel);
 extern jab_bitmap* binarizerHist(jab_bitmap* bitmap, jab_int32 channel);
 extern jab_bitmap* binarizerHard(jab_bitmap* bitmap, jab_int32 channel, jab_int32 threshold);
+extern jab_perspective_transform square2QuadTransform(jab_float x0, jab_float y0,
+													  jab_float x1, jab_float y1,
+													  jab_float x2, jab_float y2,
+													  jab_float x3, jab_float y3);
+extern jab_perspective_transform quad2SquareTransform(jab_float x0, jab_float y0,
+													  jab_float x1, jab_float y1,
+													  jab_float x2, jab_float y2,
+													  jab_float x3, jab_float y3);
+extern jab_perspective_transform multiplyTransform(const jab_perspective_transform* m1, const jab_perspective_transform* m2);
+extern jab_perspective_transform quad2QuadTransform(jab_float x0, jab_float y0,
+													jab_float x1, jab_float y1,
+													jab_float x2, jab_float y2,
+													jab_float x3, jab_float y3,
+													jab_float x0p, jab_float y0p,
+													jab_float x1p, jab_float y1p,
+													jab_float x2p, jab_float y2p,
+													jab_float x3p, jab_float y3p);
+extern jab_perspective_transform symbolTransform(jab_point p0, jab_point p1,
+												 jab_point p2, jab_point p3,
+												 jab_vector2d side_size);
 extern jab_perspective_transform* getPerspectiveTransform(jab_point p0, jab_point p1,
 														  jab_point p2, jab_point p3,
 														  jab_vector2d side_size);
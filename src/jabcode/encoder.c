@@ -15,11 +15,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 #include "jabcode.h"
 #include "encoder.h"
 #include "ldpc.h"
 #include "detector.h"
 #include "decoder.h"
+#include "datamap.h"
+#include "bitstream.h"
 
 /**
  * @brief Generate color palettes with more than 8 colors
@@ -244,6 +247,13 @@ void destroyEncode(jab_encode* enc)
     free(enc->symbol_ecc_levels);
     free(enc->symbol_positions);
     free(enc->bitmap);
+    free(enc->code_matrix);
+    if(enc->code_para)
+    {
+        free(enc->code_para->row_height);
+        free(enc->code_para->col_width);
+        free(enc->code_para);
+    }
     if(enc->symbols)
     {
         for(jab_int32 i=0; i<enc->symbol_number; i++)
@@ -252,12 +262,53 @@ void destroyEncode(jab_encode* enc)
             free(enc->symbols[i].data_map);
             free(enc->symbols[i].metadata);
             free(enc->symbols[i].matrix);
+            if(enc->symbols[i].layout)
+                releaseSymbolLayout(enc->symbols[i].layout);
         }
         free(enc->symbols);
     }
     free(enc);
 }
 
+/**
+ * @brief Free the message dependent data of the symbols, so that the encode object can be reused
+ * @param enc the encode object
+ */
+void resetSymbolPayloads(jab_encode* enc)
+{
+    for(jab_int32 i=0; i<enc->symbol_number; i++)
+    {
+        free(enc->symbols[i].data);
+        free(enc->symbols[i].metadata);
+        enc->symbols[i].data = NULL;
+        enc->symbols[i].metadata = NULL;
+        //the matrices of a compiled encode object keep the modules not depending on the message
+        if(enc->compiled)
+            continue;
+        free(enc->symbols[i].data_map);
+        free(enc->symbols[i].matrix);
+        if(enc->symbols[i].layout)
+            releaseSymbolLayout(enc->symbols[i].layout);
+        enc->symbols[i].data_map = NULL;
+        enc->symbols[i].matrix = NULL;
+        enc->symbols[i].layout = NULL;
+    }
+}
+
+/**
+ * @brief Free the code parameters unless they are kept by a compiled encode object
+ * @param enc the encode object
+ * @param cp the code parameters
+ */
+void releaseCodePara(jab_encode* enc, jab_code* cp)
+{
+    if(cp == enc->code_para)
+        return;
+    free(cp->row_height);
+    free(cp->col_width);
+    free(cp);
+}
+
 /**
  * @brief Analyze the input data and determine the optimal encoding modes for each character
  * @param input the input character data
@@ -697,17 +748,15 @@ void getOptimalECC(jab_int32 capacity, jab_int32 net_data_length, jab_int32* wcw
  * @param data the character input data
  * @param encoded_length the optimal encoding length
  * @param encode_seq the optimal encoding sequence
- * @return the encoded data | NULL if failed
+ * @return the encoded bit sequence | NULL if failed
  */
-jab_data* encodeData(jab_data* data, jab_int32 encoded_length,jab_int32* encode_seq)
+jab_bitstream* encodeData(jab_data* data, jab_int32 encoded_length,jab_int32* encode_seq)
 {
-    jab_data* encoded_data = (jab_data *)malloc(sizeof(jab_data) + encoded_length*sizeof(jab_char));
+    jab_bitstream* encoded_data = createBitstream(encoded_length);
     if(encoded_data == NULL)
     {
-        reportError("Memory allocation for encoded data failed");
         return NULL;
     }
-    encoded_data->length = encoded_length;
 
     jab_int32 counter=0;
     jab_boolean shift_back=0;
@@ -734,7 +783,7 @@ jab_data* encodeData(jab_data* data, jab_int32 encoded_length,jab_int32* encode_
                 if(encode_seq[counter+1] == 6 || encode_seq[counter+1] == 13)
                     length-=4;
                 if(length < ENC_MAX)
-                    convert_dec_to_bin(mode_switch[encode_seq[counter]][encode_seq[counter+1]],encoded_data->data,position,length);
+                    writeBits(encoded_data,position,mode_switch[encode_seq[counter]][encode_seq[counter+1]],length);
                 else
                 {
                     reportError("Encoding data failed");
@@ -754,7 +803,7 @@ jab_data* encodeData(jab_data* data, jab_int32 encoded_length,jab_int32* encode_
                 if(jab_enconing_table[tmp][encode_seq[counter+1]%7]>-1 && character_size[encode_seq[counter+1]%7] < ENC_MAX)
                 {
                     //encode character
-                    convert_dec_to_bin(jab_enconing_table[tmp][encode_seq[counter+1]%7],encoded_data->data,position,character_size[encode_seq[counter+1]%7]);
+                    writeBits(encoded_data,position,jab_enconing_table[tmp][encode_seq[counter+1]%7],character_size[encode_seq[counter+1]%7]);
                     position+=character_size[encode_seq[counter+1]%7];
                     counter++;
                 }
@@ -775,7 +824,7 @@ jab_data* encodeData(jab_data* data, jab_int32 encoded_length,jab_int32* encode_
                         return NULL;
                     }
                     if (character_size[encode_seq[counter+1]%7] < ENC_MAX)
-                    convert_dec_to_bin(decimal_value,encoded_data->data,position,character_size[encode_seq[counter+1]%7]);
+                    writeBits(encoded_data,position,decimal_value,character_size[encode_seq[counter+1]%7]);
                     position+=character_size[encode_seq[counter+1]%7];
                     counter++;
                     end_of_loop--;
@@ -802,17 +851,17 @@ jab_data* encodeData(jab_data* data, jab_int32 encoded_length,jab_int32* encode_
                         else
                             break;
                     }
-                    convert_dec_to_bin(byte_counter > 15 ? 0 : byte_counter,encoded_data->data,position,4);
+                    writeBits(encoded_data,position,byte_counter > 15 ? 0 : byte_counter,4);
                     position+=4;
                     if(byte_counter > 15)
                     {
 						if(byte_counter <= 8207)//8207=2^13+15; if number of bytes exceeds 8207, encoder shall shift to byte mode again from upper case mode && byte_counter < 8207
 						{
-							convert_dec_to_bin(byte_counter-15-1,encoded_data->data,position,13);
+							writeBits(encoded_data,position,byte_counter-15-1,13);
 						}
 						else
 						{
-							convert_dec_to_bin(8191,encoded_data->data,position,13);
+							writeBits(encoded_data,position,8191,13);
 						}
                         position+=13;
                     }
@@ -822,37 +871,37 @@ jab_data* encodeData(jab_data* data, jab_int32 encoded_length,jab_int32* encode_
 				{
 					if(encode_seq[counter-(byte_offset-byte_counter)]==0 || encode_seq[counter-(byte_offset-byte_counter)]==7 || encode_seq[counter-(byte_offset-byte_counter)]==1|| encode_seq[counter-(byte_offset-byte_counter)]==8)
 					{
-						convert_dec_to_bin(124,encoded_data->data,position,7);// shift from upper case to byte
+						writeBits(encoded_data,position,124,7);// shift from upper case to byte
 						position+=7;
 					}
 					if(encode_seq[counter-(byte_offset-byte_counter)]==2 || encode_seq[counter-(byte_offset-byte_counter)]==9)
 					{
-						convert_dec_to_bin(60,encoded_data->data,position,5);// shift from numeric to byte
+						writeBits(encoded_data,position,60,5);// shift from numeric to byte
 						position+=5;
 					}
 					if(encode_seq[counter-(byte_offset-byte_counter)]==5 || encode_seq[counter-(byte_offset-byte_counter)]==12)
 					{
-						convert_dec_to_bin(252,encoded_data->data,position,8);// shift from alphanumeric to byte
+						writeBits(encoded_data,position,252,8);// shift from alphanumeric to byte
 						position+=8;
 					}
-					convert_dec_to_bin(byte_counter > 15 ? 0 : byte_counter,encoded_data->data,position,4); //write the first 4 bits
+					writeBits(encoded_data,position,byte_counter > 15 ? 0 : byte_counter,4); //write the first 4 bits
 					position+=4;
 					if(byte_counter > 15) //if more than 15 bytes -> use the next 13 bits to wirte the length
 					{
 						if(byte_counter <= 8207)//8207=2^13+15; if number of bytes exceeds 8207, encoder shall shift to byte mode again from upper case mode && byte_counter < 8207
 						{
-							convert_dec_to_bin(byte_counter-15-1,encoded_data->data,position,13);
+							writeBits(encoded_data,position,byte_counter-15-1,13);
 						}
 						else //number exceeds 2^13 + 15
 						{
-							convert_dec_to_bin(8191,encoded_data->data,position,13);
+							writeBits(encoded_data,position,8191,13);
 						}
 						position+=13;
 					}
 					factor++;
 				}
                 if (character_size[encode_seq[counter+1]%7] < ENC_MAX)
-                    convert_dec_to_bin(tmp,encoded_data->data,position,character_size[encode_seq[counter+1]%7]);
+                    writeBits(encoded_data,position,tmp,character_size[encode_seq[counter+1]%7]);
                 else
                 {
                     reportError("Encoding data failed");
@@ -907,38 +956,36 @@ jab_boolean encodeMasterMetadata(jab_encode* enc)
 
 	//write each part of master metadata
 	//Part I
-	jab_data* partI = (jab_data *)malloc(sizeof(jab_data) + partI_length*sizeof(jab_char));
+	jab_bitstream* partI = createBitstream(partI_length);
 	if(partI == NULL)
 	{
 		reportError("Memory allocation for metadata Part I in master symbol failed");
 		return JAB_FAILURE;
 	}
-	partI->length = partI_length;
-	convert_dec_to_bin(Nc, partI->data, 0, partI->length);
+	writeBits(partI, 0, Nc, partI->length);
 	//Part II
-	jab_data* partII = (jab_data *)malloc(sizeof(jab_data) + partII_length*sizeof(jab_char));
+	jab_bitstream* partII = createBitstream(partII_length);
 	if(partII == NULL)
 	{
 		reportError("Memory allocation for metadata Part II in master symbol failed");
 		return JAB_FAILURE;
 	}
-	partII->length = partII_length;
-	convert_dec_to_bin(V,   partII->data, 0, V_length);
-	convert_dec_to_bin(E1,  partII->data, V_length, 3);
-	convert_dec_to_bin(E2,  partII->data, V_length+3, 3);
-	convert_dec_to_bin(MSK, partII->data, V_length+E_length, MSK_length);
+	writeBits(partII, 0, V,   V_length);
+	writeBits(partII, V_length, E1,  3);
+	writeBits(partII, V_length+3, E2,  3);
+	writeBits(partII, V_length+E_length, MSK, MSK_length);
 
 	//encode each part of master metadata
 	jab_int32 wcwr[2] = {2, -1};
 	//Part I
-	jab_data* encoded_partI   = encodeLDPC(partI, wcwr);
+	jab_bitstream* encoded_partI   = encodeLDPC(partI, wcwr);
 	if(encoded_partI == NULL)
 	{
 		reportError("LDPC encoding master metadata Part I failed");
 		return JAB_FAILURE;
 	}
 	//Part II
-	jab_data* encoded_partII  = encodeLDPC(partII, wcwr);
+	jab_bitstream* encoded_partII  = encodeLDPC(partII, wcwr);
 	if(encoded_partII == NULL)
 	{
 		reportError("LDPC encoding master metadata Part II failed");
@@ -953,9 +1000,9 @@ jab_boolean encodeMasterMetadata(jab_encode* enc)
 		return JAB_FAILURE;
 	}
 	enc->symbols[0].metadata->length = encoded_metadata_length;
-	//copy encoded parts into metadata
-	memcpy(enc->symbols[0].metadata->data, encoded_partI->data, encoded_partI->length);
-	memcpy(enc->symbols[0].metadata->data+encoded_partI->length, encoded_partII->data, encoded_partII->length);
+	//copy encoded parts into metadata, which is placed module by module
+	unpackBits(encoded_partI, 0, enc->symbols[0].metadata->data, encoded_partI->length);
+	unpackBits(encoded_partII, 0, enc->symbols[0].metadata->data+encoded_partI->length, encoded_partII->length);
 
 	free(partI);
 	free(partII);
@@ -973,13 +1020,12 @@ jab_boolean encodeMasterMetadata(jab_encode* enc)
 jab_boolean updateMasterMetadataPartII(jab_encode* enc, jab_int32 mask_ref)
 {
 	jab_int32 partII_length	= MASTER_METADATA_PART2_LENGTH/2;	//partII net length
-	jab_data* partII = (jab_data *)malloc(sizeof(jab_data) + partII_length*sizeof(jab_char));
+	jab_bitstream* partII = createBitstream(partII_length);
 	if(partII == NULL)
 	{
 		reportError("Memory allocation for metadata Part II in master symbol failed");
 		return JAB_FAILURE;
 	}
-	partII->length = partII_length;
 
 	//set V and E
 	jab_int32 V_length = 10;
@@ -988,23 +1034,23 @@ jab_boolean updateMasterMetadataPartII(jab_encode* enc, jab_int32 mask_ref)
 	jab_int32 V = ((enc->symbol_versions[0].x -1) << 5) + (enc->symbol_versions[0].y - 1);
 	jab_int32 E1 = enc->symbols[0].wcwr[0] - 3;
 	jab_int32 E2 = enc->symbols[0].wcwr[1] - 4;
-	convert_dec_to_bin(V,   partII->data, 0, V_length);
-	convert_dec_to_bin(E1,  partII->data, V_length, 3);
-	convert_dec_to_bin(E2,  partII->data, V_length+3, 3);
+	writeBits(partII, 0, V,   V_length);
+	writeBits(partII, V_length, E1,  3);
+	writeBits(partII, V_length+3, E2,  3);
 
 	//update masking reference in PartII
-	convert_dec_to_bin(mask_ref, partII->data, V_length+E_length, MSK_length);
+	writeBits(partII, V_length+E_length, mask_ref, MSK_length);
 
 	//encode new PartII
 	jab_int32 wcwr[2] = {2, -1};
-	jab_data* encoded_partII = encodeLDPC(partII, wcwr);
+	jab_bitstream* encoded_partII = encodeLDPC(partII, wcwr);
 	if(encoded_partII == NULL)
 	{
 		reportError("LDPC encoding master metadata Part II failed");
 		return JAB_FAILURE;
 	}
 	//update metadata
-	memcpy(enc->symbols[0].metadata->data+MASTER_METADATA_PART1_LENGTH, encoded_partII->data, encoded_partII->length);
+	unpackBits(encoded_partII, 0, enc->symbols[0].metadata->data+MASTER_METADATA_PART1_LENGTH, encoded_partII->length);
 
 	free(partII);
 	free(encoded_partII);
@@ -1012,49 +1058,45 @@ jab_boolean updateMasterMetadataPartII(jab_encode* enc, jab_int32 mask_ref)
 }
 
 /**
- * @brief Update master symbol metadata PartII if the default masking reference is changed
+ * @brief Place master symbol metadata PartII, which follows PartI and the color palettes
  * @param enc the encode parameter
+ * @return the number of metadata and color palette modules in master symbol
 */
-void placeMasterMetadataPartII(jab_encode* enc)
+jab_int32 placeMasterMetadataPartII(jab_encode* enc)
 {
-    //rewrite metadata in master with mask information
     jab_int32 nb_of_bits_per_mod = log(enc->color_number)/log(2);
     jab_int32 x = MASTER_METADATA_X;
     jab_int32 y = MASTER_METADATA_Y;
     jab_int32 module_count = 0;
     //skip PartI and color palette
     jab_int32 color_palette_size = MIN(enc->color_number-2, 64-2);
-    jab_int32 module_offset = MASTER_METADATA_PART1_MODULE_NUMBER + color_palette_size*COLOR_PALETTE_NUMBER;
+    jab_int32 module_offset = color_palette_size*COLOR_PALETTE_NUMBER;
+    if(isDefaultMode(enc))
+		return module_offset;
+    module_offset += MASTER_METADATA_PART1_MODULE_NUMBER;
     for(jab_int32 i=0; i<module_offset; i++)
 	{
 		module_count++;
         getNextMetadataModuleInMaster(enc->symbols[0].side_size.y, enc->symbols[0].side_size.x, module_count, &x, &y);
 	}
-	//update PartII
+	//place PartII
 	jab_int32 partII_bit_start = MASTER_METADATA_PART1_LENGTH;
-	jab_int32 partII_bit_end = MASTER_METADATA_PART1_LENGTH + MASTER_METADATA_PART2_LENGTH;
+	jab_int32 partII_bit_end = enc->symbols[0].metadata->length;
 	jab_int32 metadata_index = partII_bit_start;
-	while(metadata_index <= partII_bit_end)
+	while(metadata_index < partII_bit_end)
 	{
-    	jab_byte color_index = enc->symbols[0].matrix[y*enc->symbols[0].side_size.x + x];
-		for(jab_int32 j=0; j<nb_of_bits_per_mod; j++)
+    	jab_byte color_index = 0;
+		for(jab_int32 j=0; j<nb_of_bits_per_mod && metadata_index < partII_bit_end; j++)
 		{
-			if(metadata_index <= partII_bit_end)
-			{
-				jab_byte bit = enc->symbols[0].metadata->data[metadata_index];
-				if(bit == 0)
-					color_index &= ~(1UL << (nb_of_bits_per_mod-1-j));
-				else
-					color_index |= 1UL << (nb_of_bits_per_mod-1-j);
-				metadata_index++;
-			}
-			else
-				break;
+			color_index += enc->symbols[0].metadata->data[metadata_index] << (nb_of_bits_per_mod-1-j);
+			metadata_index++;
 		}
-        enc->symbols[0].matrix[y*enc->symbols[0].side_size.x + x] = color_index;
+        enc->symbols[0].matrix  [y*enc->symbols[0].side_size.x + x] = color_index;
+        enc->symbols[0].data_map[y*enc->symbols[0].side_size.x + x] = 0;
         module_count++;
         getNextMetadataModuleInMaster(enc->symbols[0].side_size.y, enc->symbols[0].side_size.x, module_count, &x, &y);
     }
+    return module_count;
 }
 
 /**
@@ -1111,13 +1153,13 @@ void getColorPaletteIndex(jab_byte* index, jab_int32 index_size, jab_int32 color
 }
 
 /**
- * @brief Create symbol matrix
+ * @brief Create the symbol matrix with the modules not depending on the message, i.e. the finder and alignment patterns,
+ * the color palettes and the master metadata Part I
  * @param enc the encode parameter
  * @param index the symbol index
- * @param ecc_encoded_data encoded data
  * @return JAB_SUCCESS | JAB_FAILURE
 */
-jab_boolean createMatrix(jab_encode* enc, jab_int32 index, jab_data* ecc_encoded_data)
+jab_boolean createSymbolTemplate(jab_encode* enc, jab_int32 index)
 {
     //Allocate matrix
     enc->symbols[index].matrix = (jab_byte *)calloc(enc->symbols[index].side_size.x * enc->symbols[index].side_size.y, sizeof(jab_byte));
@@ -1293,7 +1335,6 @@ jab_boolean createMatrix(jab_encode* enc, jab_int32 index, jab_data* ecc_encoded
     }
 
     //Metadata and color palette placement
-    jab_int32 nb_of_bits_per_mod = log(enc->color_number) / log(2);
     jab_int32 color_index;
     jab_int32 module_count = 0;
     jab_int32 x;
@@ -1354,28 +1395,6 @@ jab_boolean createMatrix(jab_encode* enc, jab_int32 index, jab_data* ecc_encoded
 			module_count++;
 			getNextMetadataModuleInMaster(enc->symbols[index].side_size.y, enc->symbols[index].side_size.x, module_count, &x, &y);
 		}
-		//metadata PartII
-		if(!isDefaultMode(enc))
-		{
-			while(metadata_index < enc->symbols[index].metadata->length)
-			{
-				color_index = 0;
-				for(jab_int32 j=0; j<nb_of_bits_per_mod; j++)
-				{
-					if(metadata_index < enc->symbols[index].metadata->length)
-					{
-						color_index += ((jab_int32)enc->symbols[index].metadata->data[metadata_index]) << (nb_of_bits_per_mod-1-j);
-						metadata_index++;
-					}
-					else
-						break;
-				}
-				enc->symbols[index].matrix  [y*enc->symbols[index].side_size.x + x] = color_index;
-				enc->symbols[index].data_map[y*enc->symbols[index].side_size.x + x] = 0;
-				module_count++;
-				getNextMetadataModuleInMaster(enc->symbols[index].side_size.y, enc->symbols[index].side_size.x, module_count, &x, &y);
-			}
-		}
     }
     else//place color palette in slave symbol
     {
@@ -1398,55 +1417,67 @@ jab_boolean createMatrix(jab_encode* enc, jab_int32 index, jab_data* ecc_encoded
 			enc->symbols[index].data_map[(height-1-slave_palette_position[i-2].x)*width + slave_palette_position[i-2].y] = 0;
         }
     }
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Create symbol matrix
+ * @param enc the encode parameter
+ * @param index the symbol index
+ * @param ecc_encoded_data encoded data
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean createMatrix(jab_encode* enc, jab_int32 index, jab_bitstream* ecc_encoded_data)
+{
+    //the matrix of a compiled encode object already holds the modules not depending on the message
+    if(enc->symbols[index].matrix == NULL)
+    {
+        if(!createSymbolTemplate(enc, index))
+            return JAB_FAILURE;
+    }
+    //metadata Part II
+    jab_int32 metadata_module_number = (index == 0) ? placeMasterMetadataPartII(enc) : 0;
+    //get the placement order of the data modules
+    const jab_symbol_layout* layout = enc->symbols[index].layout;
+    if(layout == NULL)
+    {
+        layout = getSymbolLayout(enc->symbols[index].side_size, index == 0 ? 0 : 1, enc->color_number, metadata_module_number);
+        if(layout == NULL)
+        {
+            return JAB_FAILURE;
+        }
+        enc->symbols[index].layout = layout;
+    }
 #if TEST_MODE
 	FILE* fp = fopen("jab_enc_module_data.bin", "wb");
 #endif // TEST_MODE
     //Data placement
+    jab_int32 nb_of_bits_per_mod = log(enc->color_number) / log(2);
+    jab_int32 color_index;
     jab_int32 written_mess_part=0;
     jab_int32 padding=0;
-    for(jab_int32 start_i=0;start_i<enc->symbols[index].side_size.x;start_i++)
+    for(jab_int32 k=0; k<layout->data_module_number; k++)
     {
-        for(jab_int32 i=start_i;i<enc->symbols[index].side_size.x*enc->symbols[index].side_size.y;i=i+enc->symbols[index].side_size.x)
+        jab_int32 i = layout->modules[k].y * enc->symbols[index].side_size.x + layout->modules[k].x;
+        color_index=0;
+        for(jab_int32 j=0;j<nb_of_bits_per_mod;j++)
         {
-            if (enc->symbols[index].data_map[i]!=0 && written_mess_part<ecc_encoded_data->length)
+            if(written_mess_part<ecc_encoded_data->length)
+                color_index+=(jab_int32)GET_BIT(ecc_encoded_data, written_mess_part) << (nb_of_bits_per_mod-1-j);//*pow(2,nb_of_bits_per_mod-1-j);
+            else //write padding bits
             {
-                color_index=0;
-                for(jab_int32 j=0;j<nb_of_bits_per_mod;j++)
-                {
-                    if(written_mess_part<ecc_encoded_data->length)
-                        color_index+=((jab_int32)ecc_encoded_data->data[written_mess_part]) << (nb_of_bits_per_mod-1-j);//*pow(2,nb_of_bits_per_mod-1-j);
-                    else
-                    {
-                        color_index+=padding << (nb_of_bits_per_mod-1-j);//*pow(2,nb_of_bits_per_mod-1-j);
-                        if (padding==0)
-                            padding=1;
-                        else
-                            padding=0;
-                    }
-                    written_mess_part++;
-                }
-                enc->symbols[index].matrix[i]=(jab_char)color_index;//i % enc->color_number;
-#if TEST_MODE
-				fwrite(&enc->symbols[index].matrix[i], 1, 1, fp);
-#endif // TEST_MODE
+                color_index+=padding << (nb_of_bits_per_mod-1-j);//*pow(2,nb_of_bits_per_mod-1-j);
+                if (padding==0)
+                    padding=1;
+                else
+                    padding=0;
             }
-            else if(enc->symbols[index].data_map[i]!=0) //write padding bits
-            {
-                color_index=0;
-                for(jab_int32 j=0;j<nb_of_bits_per_mod;j++)
-                {
-                    color_index+=padding << (nb_of_bits_per_mod-1-j);//*pow(2,nb_of_bits_per_mod-1-j);
-                    if (padding==0)
-                        padding=1;
-                    else
-                        padding=0;
-                }
-                enc->symbols[index].matrix[i]=(jab_char)color_index;//i % enc->color_number;
+            written_mess_part++;
+        }
+        enc->symbols[index].matrix[i]=(jab_char)color_index;//i % enc->color_number;
 #if TEST_MODE
-				fwrite(&enc->symbols[index].matrix[i], 1, 1, fp);
+        fwrite(&enc->symbols[index].matrix[i], 1, 1, fp);
 #endif // TEST_MODE
-            }
-        }
     }
 #if TEST_MODE
 	fclose(fp);
@@ -1655,6 +1686,51 @@ jab_code* getCodePara(jab_encode* enc)
     return cp;
 }
 
+/**
+ * @brief Get the RGBA pixel of each palette color
+ * @param palette the color palette in format RGB
+ * @param color_number the number of colors
+ * @param color_pixel the RGBA pixel of each color
+*/
+void getColorPixels(const jab_byte* palette, jab_int32 color_number, jab_uint32* color_pixel)
+{
+    for(jab_int32 c=0; c<color_number; c++)
+    {
+        jab_byte rgba[4] = {palette[c * 3], palette[c * 3 + 1], palette[c * 3 + 2], 255};
+        memcpy(&color_pixel[c], rgba, sizeof(jab_uint32));
+    }
+}
+
+/**
+ * @brief Rasterize a row of modules into the pixel rows it covers
+ * @param modules the color index of each module
+ * @param module_count the number of modules
+ * @param color_pixel the RGBA pixel of each color
+ * @param dimension the module size in pixel
+ * @param scanline the first pixel of the module row in the bitmap
+ * @param bytes_per_row the number of bytes per bitmap row
+*/
+void rasterizeModuleRow(const jab_byte* modules, jab_int32 module_count, const jab_uint32* color_pixel, jab_int32 dimension, jab_byte* scanline, jab_int32 bytes_per_row)
+{
+    //rasterize the first pixel row of the module row
+    jab_byte* dst = scanline;
+    for(jab_int32 x=0; x<module_count; x++)
+    {
+        jab_uint32 pixel = color_pixel[modules[x]];
+        for(jab_int32 j=0; j<dimension; j++)
+        {
+            memcpy(dst, &pixel, sizeof(jab_uint32));
+            dst += sizeof(jab_uint32);
+        }
+    }
+    //replicate it to the remaining pixel rows of the module row
+    jab_int32 scanline_bytes = (jab_int32)(dst - scanline);
+    for(jab_int32 i=1; i<dimension; i++)
+    {
+        memcpy(scanline + i * bytes_per_row, scanline, scanline_bytes);
+    }
+}
+
 /**
  * @brief Create bitmap for the code
  * @param enc the encode parameters
@@ -1663,16 +1739,24 @@ jab_code* getCodePara(jab_encode* enc)
 */
 jab_boolean createBitmap(jab_encode* enc, jab_code* cp)
 {
-    //create bitmap
+    //create bitmap, the bitmap of the previous message is reused if it has the same size
     jab_int32 width = cp->dimension * cp->code_size.x;
     jab_int32 height= cp->dimension * cp->code_size.y;
     jab_int32 bytes_per_pixel = BITMAP_BITS_PER_PIXEL / 8;
     jab_int32 bytes_per_row = width * bytes_per_pixel;
-    enc->bitmap = (jab_bitmap *)calloc(1, sizeof(jab_bitmap) + width*height*bytes_per_pixel*sizeof(jab_byte));
-    if(enc->bitmap == NULL)
+    if(enc->bitmap && enc->bitmap->width == width && enc->bitmap->height == height)
     {
-        reportError("Memory allocation for bitmap failed");
-        return JAB_FAILURE;
+        memset(enc->bitmap->pixel, 0, width*height*bytes_per_pixel*sizeof(jab_byte));
+    }
+    else
+    {
+        free(enc->bitmap);
+        enc->bitmap = (jab_bitmap *)calloc(1, sizeof(jab_bitmap) + width*height*bytes_per_pixel*sizeof(jab_byte));
+        if(enc->bitmap == NULL)
+        {
+            reportError("Memory allocation for bitmap failed");
+            return JAB_FAILURE;
+        }
     }
     enc->bitmap->width = width;
     enc->bitmap->height= height;
@@ -1680,43 +1764,119 @@ jab_boolean createBitmap(jab_encode* enc, jab_code* cp)
     enc->bitmap->bits_per_channel = BITMAP_BITS_PER_CHANNEL;
     enc->bitmap->channel_count = BITMAP_CHANNEL_COUNT;
 
+    jab_uint32 color_pixel[MAX_COLOR_NUMBER];
+    getColorPixels(enc->palette, enc->color_number, color_pixel);
+
     //place symbols in bitmap
     for(jab_int32 k=0; k<enc->symbol_number; k++)
     {
         //calculate the starting coordinates of the symbol matrix
-        jab_int32 startx = 0, starty = 0;
-        jab_int32 col = jab_symbol_pos[enc->symbol_positions[k]].x - cp->min_x;
-        jab_int32 row = jab_symbol_pos[enc->symbol_positions[k]].y - cp->min_y;
-        for(jab_int32 c=0; c<col; c++)
-            startx += cp->col_width[c];
-        for(jab_int32 r=0; r<row; r++)
-            starty += cp->row_height[r];
-
-        //place symbol in the code
+        jab_int32 startx, starty;
+        getSymbolOrigin(enc, k, cp, &startx, &starty);
+
+        //place symbol in the code, one module row at a time
         jab_int32 symbol_width = enc->symbols[k].side_size.x;
         jab_int32 symbol_height= enc->symbols[k].side_size.y;
-        for(jab_int32 x=startx; x<(startx+symbol_width); x++)
+        for(jab_int32 y=0; y<symbol_height; y++)
         {
-            for(jab_int32 y=starty; y<(starty+symbol_height); y++)
-            {
-                //place one module in the bitmap
-                jab_int32 p_index = enc->symbols[k].matrix[(y-starty)*symbol_width + (x-startx)];
-                 for(jab_int32 i=y*cp->dimension; i<(y*cp->dimension+cp->dimension); i++)
-                {
-                    for(jab_int32 j=x*cp->dimension; j<(x*cp->dimension+cp->dimension); j++)
-                    {
-                        enc->bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel]     = enc->palette[p_index * 3];	//R
-                        enc->bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel + 1] = enc->palette[p_index * 3 + 1];//B
-                        enc->bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel + 2] = enc->palette[p_index * 3 + 2];//G
-                        enc->bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel + 3] = 255; 							//A
-                    }
-                }
-            }
+            jab_byte* scanline = enc->bitmap->pixel + (starty + y) * cp->dimension * bytes_per_row + startx * cp->dimension * bytes_per_pixel;
+            rasterizeModuleRow(enc->symbols[k].matrix + y * symbol_width, symbol_width, color_pixel, cp->dimension, scanline, bytes_per_row);
+        }
+    }
+    return JAB_SUCCESS;
+}
+
+/**
+ * @brief Create the code matrix holding the color index of each module
+ * @param enc the encode parameters
+ * @param cp the code parameters
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean createCodeMatrix(jab_encode* enc, jab_code* cp)
+{
+    //create code matrix, the matrix of the previous message is reused if it has the same size
+    jab_int32 width = cp->code_size.x;
+    jab_int32 height= cp->code_size.y;
+    if(enc->code_matrix && enc->code_matrix->width == width && enc->code_matrix->height == height)
+    {
+        memset(enc->code_matrix->module, 0, width*height*sizeof(jab_byte));
+    }
+    else
+    {
+        free(enc->code_matrix);
+        enc->code_matrix = (jab_code_matrix *)calloc(1, sizeof(jab_code_matrix) + width*height*sizeof(jab_byte));
+        if(enc->code_matrix == NULL)
+        {
+            reportError("Memory allocation for code matrix failed");
+            return JAB_FAILURE;
+        }
+    }
+    jab_code_matrix* matrix = enc->code_matrix;
+    matrix->width = width;
+    matrix->height= height;
+    matrix->module_size = cp->dimension;
+    matrix->color_number = enc->color_number;
+    memcpy(matrix->palette, enc->palette, enc->color_number * 3 * sizeof(jab_byte));
+    matrix->symbol_number = enc->symbol_number;
+
+    //place symbols in the matrix
+    for(jab_int32 k=0; k<enc->symbol_number; k++)
+    {
+        jab_int32 startx, starty;
+        getSymbolOrigin(enc, k, cp, &startx, &starty);
+        matrix->symbol_origins[k].x = startx;
+        matrix->symbol_origins[k].y = starty;
+        matrix->symbol_sizes[k] = enc->symbols[k].side_size;
+        for(jab_int32 y=0; y<enc->symbols[k].side_size.y; y++)
+        {
+            memcpy(matrix->module + (starty + y) * width + startx,
+                   enc->symbols[k].matrix + y * enc->symbols[k].side_size.x,
+                   enc->symbols[k].side_size.x * sizeof(jab_byte));
         }
     }
     return JAB_SUCCESS;
 }
 
+/**
+ * @brief Render a code matrix into a bitmap
+ * @param matrix the code matrix
+ * @return the code bitmap | NULL if failed
+*/
+jab_bitmap* renderJABCodeMatrix(const jab_code_matrix* matrix)
+{
+    jab_int32 width = matrix->module_size * matrix->width;
+    jab_int32 height= matrix->module_size * matrix->height;
+    jab_int32 bytes_per_pixel = BITMAP_BITS_PER_PIXEL / 8;
+    jab_int32 bytes_per_row = width * bytes_per_pixel;
+    jab_bitmap* bitmap = (jab_bitmap *)calloc(1, sizeof(jab_bitmap) + width*height*bytes_per_pixel*sizeof(jab_byte));
+    if(bitmap == NULL)
+    {
+        reportError("Memory allocation for bitmap failed");
+        return NULL;
+    }
+    bitmap->width = width;
+    bitmap->height= height;
+    bitmap->bits_per_pixel = BITMAP_BITS_PER_PIXEL;
+    bitmap->bits_per_channel = BITMAP_BITS_PER_CHANNEL;
+    bitmap->channel_count = BITMAP_CHANNEL_COUNT;
+
+    jab_uint32 color_pixel[MAX_COLOR_NUMBER];
+    getColorPixels(matrix->palette, matrix->color_number, color_pixel);
+
+    //only the symbols are rendered, the pixels between them stay transparent
+    for(jab_int32 k=0; k<matrix->symbol_number; k++)
+    {
+        jab_vector2d origin = matrix->symbol_origins[k];
+        for(jab_int32 y=0; y<matrix->symbol_sizes[k].y; y++)
+        {
+            jab_byte* scanline = bitmap->pixel + (origin.y + y) * matrix->module_size * bytes_per_row + origin.x * matrix->module_size * bytes_per_pixel;
+            rasterizeModuleRow(matrix->module + (origin.y + y) * matrix->width + origin.x, matrix->symbol_sizes[k].x,
+                               color_pixel, matrix->module_size, scanline, bytes_per_row);
+        }
+    }
+    return bitmap;
+}
+
 
 /**
  * @brief Checks if the docked symbol sizes are valid
@@ -1759,7 +1919,7 @@ jab_boolean checkDockedSymbolSize(jab_encode* enc)
  * @param encoded_data the encoded message
  * @return JAB_SUCCESS | JAB_FAILURE
  */
-jab_boolean setMasterSymbolVersion(jab_encode *enc, jab_data* encoded_data)
+jab_boolean setMasterSymbolVersion(jab_encode *enc, jab_bitstream* encoded_data)
 {
     //calculate required number of data modules depending on data_length
     jab_int32 net_data_length = encoded_data->length;
@@ -1854,7 +2014,7 @@ void updateSlaveMetadataE(jab_encode* enc, jab_int32 host_index, jab_int32 slave
 
 	jab_int32 offset = host->data->length - 1;
 	//find the start flag of metadata
-	while(host->data->data[offset] == 0)
+	while(GET_BIT(host->data, offset) == 0)
 	{
 		offset--;
 	}
@@ -1888,7 +2048,8 @@ void updateSlaveMetadataE(jab_encode* enc, jab_int32 host_index, jab_int32 slave
 	convert_dec_to_bin(E2, E, 3, 3);
 	for(jab_int32 i=0; i<6; i++)
 	{
-		host->data->data[offset--] = E[i];
+		PUT_BIT(host->data, offset, E[i]);
+		offset--;
 	}
 }
 
@@ -1898,7 +2059,7 @@ void updateSlaveMetadataE(jab_encode* enc, jab_int32 host_index, jab_int32 slave
  * @param encoded_data the encoded message
  * @return JAB_SUCCESS | JAB_FAILURE
 */
-jab_boolean fitDataIntoSymbols(jab_encode* enc, jab_data* encoded_data)
+jab_boolean fitDataIntoSymbols(jab_encode* enc, jab_bitstream* encoded_data)
 {
 	//calculate the net capacity of each symbol and the total net capacity
 	jab_int32 capacity[enc->symbol_number];
@@ -1991,29 +2152,31 @@ jab_boolean fitDataIntoSymbols(jab_encode* enc, jab_data* encoded_data)
 		}
 
 		//start to set full payload
-        enc->symbols[i].data = (jab_data *)calloc(1, sizeof(jab_data) + pn_length*sizeof(jab_char));
+        enc->symbols[i].data = createBitstream(pn_length);
         if(enc->symbols[i].data == NULL)
 		{
 			reportError("Memory allocation for data payload in symbol failed");
 			return JAB_FAILURE;
 		}
-		enc->symbols[i].data->length = pn_length;
 		//set data
-		memcpy(enc->symbols[i].data->data, &encoded_data->data[assigned_data_length], s_data_length);
+		copyBits(enc->symbols[i].data, 0, encoded_data, assigned_data_length, s_data_length);
 		assigned_data_length += s_data_length;
 		//set flag bit
 		jab_int32 set_pos = s_payload_length - 1;
-		enc->symbols[i].data->data[set_pos--] = 1;
+		SET_BIT(enc->symbols[i].data, set_pos);
+		set_pos--;
 		//set host metadata S
 		for(jab_int32 k=0; k<4; k++)
 		{
 			if(enc->symbols[i].slaves[k] > 0)
 			{
-				enc->symbols[i].data->data[set_pos--] = 1;
+				SET_BIT(enc->symbols[i].data, set_pos);
+				set_pos--;
 			}
 			else if(enc->symbols[i].slaves[k] == 0)
 			{
-				enc->symbols[i].data->data[set_pos--] = 0;
+				CLEAR_BIT(enc->symbols[i].data, set_pos);
+				set_pos--;
 			}
 		}
 		//set slave metadata
@@ -2023,7 +2186,8 @@ jab_boolean fitDataIntoSymbols(jab_encode* enc, jab_data* encoded_data)
 			{
 				for(jab_int32 m=0; m<enc->symbols[enc->symbols[i].slaves[k]].metadata->length; m++)
 				{
-					enc->symbols[i].data->data[set_pos--] = enc->symbols[enc->symbols[i].slaves[k]].metadata->data[m];
+					PUT_BIT(enc->symbols[i].data, set_pos, enc->symbols[enc->symbols[i].slaves[k]].metadata->data[m]);
+					set_pos--;
 				}
 			}
 		}
@@ -2177,12 +2341,62 @@ jab_boolean setSlaveMetadata(jab_encode* enc)
 }
 
 /**
- * @brief Generate JABCode
+ * @brief Start collecting the stats of an encoding
+ * @param enc the encode parameters
+ * @return the start time
+*/
+jab_double beginEncodeStats(jab_encode* enc)
+{
+	if(enc->stats == NULL) return 0;
+	memset(enc->stats, 0, sizeof(jab_encode_stats));
+	enc->stats->mask_reference = DEFAULT_MASKING_REFERENCE;
+	for(jab_int32 t=0; t<NUMBER_OF_MASK_PATTERNS; t++)
+		enc->stats->mask_scores[t] = -1;
+	return getStatsTime();
+}
+
+/**
+ * @brief Finish collecting the stats of an encoding
+ * @param enc the encode parameters
+ * @param start the start time
+*/
+void endEncodeStats(jab_encode* enc, jab_double start)
+{
+	if(enc->stats) enc->stats->total_time = getStatsTime() - start;
+}
+
+/**
+ * @brief Record the parameters chosen for the encoded symbols in the encoding stats
+ * @param enc the encode parameters
+ * @param cp the code parameters
+ * @param encoded_length the length of the encoded input data in bits
+*/
+void setEncodeStatsParameters(jab_encode* enc, jab_code* cp, jab_int32 encoded_length)
+{
+	jab_encode_stats* stats = enc->stats;
+	stats->encoded_length = encoded_length;
+	stats->color_number	  = enc->color_number;
+	stats->symbol_number  = enc->symbol_number;
+	stats->code_size	  = cp->code_size;
+	for(jab_int32 i=0; i<enc->symbol_number; i++)
+	{
+		stats->ldpc_time += stats->symbol_ldpc_time[i];
+		stats->symbol_versions[i]	= enc->symbol_versions[i];
+		stats->symbol_ecc_levels[i] = enc->symbol_ecc_levels[i];
+		stats->symbol_wcwr[i][0]	= enc->symbols[i].wcwr[0];
+		stats->symbol_wcwr[i][1]	= enc->symbols[i].wcwr[1];
+		stats->symbol_capacity[i]	= enc->symbols[i].data->length;
+	}
+}
+
+/**
+ * @brief Encode the input data into masked symbols
  * @param enc the encode parameters
  * @param data the input data
+ * @param code_para the code parameters of the masked symbols
  * @return 0:success | 1: out of memory | 2:no input data | 3:incorrect symbol version or position | 4: input data too long
 */
-jab_int32 generateJABCode(jab_encode* enc, jab_data* data)
+jab_int32 encodeSymbols(jab_encode* enc, jab_data* data, jab_code** code_para)
 {
     //Check data
     if(data == NULL)
@@ -2196,11 +2410,22 @@ jab_int32 generateJABCode(jab_encode* enc, jab_data* data)
         return 2;
     }
 
-    //initialize symbols and set metadata in symbols
-    if(!InitSymbols(enc))
-		return 3;
+    //release the data of the previous message if the encode object is reused
+    resetSymbolPayloads(enc);
+    if(!enc->compiled)
+    {
+        if(enc->auto_master_version)
+        {
+            enc->symbol_versions[0].x = 0;
+            enc->symbol_versions[0].y = 0;
+        }
+        //initialize symbols and set metadata in symbols
+        if(!InitSymbols(enc))
+            return 3;
+    }
 
     //get the optimal encoded length and encoding sequence
+    ENCODE_STATS_START(enc, analyze_start)
     jab_int32 encoded_length;
     jab_int32* encode_seq = analyzeInputData(data, &encoded_length);
     if(encode_seq == NULL)
@@ -2208,16 +2433,21 @@ jab_int32 generateJABCode(jab_encode* enc, jab_data* data)
 		reportError("Analyzing input data failed");
 		return 1;
     }
+    ENCODE_STATS_STOP(enc, analyze_start, analyze_time)
 	//encode data using optimal encoding modes
-    jab_data* encoded_data = encodeData(data, encoded_length, encode_seq);
+    ENCODE_STATS_START(enc, encode_start)
+    jab_bitstream* encoded_data = encodeData(data, encoded_length, encode_seq);
     free(encode_seq);
     if(encoded_data == NULL)
     {
         return 1;
     }
+    ENCODE_STATS_STOP(enc, encode_start, encode_time)
     //set master symbol version if not given
+    ENCODE_STATS_START(enc, fit_start)
     if(enc->symbol_number == 1 && (enc->symbol_versions[0].x == 0 || enc->symbol_versions[0].y == 0))
     {
+        enc->auto_master_version = 1;
         if(!setMasterSymbolVersion(enc, encoded_data))
         {
         	free(encoded_data);
@@ -2246,22 +2476,37 @@ jab_int32 generateJABCode(jab_encode* enc, jab_data* data)
             return 1;
 		}
 	}
+	ENCODE_STATS_STOP(enc, fit_start, fit_time)
 
     //encode each symbol in turn
     for(jab_int32 i=0; i<enc->symbol_number; i++)
     {
         //error correction for data
-        jab_data* ecc_encoded_data = encodeLDPC(enc->symbols[i].data, enc->symbols[i].wcwr);
+        ENCODE_STATS_START(enc, ldpc_start)
+        jab_bitstream* ecc_encoded_data = encodeLDPC(enc->symbols[i].data, enc->symbols[i].wcwr);
         if(ecc_encoded_data == NULL)
         {
             JAB_REPORT_ERROR(("LDPC encoding for the data in symbol %d failed", i))
             return 1;
         }
+        ENCODE_STATS_STOP(enc, ldpc_start, symbol_ldpc_time[i])
         //interleave
-        interleaveData(ecc_encoded_data);
-        //create Matrix
-        jab_boolean cm_flag = createMatrix(enc, i, ecc_encoded_data);
+        ENCODE_STATS_START(enc, interleave_start)
+        jab_bitstream* interleaved_data = createBitstream(ecc_encoded_data->length);
+        if(interleaved_data == NULL || !interleaveData(ecc_encoded_data, interleaved_data))
+        {
+            JAB_REPORT_ERROR(("Interleaving the data in symbol %d failed", i))
+            free(interleaved_data);
+            free(ecc_encoded_data);
+            return 1;
+        }
         free(ecc_encoded_data);
+        ENCODE_STATS_STOP(enc, interleave_start, interleave_time)
+        //create Matrix
+        ENCODE_STATS_START(enc, matrix_start)
+        jab_boolean cm_flag = createMatrix(enc, i, interleaved_data);
+        free(interleaved_data);
+        ENCODE_STATS_STOP(enc, matrix_start, matrix_time)
         if(!cm_flag)
         {
 			JAB_REPORT_ERROR(("Creating matrix for symbol %d failed", i))
@@ -2270,23 +2515,26 @@ jab_int32 generateJABCode(jab_encode* enc, jab_data* data)
     }
 
     //mask all symbols in the code
-    jab_code* cp = getCodePara(enc);
+    ENCODE_STATS_START(enc, mask_start)
+    jab_code* cp = enc->compiled ? enc->code_para : getCodePara(enc);
     if(!cp)
     {
 		return 1;
     }
     if(isDefaultMode(enc))	//default mode
 	{
-		maskSymbols(enc, DEFAULT_MASKING_REFERENCE, 0, 0);
+		if(!maskSymbols(enc, DEFAULT_MASKING_REFERENCE, 0, 0))
+		{
+			releaseCodePara(enc, cp);
+			return 1;
+		}
 	}
 	else
 	{
 		jab_int32 mask_reference = maskCode(enc, cp);
 		if(mask_reference < 0)
 		{
-			free(cp->row_height);
-			free(cp->col_width);
-			free(cp);
+			releaseCodePara(enc, cp);
 			return 1;
 		}
 #if TEST_MODE
@@ -2300,20 +2548,246 @@ jab_int32 generateJABCode(jab_encode* enc, jab_data* data)
 			placeMasterMetadataPartII(enc);
 		}
 	}
+	ENCODE_STATS_STOP(enc, mask_start, mask_time)
+
+	if(enc->stats)
+		setEncodeStatsParameters(enc, cp, encoded_length);
+	//with fixed symbol versions, the next messages only need the message dependent steps
+	if(!enc->compiled && !enc->auto_master_version)
+	{
+		enc->code_para = cp;
+		enc->compiled = 1;
+	}
+    *code_para = cp;
+    return 0;
+}
+
+/**
+ * @brief Generate JABCode
+ * @param enc the encode parameters, which can be reused to generate further codes with the same parameters
+ * @param data the input data
+ * @return 0:success | 1: out of memory | 2:no input data | 3:incorrect symbol version or position | 4: input data too long
+*/
+jab_int32 generateJABCode(jab_encode* enc, jab_data* data)
+{
+    jab_double start = beginEncodeStats(enc);
+    jab_code* cp = NULL;
+    jab_int32 status = encodeSymbols(enc, data, &cp);
+    if(status != 0)
+    {
+        return status;
+    }
 
     //create the code bitmap
+    ENCODE_STATS_START(enc, bitmap_start)
     jab_boolean cb_flag = createBitmap(enc, cp);
-    free(cp->row_height);
-    free(cp->col_width);
-    free(cp);
+    ENCODE_STATS_STOP(enc, bitmap_start, bitmap_time)
+    releaseCodePara(enc, cp);
     if(!cb_flag)
 	{
 		JAB_REPORT_ERROR(("Creating the code bitmap failed"))
 		return 1;
 	}
+    endEncodeStats(enc, start);
+    return 0;
+}
+
+/**
+ * @brief Generate JABCode as a matrix of module color indexes, without rendering the code bitmap
+ * @param enc the encode parameters, which can be reused to generate further codes with the same parameters
+ * @param data the input data
+ * @return 0:success | 1: out of memory | 2:no input data | 3:incorrect symbol version or position | 4: input data too long
+*/
+jab_int32 generateJABCodeMatrix(jab_encode* enc, jab_data* data)
+{
+    jab_double start = beginEncodeStats(enc);
+    jab_code* cp = NULL;
+    jab_int32 status = encodeSymbols(enc, data, &cp);
+    if(status != 0)
+    {
+        return status;
+    }
+
+    //create the code matrix
+    ENCODE_STATS_START(enc, matrix_start)
+    jab_boolean cm_flag = createCodeMatrix(enc, cp);
+    ENCODE_STATS_STOP(enc, matrix_start, bitmap_time)
+    releaseCodePara(enc, cp);
+    if(!cm_flag)
+	{
+		JAB_REPORT_ERROR(("Creating the code matrix failed"))
+		return 1;
+	}
+    endEncodeStats(enc, start);
     return 0;
 }
 
+/**
+ * @brief Create an encode object with the same encode parameters as another one
+ * @param enc the encode object to be copied
+ * @return the new encode object | NULL if failed
+*/
+jab_encode* copyEncodeParameters(jab_encode* enc)
+{
+    jab_encode* copy = createEncode(enc->color_number, enc->symbol_number);
+    if(copy == NULL)
+    {
+        reportError("Memory allocation for encode object failed");
+        return NULL;
+    }
+    copy->module_size 		  = enc->module_size;
+    copy->master_symbol_width = enc->master_symbol_width;
+    copy->master_symbol_height= enc->master_symbol_height;
+    copy->auto_master_version = enc->auto_master_version;
+    copy->mask_sample_modules = enc->mask_sample_modules;
+    memcpy(copy->palette, enc->palette, enc->color_number * 3 * sizeof(jab_byte));
+    memcpy(copy->symbol_versions, enc->symbol_versions, enc->symbol_number * sizeof(jab_vector2d));
+    memcpy(copy->symbol_ecc_levels, enc->symbol_ecc_levels, enc->symbol_number * sizeof(jab_byte));
+    memcpy(copy->symbol_positions, enc->symbol_positions, enc->symbol_number * sizeof(jab_int32));
+    return copy;
+}
+
+/**
+ * @brief Worker thread generating codes of a batch until no code is left
+ * @param arg the encode batch
+ * @return NULL
+*/
+void* encodeBatchWorker(void* arg)
+{
+    jab_encode_batch* batch = (jab_encode_batch*)arg;
+    //each worker reuses its own encode object, which bounds the memory in flight to one code per worker
+    jab_encode* enc = copyEncodeParameters(batch->params);
+    if(enc == NULL)
+    {
+        return NULL;
+    }
+    //the batch already runs one worker per thread, so the mask patterns are evaluated by the worker itself
+    enc->mask_threads = 1;
+    pthread_mutex_lock(&batch->lock);
+    while(!batch->stop && batch->next < batch->count)
+    {
+        jab_int32 index = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+
+        jab_int32 status = batch->matrix ? generateJABCodeMatrix(enc, batch->data[index]) : generateJABCode(enc, batch->data[index]);
+        jab_boolean go_on = batch->callback(index, status, enc, batch->user_data);
+
+        pthread_mutex_lock(&batch->lock);
+        if(status == 0)
+        {
+            batch->generated++;
+        }
+        if(!go_on)
+        {
+            batch->stop = 1;
+        }
+    }
+    pthread_mutex_unlock(&batch->lock);
+    destroyEncode(enc);
+    return NULL;
+}
+
+/**
+ * @brief Generate a batch of JABCodes with the same encode parameters on multiple threads
+ * @param enc the encode parameters shared by all codes
+ * @param data the input data of each code
+ * @param data_number the number of codes
+ * @param thread_number the number of worker threads, 0 for the default number
+ * @param callback the function receiving each generated code, called concurrently from the worker threads
+ * @param user_data the user data passed to the callback
+ * @param codes_per_second the throughput of the batch in codes per second | NULL if not needed
+ * @param matrix set to generate code matrices instead of bitmaps
+ * @return the number of successfully generated codes | -1 if failed
+*/
+jab_int32 runEncodeBatch(jab_encode* enc, jab_data** data, jab_int32 data_number, jab_int32 thread_number, jab_encode_callback callback, void* user_data, jab_double* codes_per_second, jab_boolean matrix)
+{
+    if(enc == NULL || data == NULL || data_number < 0 || callback == NULL)
+    {
+        reportError("Invalid batch encode parameters");
+        return -1;
+    }
+    if(thread_number <= 0)
+        thread_number = DEFAULT_ENCODE_THREADS;
+    thread_number = MIN(MIN(thread_number, MAX_ENCODE_THREADS), MAX(data_number, 1));
+
+    jab_encode_batch batch;
+    batch.params	= enc;
+    batch.data		= data;
+    batch.count		= data_number;
+    batch.next		= 0;
+    batch.generated = 0;
+    batch.stop		= 0;
+    batch.matrix	= matrix;
+    batch.callback	= callback;
+    batch.user_data = user_data;
+    if(pthread_mutex_init(&batch.lock, NULL) != 0)
+    {
+        reportError("Initializing batch lock failed");
+        return -1;
+    }
+
+    struct timespec start, end;
+    timespec_get(&start, TIME_UTC);
+
+    pthread_t threads[MAX_ENCODE_THREADS];
+    jab_int32 started = 0;
+    for(jab_int32 i=1; i<thread_number; i++)
+    {
+        if(pthread_create(&threads[started], NULL, encodeBatchWorker, &batch) == 0)
+        {
+            started++;
+        }
+    }
+    //the calling thread works as well, so the batch completes even if no thread could be started
+    encodeBatchWorker(&batch);
+    for(jab_int32 i=0; i<started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    timespec_get(&end, TIME_UTC);
+    pthread_mutex_destroy(&batch.lock);
+
+    if(codes_per_second)
+    {
+        jab_double seconds = (jab_double)(end.tv_sec - start.tv_sec) + (jab_double)(end.tv_nsec - start.tv_nsec) / 1e9;
+        *codes_per_second = seconds > 0 ? batch.generated / seconds : 0;
+    }
+    return batch.generated;
+}
+
+/**
+ * @brief Generate a batch of JABCodes with the same encode parameters on multiple threads
+ * @param enc the encode parameters shared by all codes
+ * @param data the input data of each code
+ * @param data_number the number of codes
+ * @param thread_number the number of worker threads, 0 for the default number
+ * @param callback the function receiving each generated code bitmap, called concurrently from the worker threads
+ * @param user_data the user data passed to the callback
+ * @param codes_per_second the throughput of the batch in codes per second | NULL if not needed
+ * @return the number of successfully generated codes | -1 if failed
+*/
+jab_int32 generateJABCodeBatch(jab_encode* enc, jab_data** data, jab_int32 data_number, jab_int32 thread_number, jab_encode_callback callback, void* user_data, jab_double* codes_per_second)
+{
+    return runEncodeBatch(enc, data, data_number, thread_number, callback, user_data, codes_per_second, 0);
+}
+
+/**
+ * @brief Generate a batch of JABCode matrices with the same encode parameters on multiple threads
+ * @param enc the encode parameters shared by all codes
+ * @param data the input data of each code
+ * @param data_number the number of codes
+ * @param thread_number the number of worker threads, 0 for the default number
+ * @param callback the function receiving each generated code matrix, called concurrently from the worker threads
+ * @param user_data the user data passed to the callback
+ * @param codes_per_second the throughput of the batch in codes per second | NULL if not needed
+ * @return the number of successfully generated codes | -1 if failed
+*/
+jab_int32 generateJABCodeMatrixBatch(jab_encode* enc, jab_data** data, jab_int32 data_number, jab_int32 thread_number, jab_encode_callback callback, void* user_data, jab_double* codes_per_second)
+{
+    return runEncodeBatch(enc, data, data_number, thread_number, callback, user_data, codes_per_second, 1);
+}
+
 /**
  * @brief Report error message
  * @param message the error message
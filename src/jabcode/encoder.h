@@ -14,6 +14,12 @@
 #ifndef JABCODE_ENCODER_H
 #define JABCODE_ENCODER_H
 
+#include <pthread.h>
+
+//stage timing of an encoding, only a test of the stats pointer if no stats are collected
+#define ENCODE_STATS_START(enc, t)			jab_double t = (enc)->stats ? getStatsTime() : 0;
+#define ENCODE_STATS_STOP(enc, t, field)	{ if((enc)->stats) (enc)->stats->field += getStatsTime() - t; }
+
 /**
  * @brief Default color palette in RGB format
 */
@@ -88,7 +94,7 @@ static const jab_byte apx_core_color_index[] = {0, 2, APX_CORE_COLOR, 14, 30, 60
 /**
  * @brief Code parameters
 */
-typedef struct {
+typedef struct jab_code {
 	jab_int32 		dimension;				///<Module size in pixel
 	jab_vector2d	code_size;				///<Code size in symbol
 	jab_int32 		min_x;
@@ -272,9 +278,29 @@ static const jab_int32 jab_ap_num[32] = {2, 2, 2, 2, 2,
 										 8, 8, 8, 8,
 										 9, 9, 9};
 
-extern void interleaveData(jab_data* data);
+/**
+ * @brief Batch of codes generated by a pool of worker threads
+*/
+typedef struct {
+	jab_encode*		params;			///<The encode parameters shared by all codes
+	jab_data**		data;			///<The input data of each code
+	jab_int32		count;			///<The number of codes
+	jab_int32		next;			///<The index of the next code to be generated
+	jab_int32		generated;		///<The number of successfully generated codes
+	jab_boolean		stop;			///<Set if the callback stopped the batch
+	jab_boolean		matrix;			///<Set if the codes are generated as code matrices instead of bitmaps
+	jab_encode_callback callback;
+	void*			user_data;
+	pthread_mutex_t	lock;
+}jab_encode_batch;
+
+typedef struct jab_bitstream jab_bitstream;
+
+extern jab_boolean interleaveData(const jab_bitstream* data, jab_bitstream* interleaved);
+extern void clearPermutationCache(void);
 extern jab_int32 maskCode(jab_encode* enc, jab_code* cp);
-extern void maskSymbols(jab_encode* enc, jab_int32 mask_type, jab_int32* masked, jab_code* cp);
+extern void getSymbolOrigin(jab_encode* enc, jab_int32 index, jab_code* cp, jab_int32* startx, jab_int32* starty);
+extern jab_boolean maskSymbols(jab_encode* enc, jab_int32 mask_type, jab_byte* masked, jab_code* cp);
 extern void getNextMetadataModuleInMaster(jab_int32 matrix_height, jab_int32 matrix_width, jab_int32 next_module_count, jab_int32* x, jab_int32* y);
 
 #endif
@@ -12,12 +12,15 @@
  */
 
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "jabcode.h"
 #include "png.h"
 #include "tiffio.h"
 
+#define CMYK_CACHE_SIZE		64	//the number of colors cached when converting a bitmap to CMYK
+
 /**
  * @brief Save code bitmap in RGB as png image
  * @param bitmap the code bitmap
@@ -58,64 +61,224 @@ jab_boolean saveImage(jab_bitmap* bitmap, jab_char* filename)
 }
 
 /**
- * @brief Convert a bitmap from RGB to CMYK color space
- * @param bitmap the bitmap in RGB
- * @return the bitmap in CMYK | JAB_FAILURE
+ * @brief Get the palette indexes of a module row, the gaps between symbols get the gap index
+ * @param matrix the code matrix
+ * @param y the module row
+ * @param gap_index the palette index of the gaps
+ * @param indexes the palette index of each module in the row
 */
-jab_bitmap* convertRGB2CMYK(jab_bitmap* rgb)
+void getModuleRowIndexes(const jab_code_matrix* matrix, jab_int32 y, jab_byte gap_index, jab_byte* indexes)
 {
-	if(rgb->channel_count < 3)
+	memset(indexes, gap_index, matrix->width);
+	for(jab_int32 k=0; k<matrix->symbol_number; k++)
 	{
-		JAB_REPORT_ERROR(("Not true color RGB bitmap"))
-        return JAB_FAILURE;
+		jab_vector2d origin = matrix->symbol_origins[k];
+		if(y >= origin.y && y < origin.y + matrix->symbol_sizes[k].y)
+		{
+			memcpy(indexes + origin.x, matrix->module + y * matrix->width + origin.x, matrix->symbol_sizes[k].x);
+		}
 	}
-	jab_int32 w = rgb->width;
-	jab_int32 h = rgb->height;
-	jab_bitmap* cmyk = (jab_bitmap *)malloc(sizeof(jab_bitmap) + w*h*BITMAP_CHANNEL_COUNT*sizeof(jab_byte));
-	if(cmyk == NULL)
-    {
-        JAB_REPORT_ERROR(("Memory allocation for CMYK bitmap failed"))
-        return JAB_FAILURE;
-    }
-    cmyk->width = w;
-    cmyk->height= h;
-    cmyk->bits_per_pixel = BITMAP_BITS_PER_PIXEL;
-    cmyk->bits_per_channel = BITMAP_BITS_PER_CHANNEL;
-    cmyk->channel_count = BITMAP_CHANNEL_COUNT;
-
-	jab_int32 rgb_bytes_per_pixel = rgb->bits_per_pixel / 8;
-    jab_int32 rgb_bytes_per_row = rgb->width * rgb_bytes_per_pixel;
-    jab_int32 cmyk_bytes_per_pixel = rgb->bits_per_pixel / 8;
-    jab_int32 cmyk_bytes_per_row = rgb->width * cmyk_bytes_per_pixel;
+}
 
+/**
+ * @brief Check if a code matrix has gaps between its symbols
+ * @param matrix the code matrix
+ * @return 1: some modules are outside the symbols | 0: no gaps
+*/
+jab_boolean hasSymbolGaps(const jab_code_matrix* matrix)
+{
+	jab_int32 symbol_area = 0;
+	for(jab_int32 k=0; k<matrix->symbol_number; k++)
+	{
+		symbol_area += matrix->symbol_sizes[k].x * matrix->symbol_sizes[k].y;
+	}
+	return symbol_area < matrix->width * matrix->height;
+}
 
-    for(jab_int32 i=0; i<h; i++)
+/**
+ * @brief Save code matrix as palette-indexed png image
+ * @param matrix the code matrix
+ * @param options the compression options | NULL for the default options
+ * @param filename the image filename
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean saveImagePalette(const jab_code_matrix* matrix, const jab_png_options* options, jab_char* filename)
+{
+	//the gaps between symbols are transparent and need an extra palette entry
+	jab_boolean has_gap = hasSymbolGaps(matrix);
+	jab_int32 entry_number = matrix->color_number + has_gap;
+	if(entry_number > PNG_MAX_PALETTE_LENGTH)
 	{
-		for(jab_int32 j=0; j<w; j++)
+		//no palette entry left for the gaps, save the rendered bitmap instead
+		jab_bitmap* bitmap = renderJABCodeMatrix(matrix);
+		if(bitmap == NULL)
 		{
-			jab_double r1 = (jab_double)rgb->pixel[i*rgb_bytes_per_row + j*rgb_bytes_per_pixel + 0] / 255.0;
-			jab_double g1 = (jab_double)rgb->pixel[i*rgb_bytes_per_row + j*rgb_bytes_per_pixel + 1] / 255.0;
-			jab_double b1 = (jab_double)rgb->pixel[i*rgb_bytes_per_row + j*rgb_bytes_per_pixel + 2] / 255.0;
+			return JAB_FAILURE;
+		}
+		jab_boolean status = saveImage(bitmap, filename);
+		free(bitmap);
+		return status;
+	}
+	jab_int32 bit_depth = entry_number <= 2 ? 1 : (entry_number <= 4 ? 2 : (entry_number <= 16 ? 4 : 8));
 
-			jab_double k = 1 - MAX(r1, MAX(g1, b1));
+	jab_int32 width = matrix->width * matrix->module_size;
+	jab_int32 height= matrix->height * matrix->module_size;
+	jab_int32 row_bytes = (width * bit_depth + 7) / 8;
+	jab_byte* indexes = (jab_byte *)malloc(matrix->width * sizeof(jab_byte));
+	jab_byte* row = (jab_byte *)malloc(row_bytes * sizeof(jab_byte));
+	if(indexes == NULL || row == NULL)
+	{
+		free(indexes);
+		free(row);
+		reportError("Memory allocation for png row failed");
+		return JAB_FAILURE;
+	}
 
-			if(k == 1)
-			{
-				cmyk->pixel[i*cmyk_bytes_per_row + j*cmyk_bytes_per_pixel + 0] = 0;	//C
-				cmyk->pixel[i*cmyk_bytes_per_row + j*cmyk_bytes_per_pixel + 1] = 0;	//M
-				cmyk->pixel[i*cmyk_bytes_per_row + j*cmyk_bytes_per_pixel + 2] = 0;	//Y
-				cmyk->pixel[i*cmyk_bytes_per_row + j*cmyk_bytes_per_pixel + 3] = 255;	//K
-			}
-			else
-			{
-				cmyk->pixel[i*cmyk_bytes_per_row + j*cmyk_bytes_per_pixel + 0] = (jab_byte)((1.0 - r1 - k) / (1.0 - k) * 255);	//C
-				cmyk->pixel[i*cmyk_bytes_per_row + j*cmyk_bytes_per_pixel + 1] = (jab_byte)((1.0 - g1 - k) / (1.0 - k) * 255);	//M
-				cmyk->pixel[i*cmyk_bytes_per_row + j*cmyk_bytes_per_pixel + 2] = (jab_byte)((1.0 - b1 - k) / (1.0 - k) * 255);	//Y
-				cmyk->pixel[i*cmyk_bytes_per_row + j*cmyk_bytes_per_pixel + 3] = (jab_byte)(k * 255);								//K
-			}
+	FILE* fp = fopen(filename, "wb");
+	if(fp == NULL)
+	{
+		free(indexes);
+		free(row);
+		JAB_REPORT_ERROR(("Cannot open %s for writing", filename))
+		return JAB_FAILURE;
+	}
+	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	png_infop info = png ? png_create_info_struct(png) : NULL;
+	if(info == NULL)
+	{
+		png_destroy_write_struct(&png, NULL);
+		fclose(fp);
+		free(indexes);
+		free(row);
+		reportError("Creating png writer failed");
+		return JAB_FAILURE;
+	}
+	if(setjmp(png_jmpbuf(png)))
+	{
+		png_destroy_write_struct(&png, &info);
+		fclose(fp);
+		free(indexes);
+		free(row);
+		reportError("Saving png image failed");
+		return JAB_FAILURE;
+	}
+	png_init_io(png, fp);
+
+	//compression options
+	if(options)
+	{
+		if(options->level >= 0)
+			png_set_compression_level(png, options->level);
+		png_set_compression_strategy(png, options->strategy);
+		png_set_filter(png, PNG_FILTER_TYPE_BASE, options->filter ? PNG_ALL_FILTERS : PNG_FILTER_NONE);
+	}
+	else
+	{
+		png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);
+	}
+
+	png_set_IHDR(png, info, width, height, bit_depth, PNG_COLOR_TYPE_PALETTE,
+				 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	png_color palette[PNG_MAX_PALETTE_LENGTH];
+	png_byte alpha[PNG_MAX_PALETTE_LENGTH];
+	for(jab_int32 i=0; i<matrix->color_number; i++)
+	{
+		palette[i].red	= matrix->palette[i * 3];
+		palette[i].green= matrix->palette[i * 3 + 1];
+		palette[i].blue	= matrix->palette[i * 3 + 2];
+		alpha[i] = 255;
+	}
+	if(has_gap)
+	{
+		palette[matrix->color_number].red	= 0;
+		palette[matrix->color_number].green	= 0;
+		palette[matrix->color_number].blue	= 0;
+		alpha[matrix->color_number] = 0;
+		png_set_tRNS(png, info, alpha, entry_number, NULL);
+	}
+	png_set_PLTE(png, info, palette, entry_number);
+	png_write_info(png, info);
+
+	//expand each module row to one packed pixel row and write it once per pixel row of the module
+	jab_int32 pixels_per_byte = 8 / bit_depth;
+	for(jab_int32 y=0; y<matrix->height; y++)
+	{
+		getModuleRowIndexes(matrix, y, (jab_byte)matrix->color_number, indexes);
+		memset(row, 0, row_bytes);
+		for(jab_int32 x=0; x<width; x++)
+		{
+			jab_int32 shift = 8 - bit_depth * (x % pixels_per_byte + 1);
+			row[x / pixels_per_byte] |= indexes[x / matrix->module_size] << shift;
 		}
+		for(jab_int32 i=0; i<matrix->module_size; i++)
+		{
+			png_write_row(png, row);
+		}
+	}
+	png_write_end(png, NULL);
+
+	png_destroy_write_struct(&png, &info);
+	fclose(fp);
+	free(indexes);
+	free(row);
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Convert a color from RGB to CMYK color space
+ * @param rgb the color in RGB
+ * @param cmyk the color in CMYK
+*/
+void convertRGB2CMYK(const jab_byte* rgb, jab_byte* cmyk)
+{
+	jab_double r1 = (jab_double)rgb[0] / 255.0;
+	jab_double g1 = (jab_double)rgb[1] / 255.0;
+	jab_double b1 = (jab_double)rgb[2] / 255.0;
+
+	jab_double k = 1 - MAX(r1, MAX(g1, b1));
+
+	if(k == 1)
+	{
+		cmyk[0] = 0;	//C
+		cmyk[1] = 0;	//M
+		cmyk[2] = 0;	//Y
+		cmyk[3] = 255;	//K
+	}
+	else
+	{
+		cmyk[0] = (jab_byte)((1.0 - r1 - k) / (1.0 - k) * 255);	//C
+		cmyk[1] = (jab_byte)((1.0 - g1 - k) / (1.0 - k) * 255);	//M
+		cmyk[2] = (jab_byte)((1.0 - b1 - k) / (1.0 - k) * 255);	//Y
+		cmyk[3] = (jab_byte)(k * 255);								//K
 	}
-    return cmyk;
+}
+
+/**
+ * @brief Open a TIFF image for writing CMYK scanlines
+ * @param filename the image filename
+ * @param width the image width
+ * @param height the image height
+ * @return the TIFF image | NULL if failed
+*/
+TIFF* openImageCMYK(jab_char* filename, jab_int32 width, jab_int32 height)
+{
+	TIFF *out= TIFFOpen(filename, "w");
+	if(out == NULL)
+	{
+		JAB_REPORT_ERROR(("Cannot open %s for writing", filename))
+		return NULL;
+	}
+
+	TIFFSetField(out, TIFFTAG_IMAGEWIDTH, width);
+	TIFFSetField(out, TIFFTAG_IMAGELENGTH, height);
+	TIFFSetField(out, TIFFTAG_SAMPLESPERPIXEL, BITMAP_CHANNEL_COUNT);
+	TIFFSetField(out, TIFFTAG_BITSPERSAMPLE, BITMAP_BITS_PER_CHANNEL);
+	TIFFSetField(out, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+	TIFFSetField(out, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(out, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_SEPARATED);
+	jab_int32 rows_per_strip = TIFFDefaultStripSize(out, -1);
+	TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, rows_per_strip);
+	return out;
 }
 
 /**
@@ -127,47 +290,59 @@ jab_bitmap* convertRGB2CMYK(jab_bitmap* rgb)
 */
 jab_boolean saveImageCMYK(jab_bitmap* bitmap, jab_boolean isCMYK, jab_char* filename)
 {
-	jab_bitmap* cmyk = 0;
-
-	if(isCMYK)
+	if(!isCMYK && bitmap->channel_count < 3)
 	{
-		cmyk = bitmap;
+		JAB_REPORT_ERROR(("Not true color RGB bitmap"))
+		return JAB_FAILURE;
 	}
-	else
+	jab_int32 bytes_per_pixel = bitmap->bits_per_pixel / 8;
+	jab_int32 bytes_per_row = bitmap->width * bytes_per_pixel;
+	jab_byte* scanline = NULL;
+	if(!isCMYK)
 	{
-		cmyk = convertRGB2CMYK(bitmap);
-		if(cmyk == NULL)
+		scanline = (jab_byte *)malloc(bitmap->width * BITMAP_CHANNEL_COUNT * sizeof(jab_byte));
+		if(scanline == NULL)
 		{
-			JAB_REPORT_ERROR(("Converting RGB to CMYK failed"))
+			JAB_REPORT_ERROR(("Memory allocation for CMYK scanline failed"))
 			return JAB_FAILURE;
 		}
 	}
 
 	//save CMYK image as TIFF
-	TIFF *out= TIFFOpen(filename, "w");
+	TIFF* out = openImageCMYK(filename, bitmap->width, bitmap->height);
 	if(out == NULL)
 	{
-		JAB_REPORT_ERROR(("Cannot open %s for writing", filename))
-		if(!isCMYK)	free(cmyk);
+		free(scanline);
 		return JAB_FAILURE;
 	}
 
-	TIFFSetField(out, TIFFTAG_IMAGEWIDTH, cmyk->width);
-	TIFFSetField(out, TIFFTAG_IMAGELENGTH, cmyk->height);
-	TIFFSetField(out, TIFFTAG_SAMPLESPERPIXEL, cmyk->channel_count);
-	TIFFSetField(out, TIFFTAG_BITSPERSAMPLE, cmyk->bits_per_channel);
-	TIFFSetField(out, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
-	TIFFSetField(out, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-	TIFFSetField(out, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_SEPARATED);
-	jab_int32 rows_per_strip = TIFFDefaultStripSize(out, -1);
-	TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, rows_per_strip);
+	//a code bitmap holds only a few colors, so each distinct color is converted only once
+	jab_uint32 cache_rgb[CMYK_CACHE_SIZE];
+	jab_byte   cache_cmyk[CMYK_CACHE_SIZE][4];
+	jab_boolean cache_valid[CMYK_CACHE_SIZE] = {0};
 
 	//write image to the file one scanline at a time
-	jab_int32 row_size = cmyk->width * cmyk->channel_count;
 	jab_boolean status = JAB_SUCCESS;
-	for(jab_int32 row=0; row<cmyk->height; row++)
+	for(jab_int32 row=0; row<bitmap->height; row++)
 	{
-		if(TIFFWriteScanline(out, &cmyk->pixel[row * row_size], row, 0) < 0)
+		jab_byte* pixel = &bitmap->pixel[row * bytes_per_row];
+		if(!isCMYK)
+		{
+			for(jab_int32 j=0; j<bitmap->width; j++)
+			{
+				jab_byte* rgb = pixel + j * bytes_per_pixel;
+				jab_uint32 key = (rgb[0] << 16) | (rgb[1] << 8) | rgb[2];
+				jab_int32 slot = (rgb[0] * 7 + rgb[1] * 3 + rgb[2]) % CMYK_CACHE_SIZE;
+				if(!cache_valid[slot] || cache_rgb[slot] != key)
+				{
+					convertRGB2CMYK(rgb, cache_cmyk[slot]);
+					cache_rgb[slot] = key;
+					cache_valid[slot] = 1;
+				}
+				memcpy(scanline + j * BITMAP_CHANNEL_COUNT, cache_cmyk[slot], BITMAP_CHANNEL_COUNT);
+			}
+		}
+		if(TIFFWriteScanline(out, isCMYK ? pixel : scanline, row, 0) < 0)
 		{
 			status = JAB_FAILURE;
 			break;
@@ -175,10 +350,129 @@ jab_boolean saveImageCMYK(jab_bitmap* bitmap, jab_boolean isCMYK, jab_char* file
 	}
 
 	TIFFClose(out);
-	if(!isCMYK)	free(cmyk);
+	free(scanline);
+	return status;
+}
+
+/**
+ * @brief Save code matrix in CMYK as TIFF image
+ * @param matrix the code matrix
+ * @param filename the image filename
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean saveImageCMYKFromMatrix(const jab_code_matrix* matrix, jab_char* filename)
+{
+	//the gaps between symbols are converted as black like in the code bitmap and need an extra palette index
+	if(matrix->color_number >= MAX_COLOR_NUMBER && hasSymbolGaps(matrix))
+	{
+		//no palette index left for the gaps, save the rendered bitmap instead
+		jab_bitmap* bitmap = renderJABCodeMatrix(matrix);
+		if(bitmap == NULL)
+		{
+			return JAB_FAILURE;
+		}
+		jab_boolean status = saveImageCMYK(bitmap, 0, filename);
+		free(bitmap);
+		return status;
+	}
+
+	//convert each palette color once
+	jab_byte cmyk_palette[(MAX_COLOR_NUMBER + 1) * BITMAP_CHANNEL_COUNT];
+	for(jab_int32 i=0; i<matrix->color_number; i++)
+	{
+		convertRGB2CMYK(&matrix->palette[i * 3], &cmyk_palette[i * BITMAP_CHANNEL_COUNT]);
+	}
+	jab_byte black[3] = {0, 0, 0};
+	jab_int32 gap_index = matrix->color_number;
+	convertRGB2CMYK(black, &cmyk_palette[gap_index * BITMAP_CHANNEL_COUNT]);
+
+	jab_int32 width = matrix->width * matrix->module_size;
+	jab_int32 height= matrix->height * matrix->module_size;
+	jab_byte* indexes = (jab_byte *)malloc(matrix->width * sizeof(jab_byte));
+	jab_byte* scanline = (jab_byte *)malloc(width * BITMAP_CHANNEL_COUNT * sizeof(jab_byte));
+	if(indexes == NULL || scanline == NULL)
+	{
+		free(indexes);
+		free(scanline);
+		JAB_REPORT_ERROR(("Memory allocation for CMYK scanline failed"))
+		return JAB_FAILURE;
+	}
+
+	//save CMYK image as TIFF
+	TIFF* out = openImageCMYK(filename, width, height);
+	if(out == NULL)
+	{
+		free(indexes);
+		free(scanline);
+		return JAB_FAILURE;
+	}
+
+	//expand each module row to one scanline and write it once per pixel row of the module
+	jab_boolean status = JAB_SUCCESS;
+	for(jab_int32 y=0; y<matrix->height && status; y++)
+	{
+		getModuleRowIndexes(matrix, y, (jab_byte)gap_index, indexes);
+		jab_byte* dst = scanline;
+		for(jab_int32 x=0; x<matrix->width; x++)
+		{
+			for(jab_int32 j=0; j<matrix->module_size; j++)
+			{
+				memcpy(dst, &cmyk_palette[indexes[x] * BITMAP_CHANNEL_COUNT], BITMAP_CHANNEL_COUNT);
+				dst += BITMAP_CHANNEL_COUNT;
+			}
+		}
+		for(jab_int32 i=0; i<matrix->module_size; i++)
+		{
+			if(TIFFWriteScanline(out, scanline, y * matrix->module_size + i, 0) < 0)
+			{
+				status = JAB_FAILURE;
+				break;
+			}
+		}
+	}
+
+	TIFFClose(out);
+	free(indexes);
+	free(scanline);
 	return status;
 }
 
+/**
+ * @brief Decode an opened png image into code bitmap
+ * @param image the opened png image
+ * @return Pointer to the code bitmap read from image | NULL
+*/
+jab_bitmap* finishReadImage(png_image* image)
+{
+	image->format = PNG_FORMAT_RGBA;
+
+	jab_bitmap* bitmap = (jab_bitmap *)calloc(1, sizeof(jab_bitmap) + PNG_IMAGE_SIZE(*image));
+	if(bitmap == NULL)
+	{
+		png_image_free(image);
+		reportError("Memory allocation failed");
+		return NULL;
+	}
+	bitmap->width = image->width;
+	bitmap->height= image->height;
+	bitmap->bits_per_channel = BITMAP_BITS_PER_CHANNEL;
+	bitmap->bits_per_pixel = BITMAP_BITS_PER_PIXEL;
+	bitmap->channel_count = BITMAP_CHANNEL_COUNT;
+
+	if(png_image_finish_read(image,
+							 NULL/*background*/,
+							 bitmap->pixel,
+							 0/*row_stride*/,
+							 NULL/*colormap*/) == 0)
+	{
+		free(bitmap);
+		reportError(image->message);
+		reportError("Reading png image failed");
+		return NULL;
+	}
+	return bitmap;
+}
+
 /**
  * @brief Read image into code bitmap
  * @param filename the image filename
@@ -190,42 +484,136 @@ jab_bitmap* readImage(jab_char* filename)
     memset(&image, 0, sizeof(image));
     image.version = PNG_IMAGE_VERSION;
 
-	jab_bitmap* bitmap;
-
-    if(png_image_begin_read_from_file(&image, filename))
+    if(!png_image_begin_read_from_file(&image, filename))
 	{
-		image.format = PNG_FORMAT_RGBA;
-
-		bitmap = (jab_bitmap *)calloc(1, sizeof(jab_bitmap) + PNG_IMAGE_SIZE(image));
-		if(bitmap == NULL)
-        {
-			png_image_free(&image);
-			reportError("Memory allocation failed");
-			return NULL;
-		}
-		bitmap->width = image.width;
-		bitmap->height= image.height;
-		bitmap->bits_per_channel = BITMAP_BITS_PER_CHANNEL;
-		bitmap->bits_per_pixel = BITMAP_BITS_PER_PIXEL;
-		bitmap->channel_count = BITMAP_CHANNEL_COUNT;
-
-        if(png_image_finish_read(&image,
-								 NULL/*background*/,
-								 bitmap->pixel,
-								 0/*row_stride*/,
-								 NULL/*colormap*/) == 0)
-		{
-			free(bitmap);
-			reportError(image.message);
-			reportError("Reading png image failed");
-			return NULL;
-		}
+		reportError(image.message);
+		reportError("Opening png image failed");
+		return NULL;
 	}
-	else
+	return finishReadImage(&image);
+}
+
+/**
+ * @brief Read png image data in memory into code bitmap
+ * @param buffer the png image data
+ * @param size the size of the png image data in bytes
+ * @return Pointer to the code bitmap read from image | NULL
+*/
+jab_bitmap* readImageFromMemory(const jab_byte* buffer, jab_int32 size)
+{
+	png_image image;
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+
+    if(!png_image_begin_read_from_memory(&image, buffer, size))
 	{
 		reportError(image.message);
 		reportError("Opening png image failed");
 		return NULL;
 	}
-	return bitmap;
+	return finishReadImage(&image);
+}
+
+/**
+ * @brief Png data source in memory
+*/
+typedef struct {
+	const jab_byte*	data;
+	jab_int32		size;
+	jab_int32		offset;
+}jab_png_source;
+
+/**
+ * @brief Read function of libpng fetching the png data from memory
+ * @param png the png reader
+ * @param data the destination of the read data
+ * @param length the number of bytes to read
+*/
+void readPNGFromMemory(png_structp png, png_bytep data, png_size_t length)
+{
+	jab_png_source* source = (jab_png_source*)png_get_io_ptr(png);
+	if(length > (png_size_t)(source->size - source->offset))
+	{
+		png_error(png, "Unexpected end of png data");
+	}
+	memcpy(data, source->data + source->offset, length);
+	source->offset += (jab_int32)length;
+}
+
+/**
+ * @brief Read png image data in memory row by row, without holding the whole image
+ * @param buffer the png image data
+ * @param size the size of the png image data in bytes
+ * @param callback the function receiving each decompressed row in RGBA
+ * @param user_data the user data passed to the callback
+ * @return JAB_SUCCESS, also if the callback stopped reading | JAB_FAILURE if the image could not be read
+*/
+jab_boolean readImageRows(const jab_byte* buffer, jab_int32 size, jab_image_row_callback callback, void* user_data)
+{
+	if(size < 8 || png_sig_cmp(buffer, 0, 8))
+	{
+		reportError("Not a png image");
+		return JAB_FAILURE;
+	}
+	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	png_infop info = png ? png_create_info_struct(png) : NULL;
+	if(info == NULL)
+	{
+		png_destroy_read_struct(&png, NULL, NULL);
+		reportError("Creating png reader failed");
+		return JAB_FAILURE;
+	}
+	jab_byte* volatile row = NULL;
+	if(setjmp(png_jmpbuf(png)))
+	{
+		png_destroy_read_struct(&png, &info, NULL);
+		free(row);
+		reportError("Reading png image failed");
+		return JAB_FAILURE;
+	}
+	jab_png_source source = {buffer, size, 0};
+	png_set_read_fn(png, &source, readPNGFromMemory);
+	png_read_info(png, info);
+
+	jab_int32 width = png_get_image_width(png, info);
+	jab_int32 height= png_get_image_height(png, info);
+	jab_int32 color_type = png_get_color_type(png, info);
+	if(png_get_interlace_type(png, info) != PNG_INTERLACE_NONE)
+	{
+		png_error(png, "Interlaced png images can not be read row by row");
+	}
+
+	//convert any pixel format to 8-bit RGBA
+	if(color_type == PNG_COLOR_TYPE_PALETTE)
+		png_set_palette_to_rgb(png);
+	if(color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
+	{
+		png_set_expand_gray_1_2_4_to_8(png);
+		png_set_gray_to_rgb(png);
+	}
+	if(png_get_valid(png, info, PNG_INFO_tRNS))
+		png_set_tRNS_to_alpha(png);
+	png_set_strip_16(png);
+	png_set_filler(png, 0xFF, PNG_FILLER_AFTER);
+	png_read_update_info(png, info);
+
+	row = (jab_byte *)malloc(width * BITMAP_CHANNEL_COUNT * sizeof(jab_byte));
+	if(row == NULL)
+	{
+		png_error(png, "Memory allocation for png row failed");
+	}
+	jab_int32 y;
+	for(y=0; y<height; y++)
+	{
+		png_read_row(png, row, NULL);
+		if(!callback(y, row, width, user_data))
+			break;
+	}
+	//the end of the image is only checked if the callback did not stop reading
+	if(y == height)
+		png_read_end(png, NULL);
+
+	png_destroy_read_struct(&png, &info, NULL);
+	free(row);
+	return JAB_SUCCESS;
 }
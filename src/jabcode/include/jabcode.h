@@ -30,6 +30,8 @@
 #define DEFAULT_MODULE_COLOR_MODE 		2
 #define DEFAULT_ECC_LEVEL				3
 #define DEFAULT_MASKING_REFERENCE 		7
+#define DEFAULT_ENCODE_THREADS			4
+#define MAX_ENCODE_THREADS				64
 
 
 #define DISTANCE_TO_BORDER      4
@@ -40,6 +42,8 @@
 #define BITMAP_BITS_PER_CHANNEL	8
 #define BITMAP_CHANNEL_COUNT	4
 
+#define JAB_STATS_LDPC_BLOCKS	64		///< The number of LDPC sub-blocks whose iterations are recorded in the decoding stats
+
 #define	JAB_SUCCESS		1
 #define	JAB_FAILURE		0
 
@@ -111,12 +115,64 @@ typedef struct {
 	jab_int32		host;
 	jab_int32		slaves[4];
 	jab_int32 		wcwr[2];
-	jab_data*		data;
+	struct jab_bitstream* data;
 	jab_byte*		data_map;
 	jab_data*		metadata;
 	jab_byte*		matrix;
+	const struct jab_symbol_layout* layout;	///< The placement order of the data modules, kept with the matrix
 }jab_symbol;
 
+/**
+ * @brief Code matrix holding the color index of each module, to be rendered on demand
+*/
+typedef struct {
+	jab_int32		width;									///< The code width in modules
+	jab_int32		height;									///< The code height in modules
+	jab_int32		module_size;							///< The module size in pixel for rendering
+	jab_int32		color_number;
+	jab_byte		palette[MAX_COLOR_NUMBER * 3];			///< Palette holding used module colors in format RGB
+	jab_int32		symbol_number;
+	jab_vector2d	symbol_origins[MAX_SYMBOL_NUMBER];		///< The top-left module of each symbol
+	jab_vector2d	symbol_sizes[MAX_SYMBOL_NUMBER];		///< The side size of each symbol in modules
+	jab_byte		module[];								///< The color index of each module in row-major order, 0 outside the symbols
+}jab_code_matrix;
+
+/**
+ * @brief PNG compression options
+*/
+typedef struct {
+	jab_int32		level;					///< zlib compression level (0-9), -1 for the zlib default
+	jab_int32		strategy;				///< zlib compression strategy (0:default, 1:filtered, 2:huffman only, 3:RLE, 4:fixed)
+	jab_boolean		filter;					///< Set to apply adaptive row filters, otherwise rows are stored unfiltered
+}jab_png_options;
+
+/**
+ * @brief Per-stage timing and chosen parameters of an encoding, all times being wall times in milliseconds
+*/
+typedef struct {
+	jab_double		total_time;				///< The whole encoding, including rendering the code bitmap or matrix
+	jab_double		analyze_time;			///< Analyzing the input data for the optimal encoding modes
+	jab_double		encode_time;			///< Encoding the input data into the bit stream
+	jab_double		fit_time;				///< Selecting the symbol versions and fitting the data into the symbols
+	jab_double		ldpc_time;				///< LDPC encoding of the data in all symbols
+	jab_double		interleave_time;		///< Interleaving the data in all symbols
+	jab_double		matrix_time;			///< Placing the modules of all symbols
+	jab_double		mask_time;				///< Evaluating the mask patterns and masking the code
+	jab_double		bitmap_time;			///< Rendering the code bitmap, or the code matrix for generateJABCodeMatrix
+	jab_double		symbol_ldpc_time[MAX_SYMBOL_NUMBER];	///< LDPC encoding of the data in each symbol
+	jab_double		mask_times[NUMBER_OF_MASK_PATTERNS];	///< Evaluating each mask pattern, 0 in default mode
+	jab_int32		mask_scores[NUMBER_OF_MASK_PATTERNS];	///< The full penalty score of each mask pattern, -1 in default mode
+	jab_int32		mask_reference;			///< The chosen mask pattern
+	jab_int32		encoded_length;			///< The length of the encoded input data in bits
+	jab_int32		color_number;
+	jab_int32		symbol_number;
+	jab_vector2d	code_size;				///< The code size in modules
+	jab_vector2d	symbol_versions[MAX_SYMBOL_NUMBER];		///< The chosen side versions of each symbol
+	jab_byte		symbol_ecc_levels[MAX_SYMBOL_NUMBER];	///< The error correction level of each symbol, 0 if the code rate is adapted to the data, see symbol_wcwr
+	jab_int32		symbol_wcwr[MAX_SYMBOL_NUMBER][2];		///< The LDPC column and row weights of each symbol
+	jab_int32		symbol_capacity[MAX_SYMBOL_NUMBER];		///< The net payload of each symbol in bits, including the padding
+}jab_encode_stats;
+
 /**
  * @brief Encode parameters
 */
@@ -131,7 +187,14 @@ typedef struct {
 	jab_byte* 		symbol_ecc_levels;
 	jab_int32*		symbol_positions;
 	jab_symbol*		symbols;				///< Pointer to internal representation of JAB Code symbols
-	jab_bitmap*		bitmap;
+	jab_bitmap*		bitmap;					///< The code bitmap, reused by the next message of the same size
+	jab_boolean		auto_master_version;	///< Set if the master symbol version is selected for each message
+	jab_boolean		compiled;				///< Set once the symbol geometry, the code parameters and the modules not depending on the message are kept for the next messages, the encode parameters must not be changed afterwards
+	struct jab_code* code_para;				///< The code parameters of a compiled encode object
+	jab_code_matrix* code_matrix;			///< The code matrix, reused by the next message of the same size
+	jab_encode_stats* stats;				///< The stats filled by each encoding, NULL if not collected
+	jab_int32		mask_sample_modules;	///< If positive, the mask of a code with more modules is selected in a central window of about this many modules
+	jab_int32		mask_threads;			///< The maximal number of threads evaluating the mask patterns, 0 for the default
 }jab_encode;
 
 /**
@@ -159,18 +222,127 @@ typedef struct {
 	jab_metadata metadata;
 	jab_metadata slave_metadata[4];
 	jab_byte* palette;
-	jab_data* data;
+	struct jab_bitstream* data;
 }jab_decoded_symbol;
 
+/**
+ * @brief Per-stage timing and counters of a decoding, all times being wall times in milliseconds.
+ * The stage times of slave symbols decoded concurrently are summed over the decoding threads.
+*/
+typedef struct {
+	jab_double		total_time;				///< The whole decoding
+	jab_double		balance_time;			///< Color balancing
+	jab_double		binarize_time;			///< Binarization of the color channels, including the rebinarization retry
+	jab_double		detect_time;			///< The passes of the master symbol detection
+	jab_double		sample_time;			///< Symbol sampling
+	jab_double		palette_time;			///< Reading the color palettes
+	jab_double		module_time;			///< Reading the raw module data
+	jab_double		deinterleave_time;		///< Deinterleaving the symbol data
+	jab_double		ldpc_time;				///< LDPC decoding of the symbol data
+	jab_double		data_time;				///< Decoding the message from the symbol data
+	jab_int32		detect_passes;			///< The number of passes of the master symbol detection
+	jab_int32		finder_candidates;		///< The number of candidate finder patterns found in all passes
+	jab_int32		retries;				///< The number of rebinarizations and resamplings using alignment patterns
+	jab_int32		ldpc_blocks;			///< The number of LDPC sub-blocks, including those of the metadata
+	jab_int32		ldpc_iterations;		///< The total number of bit-flipping iterations in all sub-blocks
+	jab_int32		ldpc_block_iterations[JAB_STATS_LDPC_BLOCKS];	///< The iterations in the first sub-blocks, 0 if a sub-block is free of errors
+	jab_int64		bytes_allocated;		///< The bytes allocated on the heap by the decoding, i.e. for the decoder buffers, the scratch memory and the newly cached tables, 0 once a reused decoder holds all it needs
+}jab_decode_stats;
+
+/**
+ * @brief Pixel formats of bitmap views
+*/
+typedef enum
+{
+	JAB_PIXEL_RGBA = 0,
+	JAB_PIXEL_BGRA,
+	JAB_PIXEL_RGB,
+	JAB_PIXEL_BGR
+}jab_pixel_format;
+
+/**
+ * @brief View of a caller-owned image buffer
+*/
+typedef struct {
+	jab_int32		width;
+	jab_int32		height;
+	jab_int32		stride;					///< The number of bytes from one row to the next
+	jab_pixel_format format;
+	const jab_byte*	pixels;					///< The first pixel of the top row
+}jab_bitmap_view;
+
+/**
+ * @brief Planar YUV formats of camera and video frames
+*/
+typedef enum
+{
+	JAB_YUV_NV12 = 0,						///< Y plane followed by an interleaved UV plane
+	JAB_YUV_NV21,							///< Y plane followed by an interleaved VU plane
+	JAB_YUV_I420							///< Y, U and V planes
+}jab_yuv_format;
+
+/**
+ * @brief View of a caller-owned planar YUV frame with 2x2 subsampled chroma
+*/
+typedef struct {
+	jab_int32		width;
+	jab_int32		height;
+	jab_yuv_format	format;
+	jab_boolean		video_range;			///< Set if luma spans 16-235 and chroma 16-240, as in BT.601 video
+	const jab_byte*	planes[3];				///< The Y plane, the U or interleaved chroma plane, and the V plane for I420
+	jab_int32		strides[3];				///< The number of bytes from one row to the next in each plane
+}jab_yuv_view;
+
+/**
+ * @brief Reusable decoder
+*/
+typedef struct jab_decoder jab_decoder;
+
+/**
+ * @brief Callback receiving each code generated in a batch
+ * @param index the index of the input data in the batch
+ * @param status the return value of generateJABCode or generateJABCodeMatrix for this input data
+ * @param enc the encode object holding the generated code, only valid until the callback returns
+ * @param user_data the user data passed to generateJABCodeBatch
+ * @return JAB_SUCCESS to continue | JAB_FAILURE to stop the batch
+*/
+typedef jab_boolean (*jab_encode_callback)(jab_int32 index, jab_int32 status, jab_encode* enc, void* user_data);
+
+/**
+ * @brief Callback receiving each row of an image read row by row
+ * @param row the row index
+ * @param pixels the pixels of the row in RGBA, only valid until the callback returns
+ * @param width the number of pixels in the row
+ * @param user_data the user data passed to readImageRows
+ * @return JAB_SUCCESS to continue | JAB_FAILURE to stop reading, which readImageRows does not report as an error
+*/
+typedef jab_boolean (*jab_image_row_callback)(jab_int32 row, const jab_byte* pixels, jab_int32 width, void* user_data);
+
 
 extern jab_encode* createEncode(jab_int32 color_number, jab_int32 symbol_number);
 extern void destroyEncode(jab_encode* enc);
 extern jab_int32 generateJABCode(jab_encode* enc, jab_data* data);
+extern jab_int32 generateJABCodeMatrix(jab_encode* enc, jab_data* data);
+extern jab_bitmap* renderJABCodeMatrix(const jab_code_matrix* matrix);
+extern jab_int32 generateJABCodeBatch(jab_encode* enc, jab_data** data, jab_int32 data_number, jab_int32 thread_number, jab_encode_callback callback, void* user_data, jab_double* codes_per_second);
+extern jab_int32 generateJABCodeMatrixBatch(jab_encode* enc, jab_data** data, jab_int32 data_number, jab_int32 thread_number, jab_encode_callback callback, void* user_data, jab_double* codes_per_second);
 extern jab_data* decodeJABCode(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status);
 extern jab_data* decodeJABCodeEx(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number);
+extern jab_decoder* createDecoder(void);
+extern void destroyDecoder(jab_decoder* dec);
+extern jab_data* decodeJABCodeWithDecoder(jab_decoder* dec, jab_bitmap* bitmap, jab_int32 mode, jab_int32* status);
+extern jab_data* decodeJABCodeView(jab_decoder* dec, const jab_bitmap_view* view, jab_int32 mode, jab_int32* status);
+extern jab_data* decodeJABCodeYUV(jab_decoder* dec, const jab_yuv_view* yuv, jab_int32 mode, jab_int32* status);
+extern jab_int32 getDecodedSymbolNumber(const jab_decoder* dec);
+extern void setDecoderStats(jab_decoder* dec, jab_decode_stats* stats);
+extern void setDecoderSlaveThreads(jab_decoder* dec, jab_int32 thread_number);
 extern jab_boolean saveImage(jab_bitmap* bitmap, jab_char* filename);
+extern jab_boolean saveImagePalette(const jab_code_matrix* matrix, const jab_png_options* options, jab_char* filename);
 extern jab_boolean saveImageCMYK(jab_bitmap* bitmap, jab_boolean isCMYK, jab_char* filename);
+extern jab_boolean saveImageCMYKFromMatrix(const jab_code_matrix* matrix, jab_char* filename);
 extern jab_bitmap* readImage(jab_char* filename);
+extern jab_bitmap* readImageFromMemory(const jab_byte* buffer, jab_int32 size);
+extern jab_boolean readImageRows(const jab_byte* buffer, jab_int32 size, jab_image_row_callback callback, void* user_data);
 extern void reportError(jab_char* message);
 
 #endif
@@ -15,63 +15,138 @@
 #include <string.h>
 #include "jabcode.h"
 #include "encoder.h"
+#include "decoder.h"
+#include "detector.h"
+#include "bitstream.h"
+#include "cache.h"
 #include "pseudo_random.h"
 
 #define INTERLEAVE_SEED 226759
+#define MAX_CACHED_PERMUTATIONS	16	//the maximal number of cached interleaving permutations
 
 /**
- * @brief In-place interleaving
+ * @brief Interleaving permutation, which only depends on the data length
+*/
+typedef struct {
+	jab_cache_entry	entry;			//the cache entry, which must be the first member
+	jab_int32		length;
+	jab_int32		index[];		//the source position of each interleaved bit
+}jab_permutation;
+
+/**
+ * @brief Check if a cached permutation has the length of a key permutation
+ * @param entry the cached permutation
+ * @param key the permutation holding only the length
+ * @return JAB_SUCCESS if matched | JAB_FAILURE
+*/
+jab_boolean matchPermutation(const jab_cache_entry* entry, const void* key)
+{
+	return ((const jab_permutation*)entry)->length == ((const jab_permutation*)key)->length;
+}
+
+/**
+ * @brief Create the permutation of a key permutation for the cache
+ * @param key the permutation holding only the length
+ * @return the cache entry of the permutation | NULL if failed
+*/
+jab_cache_entry* createPermutation(const void* key)
+{
+	jab_int32 length = ((const jab_permutation*)key)->length;
+	jab_permutation* perm = (jab_permutation*)calloc(1, sizeof(jab_permutation) + length*sizeof(jab_int32));
+	if(perm == NULL)
+	{
+		reportError("Memory allocation for interleaving permutation failed");
+		return NULL;
+	}
+	DECODE_STATS_ADD(bytes_allocated, (jab_int64)(sizeof(jab_permutation) + length*sizeof(jab_int32)))
+	perm->length = length;
+	for(jab_int32 i=0; i<length; i++)
+	{
+		perm->index[i] = i;
+	}
+	//apply the swaps of the interleaver to the positions
+	uint64_t seed = INTERLEAVE_SEED;
+	for(jab_int32 i=0; i<length; i++)
+	{
+		jab_int32 pos = (jab_int32)( (jab_float)lcg64_temper(&seed) / (jab_float)UINT32_MAX * (length - i) );
+		jab_int32 tmp = perm->index[length - 1 - i];
+		perm->index[length - 1 -i] = perm->index[pos];
+		perm->index[pos] = tmp;
+	}
+	return (jab_cache_entry*)perm;
+}
+
+/**
+ * @brief Free a permutation evicted from or not taken by the cache
+ * @param entry the cache entry of the permutation
+*/
+void destroyPermutation(jab_cache_entry* entry)
+{
+	free(entry);
+}
+
+static jab_cache permutation_cache = JAB_CACHE_INITIALIZER(MAX_CACHED_PERMUTATIONS, matchPermutation, createPermutation, destroyPermutation);
+
+/**
+ * @brief Get the interleaving permutation from the cache, or create it if not cached yet
+ * @param length the data length
+ * @return the immutable permutation, to be released by releaseCacheEntry | NULL if failed
+*/
+const jab_permutation* getPermutation(jab_int32 length)
+{
+	jab_permutation key;
+	memset(&key, 0, sizeof(key));
+	key.length = length;
+	return (const jab_permutation*)getCacheEntry(&permutation_cache, &key);
+}
+
+/**
+ * @brief Free all cached interleaving permutations
+ * @note No permutation obtained from the cache may be in use
+*/
+void clearPermutationCache(void)
+{
+	clearCache(&permutation_cache);
+}
+
+/**
+ * @brief Interleaving
  * @param data the input data to be interleaved
+ * @param interleaved the interleaved data, of the same length as the input data
+ * @return JAB_SUCCESS | JAB_FAILURE
 */
-void interleaveData(jab_data* data)
+jab_boolean interleaveData(const jab_bitstream* data, jab_bitstream* interleaved)
 {
-    setSeed(INTERLEAVE_SEED);
-    for (jab_int32 i=0; i<data->length; i++)
-    {
-        jab_int32 pos = (jab_int32)( (jab_float)lcg64_temper() / (jab_float)UINT32_MAX * (data->length - i) );
-        jab_char  tmp = data->data[data->length - 1 -i];
-        data->data[data->length - 1 - i] = data->data[pos];
-        data->data[pos] = tmp;
-    }
+	const jab_permutation* perm = getPermutation(data->length);
+	if(perm == NULL)
+	{
+		return JAB_FAILURE;
+	}
+	for(jab_int32 i=0; i<data->length; i++)
+	{
+		PUT_BIT(interleaved, i, GET_BIT(data, perm->index[i]));
+	}
+	releaseCacheEntry(&permutation_cache, (const jab_cache_entry*)perm);
+	return JAB_SUCCESS;
 }
 
 /**
- * @brief In-place deinterleaving
+ * @brief Deinterleaving
  * @param data the input data to be deinterleaved
+ * @param deinterleaved the deinterleaved data, of the same length as the input data
+ * @return JAB_SUCCESS | JAB_FAILURE
 */
-void deinterleaveData(jab_data* data)
+jab_boolean deinterleaveData(const jab_bitstream* data, jab_bitstream* deinterleaved)
 {
-    jab_int32 * index = (jab_int32 *)malloc(data->length * sizeof(jab_int32));
-    if(index == NULL)
-    {
-        reportError("Memory allocation for index buffer in deinterleaver failed");
-        return;
-    }
-    for(jab_int32 i=0; i<data->length; i++)
-    {
-		index[i] = i;
-    }
-    //interleave index
-    setSeed(INTERLEAVE_SEED);
-    for(jab_int32 i=0; i<data->length; i++)
-    {
-		jab_int32 pos = (jab_int32)( (jab_float)lcg64_temper() / (jab_float)UINT32_MAX * (data->length - i) );
-		jab_int32 tmp = index[data->length - 1 - i];
-		index[data->length - 1 -i] = index[pos];
-		index[pos] = tmp;
-    }
-    //deinterleave data
-    jab_char* tmp_data = (jab_char *)malloc(data->length * sizeof(jab_char));
-    if(tmp_data == NULL)
-    {
-        reportError("Memory allocation for temporary buffer in deinterleaver failed");
-        return;
-    }
-	memcpy(tmp_data, data->data, data->length*sizeof(jab_char));
+	const jab_permutation* perm = getPermutation(data->length);
+	if(perm == NULL)
+	{
+		return JAB_FAILURE;
+	}
 	for(jab_int32 i=0; i<data->length; i++)
-    {
-        data->data[index[i]] = tmp_data[i];
-    }
-    free(tmp_data);
-    free(index);
+	{
+		PUT_BIT(deinterleaved, perm->index[i], GET_BIT(data, i));
+	}
+	releaseCacheEntry(&permutation_cache, (const jab_cache_entry*)perm);
+	return JAB_SUCCESS;
 }
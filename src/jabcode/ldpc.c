@@ -18,6 +18,8 @@
 #include <string.h>
 #include <stdio.h>
 #include "detector.h"
+#include "bitstream.h"
+#include "scratch.h"
 #include "pseudo_random.h"
 
 /**
@@ -51,6 +53,7 @@ jab_int32 *createMatrixA(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
         free(matrixA);
         return NULL;
     }
+    DECODE_STATS_ADD(bytes_allocated, (jab_int64)((offset*nb_pcb + capacity) * sizeof(jab_int32)))
     for (jab_int32 i=0;i<capacity;i++)
         permutation[i]=i;
 
@@ -62,13 +65,13 @@ jab_int32 *createMatrixA(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
     }
     //Permutate the columns and fill the remaining matrix
     //generate matrixA by following Gallagers algorithm
-    setSeed(LPDC_MESSAGE_SEED);
+    uint64_t seed = LPDC_MESSAGE_SEED;
     for (jab_int32 i=1; i<wc; i++)
     {
         jab_int32 off_index=i*(capacity/wr);
         for (jab_int32 j=0;j<capacity;j++)
         {
-            jab_int32 pos = (jab_int32)( (jab_float)lcg64_temper() / (jab_float)UINT32_MAX * (capacity - j) );
+            jab_int32 pos = (jab_int32)( (jab_float)lcg64_temper(&seed) / (jab_float)UINT32_MAX * (capacity - j) );
             for (jab_int32 k=0;k<capacity/wr;k++)
                 matrixA[(off_index+k)*offset+j/32] |= ((matrixA[(permutation[pos]/32+k*offset)] >> (31-permutation[pos]%32)) & 1) << (31-j%32);
             jab_int32  tmp = permutation[capacity - 1 -j];
@@ -143,6 +146,7 @@ jab_int32 GaussJordan(jab_int32* matrixA, jab_int32 wc, jab_int32 wr, jab_int32
         free(zero_lines_nb);
         return 1;
     }
+    DECODE_STATS_ADD(bytes_allocated, (jab_int64)((offset*nb_pcb + 3*capacity + nb_pcb) * sizeof(jab_int32) + capacity * sizeof(jab_boolean)))
 
     jab_int32 zero_lines=0;
 
@@ -303,9 +307,10 @@ jab_int32 *createMetadataMatrixA(jab_int32 wc, jab_int32 capacity)
         free(matrixA);
         return NULL;
     }
+    DECODE_STATS_ADD(bytes_allocated, (jab_int64)((offset*nb_pcb + capacity) * sizeof(jab_int32)))
     for (jab_int32 i=0;i<capacity;i++)
         permutation[i]=i;
-    setSeed(LPDC_METADATA_SEED);
+    uint64_t seed = LPDC_METADATA_SEED;
     jab_int32 nb_once=capacity*nb_pcb/(jab_float)wc+3;
     nb_once=nb_once/nb_pcb;
     //Fill matrix randomly
@@ -313,7 +318,7 @@ jab_int32 *createMetadataMatrixA(jab_int32 wc, jab_int32 capacity)
     {
         for (jab_int32 j=0; j< nb_once; j++)
         {
-            jab_int32 pos = (jab_int32)( (jab_float)lcg64_temper() / (jab_float)UINT32_MAX * (capacity-j) );
+            jab_int32 pos = (jab_int32)( (jab_float)lcg64_temper(&seed) / (jab_float)UINT32_MAX * (capacity-j) );
             matrixA[i*offset+permutation[pos]/32] |= 1 << (31-permutation[pos]%32);
             jab_int32  tmp = permutation[capacity - 1 -j];
             permutation[capacity - 1 -j] = permutation[pos];
@@ -370,13 +375,272 @@ jab_int32 *createGeneratorMatrix(jab_int32* matrixA, jab_int32 capacity, jab_int
     return G;
 }
 
+/**
+ * @brief Create the generator matrix for a block length
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row, not positive for metadata
+ * @param capacity the block length
+ * @return the generator matrix | NULL if failed
+*/
+jab_generator_matrix* createGenerator(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
+{
+    jab_generator_matrix* gm = (jab_generator_matrix*)calloc(1, sizeof(jab_generator_matrix));
+    if(gm == NULL)
+    {
+        reportError("Memory allocation for generator matrix failed");
+        return NULL;
+    }
+    gm->wc = wc;
+    gm->wr = wr;
+    gm->capacity = capacity;
+    //Matrix A
+    jab_int32* matrixA;
+    if(wr > 0)
+        matrixA = createMatrixA(wc, wr, capacity);
+    else
+        matrixA = createMetadataMatrixA(wc, capacity);
+    if(matrixA == NULL)
+    {
+        reportError("Generator matrix could not be created in LDPC encoder.");
+        free(gm);
+        return NULL;
+    }
+    jab_boolean encode=1;
+    if(GaussJordan(matrixA, wc, wr, capacity, &gm->rank, encode))
+    {
+        reportError("Gauss Jordan Elimination in LDPC encoder failed.");
+        free(matrixA);
+        free(gm);
+        return NULL;
+    }
+    //Generator Matrix
+    gm->G = createGeneratorMatrix(matrixA, capacity, capacity - gm->rank);
+    free(matrixA);
+    if(gm->G == NULL)
+    {
+        reportError("Generator matrix could not be created in LDPC encoder.");
+        free(gm);
+        return NULL;
+    }
+    return gm;
+}
+
+/**
+ * @brief Free a generator matrix
+ * @param gm the generator matrix
+*/
+void freeGenerator(jab_generator_matrix* gm)
+{
+    if(gm == NULL) return;
+    free(gm->G);
+    free(gm);
+}
+
+/**
+ * @brief Check if a cached generator matrix has the parameters of a key matrix
+ * @param entry the cached matrix
+ * @param key the matrix holding only the parameters
+ * @return JAB_SUCCESS if matched | JAB_FAILURE
+*/
+jab_boolean matchGenerator(const jab_cache_entry* entry, const void* key)
+{
+    const jab_generator_matrix* gm = (const jab_generator_matrix*)entry;
+    const jab_generator_matrix* params = (const jab_generator_matrix*)key;
+    return gm->wc == params->wc && gm->wr == params->wr && gm->capacity == params->capacity;
+}
+
+/**
+ * @brief Create the generator matrix of a key matrix for the cache
+ * @param key the matrix holding only the parameters
+ * @return the cache entry of the matrix | NULL if failed
+*/
+jab_cache_entry* createCachedGenerator(const void* key)
+{
+    const jab_generator_matrix* params = (const jab_generator_matrix*)key;
+    return (jab_cache_entry*)createGenerator(params->wc, params->wr, params->capacity);
+}
+
+/**
+ * @brief Free a generator matrix evicted from or not taken by the cache
+ * @param entry the cache entry of the matrix
+*/
+void destroyCachedGenerator(jab_cache_entry* entry)
+{
+    freeGenerator((jab_generator_matrix*)entry);
+}
+
+static jab_cache generator_cache = JAB_CACHE_INITIALIZER(MAX_CACHED_GENERATOR_MATRICES, matchGenerator, createCachedGenerator, destroyCachedGenerator);
+
+/**
+ * @brief Get the generator matrix from the cache, or create it if not cached yet
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row, not positive for metadata
+ * @param capacity the block length
+ * @return the immutable generator matrix, to be released by releaseGeneratorMatrix | NULL if failed
+*/
+const jab_generator_matrix* getGeneratorMatrix(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
+{
+    jab_generator_matrix key;
+    memset(&key, 0, sizeof(key));
+    key.wc = wc;
+    key.wr = wr;
+    key.capacity = capacity;
+    return (const jab_generator_matrix*)getCacheEntry(&generator_cache, &key);
+}
+
+/**
+ * @brief Release a generator matrix obtained from getGeneratorMatrix
+ * @param gm the generator matrix
+*/
+void releaseGeneratorMatrix(const jab_generator_matrix* gm)
+{
+    releaseCacheEntry(&generator_cache, (const jab_cache_entry*)gm);
+}
+
+/**
+ * @brief Free all cached generator matrices
+ * @note No matrix obtained from the cache may be in use
+*/
+void clearGeneratorMatrixCache(void)
+{
+    clearCache(&generator_cache);
+}
+
+/**
+ * @brief Create the reduced parity check matrix for a block length
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row, not positive for metadata
+ * @param capacity the block length
+ * @return the parity check matrix | NULL if failed
+*/
+jab_parity_check_matrix* createParityCheckMatrix(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
+{
+    jab_parity_check_matrix* pcm = (jab_parity_check_matrix*)calloc(1, sizeof(jab_parity_check_matrix));
+    if(pcm == NULL)
+    {
+        reportError("Memory allocation for parity check matrix failed");
+        return NULL;
+    }
+    DECODE_STATS_ADD(bytes_allocated, (jab_int64)sizeof(jab_parity_check_matrix))
+    pcm->wc = wc;
+    pcm->wr = wr;
+    pcm->capacity = capacity;
+    if(wr > 0)
+        pcm->H = createMatrixA(wc, wr, capacity);
+    else
+        pcm->H = createMetadataMatrixA(wc, capacity);
+    if(pcm->H == NULL)
+    {
+        reportError("LDPC matrix could not be created in decoder.");
+        free(pcm);
+        return NULL;
+    }
+    jab_boolean encode=0;
+    if(GaussJordan(pcm->H, wc, wr, capacity, &pcm->rank, encode))
+    {
+        reportError("Gauss Jordan Elimination in LDPC encoder failed.");
+        free(pcm->H);
+        free(pcm);
+        return NULL;
+    }
+    return pcm;
+}
+
+/**
+ * @brief Check if a cached parity check matrix has the parameters of a key matrix
+ * @param entry the cached matrix
+ * @param key the matrix holding only the parameters
+ * @return JAB_SUCCESS if matched | JAB_FAILURE
+*/
+jab_boolean matchParityCheckMatrix(const jab_cache_entry* entry, const void* key)
+{
+    const jab_parity_check_matrix* pcm = (const jab_parity_check_matrix*)entry;
+    const jab_parity_check_matrix* params = (const jab_parity_check_matrix*)key;
+    return pcm->wc == params->wc && pcm->wr == params->wr && pcm->capacity == params->capacity;
+}
+
+/**
+ * @brief Create the parity check matrix of a key matrix for the cache
+ * @param key the matrix holding only the parameters
+ * @return the cache entry of the matrix | NULL if failed
+*/
+jab_cache_entry* createCachedParityCheckMatrix(const void* key)
+{
+    const jab_parity_check_matrix* params = (const jab_parity_check_matrix*)key;
+    return (jab_cache_entry*)createParityCheckMatrix(params->wc, params->wr, params->capacity);
+}
+
+/**
+ * @brief Free a parity check matrix evicted from or not taken by the cache
+ * @param entry the cache entry of the matrix
+*/
+void destroyCachedParityCheckMatrix(jab_cache_entry* entry)
+{
+    jab_parity_check_matrix* pcm = (jab_parity_check_matrix*)entry;
+    free(pcm->H);
+    free(pcm);
+}
+
+static jab_cache parity_check_cache = JAB_CACHE_INITIALIZER(MAX_CACHED_PARITY_CHECK_MATRICES, matchParityCheckMatrix, createCachedParityCheckMatrix, destroyCachedParityCheckMatrix);
+
+/**
+ * @brief Get the reduced parity check matrix from the cache, or create it if not cached yet
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row, not positive for metadata
+ * @param capacity the block length
+ * @return the immutable parity check matrix, to be released by releaseParityCheckMatrix | NULL if failed
+*/
+const jab_parity_check_matrix* getParityCheckMatrix(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
+{
+    jab_parity_check_matrix key;
+    memset(&key, 0, sizeof(key));
+    key.wc = wc;
+    key.wr = wr;
+    key.capacity = capacity;
+    return (const jab_parity_check_matrix*)getCacheEntry(&parity_check_cache, &key);
+}
+
+/**
+ * @brief Release a parity check matrix obtained from getParityCheckMatrix
+ * @param pcm the parity check matrix
+*/
+void releaseParityCheckMatrix(const jab_parity_check_matrix* pcm)
+{
+    releaseCacheEntry(&parity_check_cache, (const jab_cache_entry*)pcm);
+}
+
+/**
+ * @brief Free all cached parity check matrices
+ * @note No matrix obtained from the cache may be in use
+*/
+void clearParityCheckMatrixCache(void)
+{
+    clearCache(&parity_check_cache);
+}
+
+/**
+ * @brief Get the parity of the bits selected by a matrix row
+ * @param row the matrix row
+ * @param data the bit sequence
+ * @param start the position of the first bit in the sequence
+ * @param length the number of bits
+ * @return the parity
+*/
+jab_int32 getRowParity(const jab_int32* row, const jab_bitstream* data, jab_int32 start, jab_int32 length)
+{
+    jab_uint32 sum = 0;
+    for(jab_int32 i=0; i<length; i+=32)
+        sum ^= (jab_uint32)row[i/32] & readWord(data, start+i, MIN(32, length-i));
+    return getWordParity(sum);
+}
+
 /**
  * @brief LDPC encoding
  * @param data the data to be encoded
  * @param coderate_params the two code rate parameter wc and wr indicating how many '1' in a column (Wc) and how many '1' in a row of the parity check matrix
  * @return the encoded data | NULL if failed
 */
-jab_data *encodeLDPC(jab_data* data, jab_int32* coderate_params)
+jab_bitstream *encodeLDPC(const jab_bitstream* data, jab_int32* coderate_params)
 {
     jab_int32 matrix_rank=0;
     jab_int32 wc, wr, Pg, Pn;       //number of '1' in column //number of '1' in row //gross message length //number of parity check symbols //calculate required parameters
@@ -420,140 +684,92 @@ jab_data *encodeLDPC(jab_data* data, jab_int32* coderate_params)
     jab_int32 encoding_iterations=nb_sub_blocks=Pg / Pg_sub_block;//nb_sub_blocks;
     if(Pn_sub_block * nb_sub_blocks < Pn)
         encoding_iterations--;
-    jab_int32* matrixA;
-    //Matrix A
-    if(wr > 0)
-        matrixA = createMatrixA(wc, wr, Pg_sub_block);
-    else
-        matrixA = createMetadataMatrixA(wc, Pg_sub_block);
-    if(matrixA == NULL)
+    //the generator matrices only depend on the block parameters and are shared between calls
+    const jab_generator_matrix* gm = getGeneratorMatrix(wc, wr, Pg_sub_block);
+    if(gm == NULL)
     {
-        reportError("Generator matrix could not be created in LDPC encoder.");
         return NULL;
     }
-    jab_boolean encode=1;
-    if(GaussJordan(matrixA, wc, wr, Pg_sub_block, &matrix_rank,encode))
-    {
-        reportError("Gauss Jordan Elimination in LDPC encoder failed.");
-        free(matrixA);
-        return NULL;
-    }
-    //Generator Matrix
-    jab_int32* G = createGeneratorMatrix(matrixA, Pg_sub_block, Pg_sub_block - matrix_rank);
-    if(G == NULL)
-    {
-        reportError("Generator matrix could not be created in LDPC encoder.");
-        free(matrixA);
-        return NULL;
-    }
-    free(matrixA);
+    jab_int32* G = gm->G;
+    matrix_rank = gm->rank;
 
-    jab_data* ecc_encoded_data = (jab_data *)malloc(sizeof(jab_data) + Pg*sizeof(jab_char));
+    jab_bitstream* ecc_encoded_data = createBitstream(Pg);
     if(ecc_encoded_data == NULL)
     {
-        reportError("Memory allocation for LDPC encoded data failed");
-        free(G);
+        releaseGeneratorMatrix(gm);
         return NULL;
     }
 
-    ecc_encoded_data->length = Pg;
-    jab_int32 temp,loop;
     jab_int32 offset=ceil((Pg_sub_block - matrix_rank)/(jab_float)32);
     //G * message = ecc_encoded_Data
     for(jab_int32 iter=0; iter < encoding_iterations; iter++)
     {
         for (jab_int32 i=0;i<Pg_sub_block;i++)
         {
-            temp=0;
-            loop=0;
-            jab_int32 offset_index=offset*i;
-            for (jab_int32 j=iter*Pn_sub_block; j < (iter+1)*Pn_sub_block; j++)
-            {
-                temp ^= (((G[offset_index + loop/32] >> (31-loop%32)) & 1) & ((data->data[j] >> 0) & 1)) << 0;
-                loop++;
-            }
-            ecc_encoded_data->data[i+iter*Pg_sub_block]=(jab_char) ((temp >> 0) & 1);
+            if(getRowParity(G + offset*i, data, iter*Pn_sub_block, Pn_sub_block))
+                SET_BIT(ecc_encoded_data, i+iter*Pg_sub_block);
         }
     }
-    free(G);
+    releaseGeneratorMatrix(gm);
     if(encoding_iterations != nb_sub_blocks)
     {
         jab_int32 start=encoding_iterations*Pn_sub_block;
         jab_int32 last_index=encoding_iterations*Pg_sub_block;
-        matrix_rank=0;
         Pg_sub_block=Pg - encoding_iterations * Pg_sub_block;
         Pn_sub_block=Pg_sub_block * (wr-wc) / wr;
-        jab_int32* matrixA = createMatrixA(wc, wr, Pg_sub_block);
-        if(matrixA == NULL)
+        gm = getGeneratorMatrix(wc, wr, Pg_sub_block);
+        if(gm == NULL)
         {
-            reportError("Generator matrix could not be created in LDPC encoder.");
+            free(ecc_encoded_data);
             return NULL;
         }
-        if(GaussJordan(matrixA, wc, wr, Pg_sub_block, &matrix_rank,encode))
-        {
-            reportError("Gauss Jordan Elimination in LDPC encoder failed.");
-            free(matrixA);
-            return NULL;
-        }
-        jab_int32* G = createGeneratorMatrix(matrixA, Pg_sub_block, Pg_sub_block - matrix_rank);
-        if(G == NULL)
-        {
-            reportError("Generator matrix could not be created in LDPC encoder.");
-            free(matrixA);
-            return NULL;
-        }
-        free(matrixA);
+        G = gm->G;
+        matrix_rank = gm->rank;
         offset=ceil((Pg_sub_block - matrix_rank)/(jab_float)32);
         for (jab_int32 i=0;i<Pg_sub_block;i++)
         {
-            temp=0;
-            loop=0;
-            jab_int32 offset_index=offset*i;
-            for (jab_int32 j=start; j < data->length; j++)
-            {
-                temp ^= (((G[offset_index + loop/32] >> (31-loop%32)) & 1) & ((data->data[j] >> 0) & 1)) << 0;
-                loop++;
-            }
-            ecc_encoded_data->data[i+last_index]=(jab_char) ((temp >> 0) & 1);
+            if(getRowParity(G + offset*i, data, start, data->length - start))
+                SET_BIT(ecc_encoded_data, i+last_index);
         }
-        free(G);
+        releaseGeneratorMatrix(gm);
     }
     return ecc_encoded_data;
 }
 
 /**
  * @brief Iterative hard decision error correction decoder
- * @param data the received data
+ * @param data the received bits
  * @param matrix the parity check matrix
  * @param length the encoded data length
  * @param height the number of check bits
  * @param max_iter the maximal number of iterations
  * @param is_correct indicating if decodedMessage function could correct all errors
  * @param start_pos indicating the position to start reading in data array
+ * @param iterations the number of iterations, incremented by each iteration
  * @return 1: error correction succeeded | 0: fatal error (out of memory)
 */
-jab_int32 decodeMessage(jab_byte* data, jab_int32* matrix, jab_int32 length, jab_int32 height, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos)
+jab_int32 decodeMessage(jab_bitstream* data, const jab_int32* matrix, jab_int32 length, jab_int32 height, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_int32* iterations)
 {
-    jab_int32* max_val=(jab_int32 *)calloc(length, sizeof(jab_int32));
+    jab_int32* max_val=(jab_int32 *)scratchCalloc(length, sizeof(jab_int32));
     if(max_val == NULL)
     {
         reportError("Memory allocation for LDPC decoder failed");
 
         return 0;
     }
-    jab_int32* equal_max=(jab_int32 *)calloc(length, sizeof(jab_int32));
+    jab_int32* equal_max=(jab_int32 *)scratchCalloc(length, sizeof(jab_int32));
     if(equal_max == NULL)
     {
         reportError("Memory allocation for LDPC decoder failed");
-        free(max_val);
+        scratchFree(max_val);
         return 0;
     }
-    jab_int32* prev_index=(jab_int32 *)calloc(length, sizeof(jab_int32));
+    jab_int32* prev_index=(jab_int32 *)scratchCalloc(length, sizeof(jab_int32));
     if(prev_index == NULL)
     {
         reportError("Memory allocation for LDPC decoder failed");
-        free(max_val);
-        free(equal_max);
+        scratchFree(max_val);
+        scratchFree(equal_max);
         return 0;
     }
 
@@ -565,16 +781,11 @@ jab_int32 decodeMessage(jab_byte* data, jab_int32* matrix, jab_int32 length, jab
 
     for (jab_int32 kl=0;kl<max_iter;kl++)
     {
+        (*iterations)++;
         max=0;
         for(jab_int32 j=0;j<height;j++)
         {
-            check=0;
-            for (jab_int32 i=0;i<length;i++)
-            {
-                if(((matrix[j*offset+i/32] >> (31-i%32)) & 1) & ((data[start_pos+i] >> 0) & 1))
-                    check+=1;
-            }
-            check=check%2;
+            check=getRowParity(matrix+j*offset, data, start_pos, length);
             if(check)
             {
                 for(jab_int32 k=0;k<length;k++)
@@ -612,14 +823,14 @@ jab_int32 decodeMessage(jab_byte* data, jab_int32* matrix, jab_int32 length, jab
             {
                 jab_int32 rand_tmp=(jab_int32)(rand()/(jab_float)UINT32_MAX * counter);
                 prev_index[0]=start_pos+equal_max[rand_tmp];
-                data[start_pos+equal_max[rand_tmp]]=(data[start_pos+equal_max[rand_tmp]]+1)%2;
+                FLIP_BIT(data, start_pos+equal_max[rand_tmp]);
             }
             else
             {
                 for(jab_int32 j=0; j< counter;j++)
                 {
                     prev_index[j]=start_pos+equal_max[j];
-                    data[start_pos+equal_max[j]]=(data[start_pos+equal_max[j]]+1)%2;
+                    FLIP_BIT(data, start_pos+equal_max[j]);
                 }
             }
             prev_count=counter;
@@ -636,21 +847,21 @@ jab_int32 decodeMessage(jab_byte* data, jab_int32* matrix, jab_int32 length, jab
 #if TEST_MODE
     JAB_REPORT_INFO(("start position:%d, stop position:%d, correct:%d", start_pos, start_pos+length,(jab_int32)*is_correct))
 #endif
-    free(prev_index);
-    free(equal_max);
-    free(max_val);
+    scratchFree(prev_index);
+    scratchFree(equal_max);
+    scratchFree(max_val);
     return 1;
 }
 
 /**
- * @brief LDPC decoding to perform hard decision
- * @param data the encoded data
+ * @brief LDPC decoding to perform hard decision, the decoded bits are placed at the beginning of the sequence
+ * @param data the encoded bits
  * @param length the encoded data length
  * @param wc the number of '1's in a column
  * @param wr the number of '1's in a row
  * @return the decoded data length | 0: fatal error (out of memory)
 */
-jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32 wr)
+jab_int32 decodeLDPChd(jab_bitstream* data, jab_int32 length, jab_int32 wc, jab_int32 wr)
 {
     jab_int32 matrix_rank=0;
     jab_int32 max_iter=25;
@@ -696,57 +907,39 @@ jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32
     if(Pn_sub_block * nb_sub_blocks < Pn)
         decoding_iterations--;
 
-    //parity check matrix
-    jab_int32* matrixA;
-    if(wr > 0)
-        matrixA = createMatrixA(wc, wr,Pg_sub_block);
-    else
-        matrixA = createMetadataMatrixA(wc, Pg_sub_block);
-    if(matrixA == NULL)
-    {
-        reportError("LDPC matrix could not be created in decoder.");
-        return 0;
-    }
-    jab_boolean encode=0;
-    if(GaussJordan(matrixA, wc, wr, Pg_sub_block, &matrix_rank,encode))
+    //the parity check matrices only depend on the block parameters and are shared between calls
+    const jab_parity_check_matrix* pcm = getParityCheckMatrix(wc, wr, Pg_sub_block);
+    if(pcm == NULL)
     {
-        reportError("Gauss Jordan Elimination in LDPC encoder failed.");
-        free(matrixA);
         return 0;
     }
+    const jab_int32* matrixA = pcm->H;
+    matrix_rank = pcm->rank;
 
     jab_int32 old_Pg_sub=Pg_sub_block;
     jab_int32 old_Pn_sub=Pn_sub_block;
     for (jab_int32 iter = 0; iter < nb_sub_blocks; iter++)
     {
+        jab_int32 iterations = 0;	//the bit-flipping iterations in this sub-block
         if(decoding_iterations != nb_sub_blocks && iter == decoding_iterations)
         {
-            matrix_rank=0;
             Pg_sub_block=Pg - decoding_iterations * Pg_sub_block;
             Pn_sub_block=Pg_sub_block * (wr-wc) / wr;
-            jab_int32* matrixA1 = createMatrixA(wc, wr, Pg_sub_block);
-            if(matrixA1 == NULL)
-            {
-                reportError("LDPC matrix could not be created in decoder.");
-                return 0;
-            }
-            jab_boolean encode=0;
-            if(GaussJordan(matrixA1, wc, wr, Pg_sub_block, &matrix_rank,encode))
+            const jab_parity_check_matrix* pcm1 = getParityCheckMatrix(wc, wr, Pg_sub_block);
+            if(pcm1 == NULL)
             {
-                reportError("Gauss Jordan Elimination in LDPC encoder failed.");
-                free(matrixA1);
+                releaseParityCheckMatrix(pcm);
                 return 0;
             }
+            const jab_int32* matrixA1 = pcm1->H;
+            matrix_rank = pcm1->rank;
             //ldpc decoding
             //first check syndrom
             jab_boolean is_correct=1;
             jab_int32 offset=ceil(Pg_sub_block/(jab_float)32);
             for (jab_int32 i=0;i< matrix_rank; i++)
             {
-                jab_int32 temp=0;
-                for (jab_int32 j=0;j<Pg_sub_block;j++)
-                    temp ^= (((matrixA1[i*offset+j/32] >> (31-j%32)) & 1) & ((data[iter*old_Pg_sub+j] >> 0) & 1)) << 0; //
-                if (temp)
+                if (getRowParity(matrixA1+i*offset, data, iter*old_Pg_sub, Pg_sub_block))
                 {
                     is_correct=(jab_boolean) 0;//message not correct
                     break;
@@ -756,11 +949,12 @@ jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32
             if(is_correct==0)
             {
                 jab_int32 start_pos=iter*old_Pg_sub;
-                jab_int32 success=decodeMessage(data, matrixA1, Pg_sub_block, matrix_rank, max_iter, &is_correct,start_pos);
+                jab_int32 success=decodeMessage(data, matrixA1, Pg_sub_block, matrix_rank, max_iter, &is_correct,start_pos, &iterations);
                 if(success == 0)
                 {
                     reportError("LDPC decoder error.");
-                    free(matrixA1);
+                    releaseParityCheckMatrix(pcm1);
+                    releaseParityCheckMatrix(pcm);
                     return 0;
                 }
             }
@@ -769,10 +963,7 @@ jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32
                 jab_boolean is_correct=1;
                 for (jab_int32 i=0;i< matrix_rank; i++)
                 {
-                    jab_int32 temp=0;
-                    for (jab_int32 j=0;j<Pg_sub_block;j++)
-                        temp ^= (((matrixA1[i*offset+j/32] >> (31-j%32)) & 1) & ((data[iter*old_Pg_sub+j] >> 0) & 1)) << 0;
-                    if (temp)
+                    if (getRowParity(matrixA1+i*offset, data, iter*old_Pg_sub, Pg_sub_block))
                     {
                         is_correct=(jab_boolean) 0;//message not correct
                         break;
@@ -781,11 +972,12 @@ jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32
                 if(is_correct==0)
                 {
                     reportError("Too many errors in message. LDPC decoding failed.");
-                    free(matrixA1);
+                    releaseParityCheckMatrix(pcm1);
+                    releaseParityCheckMatrix(pcm);
                     return 0;
                 }
             }
-            free(matrixA1);
+            releaseParityCheckMatrix(pcm1);
         }
         else
         {
@@ -795,10 +987,7 @@ jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32
             jab_int32 offset=ceil(Pg_sub_block/(jab_float)32);
             for (jab_int32 i=0;i< matrix_rank; i++)
             {
-                jab_int32 temp=0;
-                for (jab_int32 j=0;j<Pg_sub_block;j++)
-                    temp ^= (((matrixA[i*offset+j/32] >> (31-j%32)) & 1) & ((data[iter*old_Pg_sub+j] >> 0) & 1)) << 0;
-                if (temp)
+                if (getRowParity(matrixA+i*offset, data, iter*old_Pg_sub, Pg_sub_block))
                 {
                     is_correct=(jab_boolean) 0;//message not correct
                     break;
@@ -808,20 +997,17 @@ jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32
             if(is_correct==0)
             {
                 jab_int32 start_pos=iter*old_Pg_sub;
-                jab_int32 success=decodeMessage(data, matrixA, Pg_sub_block, matrix_rank, max_iter, &is_correct, start_pos);
+                jab_int32 success=decodeMessage(data, matrixA, Pg_sub_block, matrix_rank, max_iter, &is_correct, start_pos, &iterations);
                 if(success == 0)
                 {
                     reportError("LDPC decoder error.");
-                    free(matrixA);
+                    releaseParityCheckMatrix(pcm);
                     return 0;
                 }
                 is_correct=1;
                 for (jab_int32 i=0;i< matrix_rank; i++)
                 {
-                    jab_int32 temp=0;
-                    for (jab_int32 j=0;j<Pg_sub_block;j++)
-                        temp ^= (((matrixA[i*offset+j/32] >> (31-j%32)) & 1) & ((data[iter*old_Pg_sub+j] >> 0) & 1)) << 0;
-                    if (temp)
+                    if (getRowParity(matrixA+i*offset, data, iter*old_Pg_sub, Pg_sub_block))
                     {
                         is_correct=(jab_boolean)0;//message not correct
                         break;
@@ -830,19 +1016,15 @@ jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32
                 if(is_correct==0)
                 {
                     reportError("Too many errors in message. LDPC decoding failed.");
-                    free(matrixA);
+                    releaseParityCheckMatrix(pcm);
                     return 0;
                 }
             }
         }
-        jab_int32 loop=0;
-        for (jab_int32 i=iter*old_Pg_sub;i < iter * old_Pg_sub + Pn_sub_block; i++)
-        {
-            data[iter*old_Pn_sub+loop]=data[i+ matrix_rank];
-            loop++;
-        }
+        recordLDPCBlock(iterations);
+        copyBits(data, iter*old_Pn_sub, data, iter*old_Pg_sub + matrix_rank, Pn_sub_block);
     }
-    free(matrixA);
+    releaseParityCheckMatrix(pcm);
     return decoded_data_len;
 }
 
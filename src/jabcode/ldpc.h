@@ -14,6 +14,8 @@
 #ifndef JABCODE_LDPC_H
 #define JABCODE_LDPC_H
 
+#include "cache.h"
+
 #define LPDC_METADATA_SEED 	38545
 #define LPDC_MESSAGE_SEED 	785465
 
@@ -23,8 +25,43 @@
 //static const jab_vector2d default_ecl = {4, 7};	//default (wc, wr) for LDPC, corresponding to ecc level 5.
 //static const jab_vector2d default_ecl = {5, 6};	//This (wc, wr) could be used, if higher robustness is preferred to capacity.
 
-extern jab_data *encodeLDPC(jab_data* data, jab_int32* coderate_params);
-extern jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32 wr);
+#define MAX_CACHED_GENERATOR_MATRICES	16	//the maximal number of cached LDPC generator matrices
+#define MAX_CACHED_PARITY_CHECK_MATRICES	32	//the maximal number of cached LDPC parity check matrices
+
+/**
+ * @brief LDPC generator matrix, which only depends on the code parameters and the block length
+*/
+typedef struct jab_generator_matrix {
+	jab_cache_entry	entry;			//the cache entry, which must be the first member
+	jab_int32		wc;
+	jab_int32		wr;
+	jab_int32		capacity;		//the block length
+	jab_int32		rank;			//the rank of the parity check matrix
+	jab_int32*		G;
+}jab_generator_matrix;
+
+/**
+ * @brief LDPC parity check matrix reduced by Gauss Jordan elimination for the decoder, which only depends on the code parameters and the block length
+*/
+typedef struct jab_parity_check_matrix {
+	jab_cache_entry	entry;			//the cache entry, which must be the first member
+	jab_int32		wc;
+	jab_int32		wr;
+	jab_int32		capacity;		//the block length
+	jab_int32		rank;			//the rank of the matrix
+	jab_int32*		H;
+}jab_parity_check_matrix;
+
+typedef struct jab_bitstream jab_bitstream;
+
+extern const jab_generator_matrix* getGeneratorMatrix(jab_int32 wc, jab_int32 wr, jab_int32 capacity);
+extern void releaseGeneratorMatrix(const jab_generator_matrix* gm);
+extern void clearGeneratorMatrixCache(void);
+extern const jab_parity_check_matrix* getParityCheckMatrix(jab_int32 wc, jab_int32 wr, jab_int32 capacity);
+extern void releaseParityCheckMatrix(const jab_parity_check_matrix* pcm);
+extern void clearParityCheckMatrixCache(void);
+extern jab_bitstream *encodeLDPC(const jab_bitstream* data, jab_int32* coderate_params);
+extern jab_int32 decodeLDPChd(jab_bitstream* data, jab_int32 length, jab_int32 wc, jab_int32 wr);
 extern jab_int32 decodeLDPC(jab_float* enc, jab_int32 length, jab_int32 wc, jab_int32 wr, jab_byte* dec);
 
 
@@ -15,268 +15,326 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
+#include <pthread.h>
 #include "jabcode.h"
 #include "encoder.h"
 #include "detector.h"
+#include "decoder.h"
+#include "datamap.h"
+#include "cache.h"
 
 #define W1	100
 #define W2	3
 #define W3	3
 
+#define MAX_CACHED_MASK_PATTERNS	256	//the maximal number of cached mask patterns
+#define MASK_EVALUATION_THREADS		4	//the number of worker threads evaluating the mask patterns
+#define MASK_PARALLEL_MIN_MODULES	4096	//the minimal number of modules in a code to evaluate the mask patterns concurrently
+
+/**
+ * @brief Mask pattern of a symbol, i.e. the XOR value of each module in row-major order
+*/
+typedef struct jab_mask_pattern {
+	jab_cache_entry	entry;			//the cache entry, which must be the first member
+	jab_int32		mask_type;
+	jab_vector2d	side_size;
+	jab_int32		color_number;
+	jab_byte		pattern[];
+}jab_mask_pattern;
+
+/**
+ * @brief Evaluation of a subset of the mask patterns, run by one worker thread
+*/
+typedef struct {
+	jab_encode*		enc;
+	jab_code*		cp;
+	jab_int32		first;			//the first evaluated mask type
+	jab_int32		step;			//the distance between two evaluated mask types
+	const jab_byte*	occupied;		//the module occupancy of the evaluation window
+	jab_int32*		scores;			//the penalty score of each mask type
+	jab_double*		times;			//the evaluation time of each mask type, NULL if not collected
+	jab_boolean		success;
+}jab_mask_evaluation;
+
+/**
+ * @brief Get the mask value of a module
+ * @param mask_type the mask pattern reference
+ * @param x the x coordinate of the module
+ * @param y the y coordinate of the module
+ * @param color_number the number of module colors
+ * @return the mask value
+*/
+jab_int32 getMaskValue(jab_int32 mask_type, jab_int32 x, jab_int32 y, jab_int32 color_number)
+{
+	switch(mask_type)
+	{
+		case 0:
+			return (x + y) % color_number;
+		case 1:
+			return x % color_number;
+		case 2:
+			return y % color_number;
+		case 3:
+			return (x / 2 + y / 3) % color_number;
+		case 4:
+			return (x / 3 + y / 2) % color_number;
+		case 5:
+			return ((x + y) / 2 + (x + y) / 3) % color_number;
+		case 6:
+			return ((x*x * y) % 7 + (2*x*x + 2*y) % 19) % color_number;
+		case 7:
+			return ((x * y*y) % 5 + (2*x + y*y) % 13) % color_number;
+	}
+	return 0;
+}
+
+/**
+ * @brief Check if a cached mask pattern has the parameters of a key pattern
+ * @param entry the cached pattern
+ * @param key the pattern holding only the parameters
+ * @return JAB_SUCCESS if matched | JAB_FAILURE
+*/
+jab_boolean matchMaskPattern(const jab_cache_entry* entry, const void* key)
+{
+	const jab_mask_pattern* mp = (const jab_mask_pattern*)entry;
+	const jab_mask_pattern* params = (const jab_mask_pattern*)key;
+	return mp->mask_type == params->mask_type && mp->side_size.x == params->side_size.x && mp->side_size.y == params->side_size.y &&
+		   mp->color_number == params->color_number;
+}
+
+/**
+ * @brief Generate the mask pattern of a key pattern for the cache
+ * @param key the pattern holding only the parameters
+ * @return the cache entry of the pattern | NULL if failed
+*/
+jab_cache_entry* createMaskPattern(const void* key)
+{
+	const jab_mask_pattern* params = (const jab_mask_pattern*)key;
+	jab_vector2d side_size = params->side_size;
+	jab_mask_pattern* mp = (jab_mask_pattern*)malloc(sizeof(jab_mask_pattern) + side_size.x * side_size.y * sizeof(jab_byte));
+	if(mp == NULL)
+	{
+		reportError("Memory allocation for mask pattern failed");
+		return NULL;
+	}
+	DECODE_STATS_ADD(bytes_allocated, (jab_int64)(sizeof(jab_mask_pattern) + side_size.x * side_size.y * sizeof(jab_byte)))
+	mp->mask_type = params->mask_type;
+	mp->side_size = side_size;
+	mp->color_number = params->color_number;
+	for(jab_int32 y=0; y<side_size.y; y++)
+	{
+		for(jab_int32 x=0; x<side_size.x; x++)
+		{
+			mp->pattern[y * side_size.x + x] = (jab_byte)getMaskValue(mp->mask_type, x, y, mp->color_number);
+		}
+	}
+	return &mp->entry;
+}
+
+/**
+ * @brief Free a mask pattern evicted from or not taken by the cache
+ * @param entry the cache entry of the pattern
+*/
+void destroyMaskPattern(jab_cache_entry* entry)
+{
+	free(entry);
+}
+
+static jab_cache mask_pattern_cache = JAB_CACHE_INITIALIZER(MAX_CACHED_MASK_PATTERNS, matchMaskPattern, createMaskPattern, destroyMaskPattern);
+
+/**
+ * @brief Get the mask pattern from the cache, or generate it if not cached yet
+ * @param mask_type the mask pattern reference
+ * @param side_size the symbol size in module
+ * @param color_number the number of module colors
+ * @return the immutable mask pattern, to be released by releaseMaskPattern | NULL if failed
+*/
+const jab_mask_pattern* getMaskPattern(jab_int32 mask_type, jab_vector2d side_size, jab_int32 color_number)
+{
+	jab_mask_pattern key;
+	memset(&key, 0, sizeof(key));
+	key.mask_type = mask_type;
+	key.side_size = side_size;
+	key.color_number = color_number;
+	return (const jab_mask_pattern*)getCacheEntry(&mask_pattern_cache, &key);
+}
+
 /**
- * @brief Apply mask penalty rule 1
- * @param matrix the symbol matrix
- * @param width the symbol matrix width
- * @param height the symbol matrix height
+ * @brief Release a mask pattern obtained from getMaskPattern
+ * @param mp the mask pattern
+*/
+void releaseMaskPattern(const jab_mask_pattern* mp)
+{
+	releaseCacheEntry(&mask_pattern_cache, (const jab_cache_entry*)mp);
+}
+
+/**
+ * @brief Free all cached mask patterns
+ * @note No pattern obtained from the cache may be in use
+*/
+void clearMaskPatternCache(void)
+{
+	clearCache(&mask_pattern_cache);
+}
+
+/**
+ * @brief Get the partner color of each finder pattern core color, for the penalty of finder pattern look-alikes
  * @param color_number the number of module colors
- * @return the penalty score
+ * @param partner the partner color of each color, -1 if the color is not a finder pattern core color
 */
-jab_int32 applyRule1(jab_int32* matrix, jab_int32 width, jab_int32 height, jab_int32 color_number)
+void getFinderPatternPartners(jab_int32 color_number, jab_int32 partner[256])
 {
-	jab_byte fp0_c1, fp0_c2;
-	jab_byte fp1_c1, fp1_c2;
-	jab_byte fp2_c1, fp2_c2;
-	jab_byte fp3_c1, fp3_c2;
+	for(jab_int32 i=0; i<256; i++)
+		partner[i] = -1;
 	if(color_number == 2)                            //two colors: black(000) white(111)
 	{
-		fp0_c1 = 0;	fp0_c2 = 1;
-		fp1_c1 = 1;	fp1_c2 = 0;
-		fp2_c1 = 1;	fp2_c2 = 0;
-		fp3_c1 = 1;	fp3_c2 = 0;
+		partner[0] = 1;
+		partner[1] = 0;
 	}
 	else if(color_number == 4)
 	{
-		fp0_c1 = 0;	fp0_c2 = 3;
-		fp1_c1 = 1;	fp1_c2 = 2;
-		fp2_c1 = 2;	fp2_c2 = 1;
-		fp3_c1 = 3;	fp3_c2 = 0;
+		partner[0] = 3;
+		partner[1] = 2;
+		partner[2] = 1;
+		partner[3] = 0;
 	}
 	else
 	{
-		fp0_c1 = FP0_CORE_COLOR;	fp0_c2 = 7 - FP0_CORE_COLOR;
-		fp1_c1 = FP1_CORE_COLOR;	fp1_c2 = 7 - FP1_CORE_COLOR;
-		fp2_c1 = FP2_CORE_COLOR;	fp2_c2 = 7 - FP2_CORE_COLOR;
-		fp3_c1 = FP3_CORE_COLOR;	fp3_c2 = 7 - FP3_CORE_COLOR;
+		partner[FP0_CORE_COLOR] = 7 - FP0_CORE_COLOR;
+		partner[FP1_CORE_COLOR] = 7 - FP1_CORE_COLOR;
+		partner[FP2_CORE_COLOR] = 7 - FP2_CORE_COLOR;
+		partner[FP3_CORE_COLOR] = 7 - FP3_CORE_COLOR;
+	}
+}
+
+/**
+ * @brief Evaluate masking results in one pass over the code matrix
+ * @param matrix the masked code matrix
+ * @param occupied the module occupancy of the code matrix, 0 for the gaps between symbols
+ * @param width the code matrix width
+ * @param height the code matrix height
+ * @param color_number the number of module colors
+ * @param bound the evaluation stops as soon as the penalty score reaches this bound
+ * @param runs the buffer for the vertical run state of 2*width columns
+ * @return the penalty score | a partial score not less than bound
+*/
+jab_int32 evaluateMask(const jab_byte* matrix, const jab_byte* occupied, jab_int32 width, jab_int32 height, jab_int32 color_number, jab_int32 bound, jab_int32* runs)
+{
+	//rule 1: finder pattern look-alikes, i.e. a cross of alternating core and partner colors around a core color
+	//rule 2: 2x2 blocks of the same color
+	//rule 3: runs of at least five modules of the same color
+	jab_int32 partner[256];
+	getFinderPatternPartners(color_number, partner);
+
+	jab_int32* run_count = runs;
+	jab_int32* run_color = runs + width;
+	for(jab_int32 j=0; j<width; j++)
+	{
+		run_count[j] = 0;
+		run_color[j] = -1;
 	}
 
-	jab_int32 score = 0;
+	jab_int32 rule1 = 0, rule2 = 0, rule3 = 0;
 	for(jab_int32 i=0; i<height; i++)
 	{
+		const jab_byte* row = matrix + i * width;
+		const jab_byte* occ = occupied + i * width;
+
+		//rule 3, horizontal runs in this row and vertical runs continued by this row
+		jab_int32 count = 0;
+		jab_int32 pre_color = -1;
 		for(jab_int32 j=0; j<width; j++)
 		{
-/*			//horizontal check
-			if(j + 4 < width)
+			jab_int32 cur_color = occ[j] ? row[j] : -1;
+			if(cur_color != -1 && cur_color == pre_color)
+			{
+				count++;
+			}
+			else
 			{
-				if(matrix[i * width + j] 	 == fp0_c1 &&	//finder pattern 0
-				   matrix[i * width + j + 1] == fp0_c2 &&
-				   matrix[i * width + j + 2] == fp0_c1 &&
-				   matrix[i * width + j + 3] == fp0_c2 &&
-				   matrix[i * width + j + 4] == fp0_c1)
-				   score++;
-				else if(									//finder pattern 1
-				   matrix[i * width + j] 	 == fp1_c1 &&
-				   matrix[i * width + j + 1] == fp1_c2 &&
-				   matrix[i * width + j + 2] == fp1_c1 &&
-				   matrix[i * width + j + 3] == fp1_c2 &&
-				   matrix[i * width + j + 4] == fp1_c1)
-				   score++;
-				else if(									//finder pattern 2
-				   matrix[i * width + j] 	 == fp2_c1 &&
-				   matrix[i * width + j + 1] == fp2_c2 &&
-				   matrix[i * width + j + 2] == fp2_c1 &&
-				   matrix[i * width + j + 3] == fp2_c2 &&
-				   matrix[i * width + j + 4] == fp2_c1)
-				   score++;
-				else if(									//finder pattern 3
-				   matrix[i * width + j] 	 == fp3_c1 &&
-				   matrix[i * width + j + 1] == fp3_c2 &&
-				   matrix[i * width + j + 2] == fp3_c1 &&
-				   matrix[i * width + j + 3] == fp3_c2 &&
-				   matrix[i * width + j + 4] == fp3_c1)
-				   score++;
+				if(count >= 5)
+					rule3 += W3 + (count - 5);
+				count = (cur_color != -1);
+				pre_color = cur_color;
 			}
-			//vertical check
-			if(i + 4 < height)
+			if(cur_color != -1 && cur_color == run_color[j])
 			{
-				if(matrix[i * width + j] 	   == fp0_c1 &&	//finder pattern 0
-				   matrix[(i + 1) * width + j] == fp0_c2 &&
-				   matrix[(i + 2) * width + j] == fp0_c1 &&
-				   matrix[(i + 3) * width + j] == fp0_c2 &&
-				   matrix[(i + 4) * width + j] == fp0_c1)
-				   score++;
-				else if(									//finder pattern 1
-				   matrix[i * width + j] 	   == fp1_c1 &&
-				   matrix[(i + 1) * width + j] == fp1_c2 &&
-				   matrix[(i + 2) * width + j] == fp1_c1 &&
-				   matrix[(i + 3) * width + j] == fp1_c2 &&
-				   matrix[(i + 4) * width + j] == fp1_c1)
-				   score++;
-				else if(									//finder pattern 2
-				   matrix[i * width + j] 	   == fp2_c1 &&
-				   matrix[(i + 1) * width + j] == fp2_c2 &&
-				   matrix[(i + 2) * width + j] == fp2_c1 &&
-				   matrix[(i + 3) * width + j] == fp2_c2 &&
-				   matrix[(i + 4) * width + j] == fp2_c1)
-				   score++;
-				else if(									//finder pattern 3
-				   matrix[i * width + j] 	   == fp3_c1 &&
-				   matrix[(i + 1) * width + j] == fp3_c2 &&
-				   matrix[(i + 2) * width + j] == fp3_c1 &&
-				   matrix[(i + 3) * width + j] == fp3_c2 &&
-				   matrix[(i + 4) * width + j] == fp3_c1)
-				   score++;
+				run_count[j]++;
 			}
-*/
-			if(j >= 2 && j <= width - 3 && i >= 2 && i <= height - 3)
+			else
 			{
-				if(matrix[i * width + j - 2] == fp0_c1 &&	//finder pattern 0
-				   matrix[i * width + j - 1] == fp0_c2 &&
-				   matrix[i * width + j    ] == fp0_c1 &&
-				   matrix[i * width + j + 1] == fp0_c2 &&
-				   matrix[i * width + j + 2] == fp0_c1 &&
-				   matrix[(i - 2) * width + j] == fp0_c1 &&
-				   matrix[(i - 1) * width + j] == fp0_c2 &&
-				   matrix[(i    ) * width + j] == fp0_c1 &&
-				   matrix[(i + 1) * width + j] == fp0_c2 &&
-				   matrix[(i + 2) * width + j] == fp0_c1)
-				   score++;
-				else if(
-				   matrix[i * width + j - 2] == fp1_c1 &&	//finder pattern 1
-				   matrix[i * width + j - 1] == fp1_c2 &&
-				   matrix[i * width + j    ] == fp1_c1 &&
-				   matrix[i * width + j + 1] == fp1_c2 &&
-				   matrix[i * width + j + 2] == fp1_c1 &&
-				   matrix[(i - 2) * width + j] == fp1_c1 &&
-				   matrix[(i - 1) * width + j] == fp1_c2 &&
-				   matrix[(i    ) * width + j] == fp1_c1 &&
-				   matrix[(i + 1) * width + j] == fp1_c2 &&
-				   matrix[(i + 2) * width + j] == fp1_c1)
-				   score++;
-				else if(
-				   matrix[i * width + j - 2] == fp2_c1 &&	//finder pattern 2
-				   matrix[i * width + j - 1] == fp2_c2 &&
-				   matrix[i * width + j    ] == fp2_c1 &&
-				   matrix[i * width + j + 1] == fp2_c2 &&
-				   matrix[i * width + j + 2] == fp2_c1 &&
-				   matrix[(i - 2) * width + j] == fp2_c1 &&
-				   matrix[(i - 1) * width + j] == fp2_c2 &&
-				   matrix[(i    ) * width + j] == fp2_c1 &&
-				   matrix[(i + 1) * width + j] == fp2_c2 &&
-				   matrix[(i + 2) * width + j] == fp2_c1)
-				   score++;
-				else if(
-				   matrix[i * width + j - 2] == fp3_c1 &&	//finder pattern 3
-				   matrix[i * width + j - 1] == fp3_c2 &&
-				   matrix[i * width + j    ] == fp3_c1 &&
-				   matrix[i * width + j + 1] == fp3_c2 &&
-				   matrix[i * width + j + 2] == fp3_c1 &&
-				   matrix[(i - 2) * width + j] == fp3_c1 &&
-				   matrix[(i - 1) * width + j] == fp3_c2 &&
-				   matrix[(i    ) * width + j] == fp3_c1 &&
-				   matrix[(i + 1) * width + j] == fp3_c2 &&
-				   matrix[(i + 2) * width + j] == fp3_c1)
-				   score++;
+				if(run_count[j] >= 5)
+					rule3 += W3 + (run_count[j] - 5);
+				run_count[j] = (cur_color != -1);
+				run_color[j] = cur_color;
 			}
 		}
-	}
-	return W1 * score;
-}
+		if(count >= 5)
+			rule3 += W3 + (count - 5);
 
-/**
- * @brief Apply mask penalty rule 2
- * @param matrix the symbol matrix
- * @param width the symbol matrix width
- * @param height the symbol matrix height
- * @return the penalty score
-*/
-jab_int32 applyRule2(jab_int32* matrix, jab_int32 width, jab_int32 height)
-{
-	jab_int32 score = 0;
-	for(jab_int32 i=0; i<height-1; i++)
-	{
-		for(jab_int32 j=0; j<width-1; j++)
+		//rule 2, the 2x2 blocks between this row and the next one
+		if(i < height - 1)
 		{
-			if(matrix[i * width + j] != -1 && matrix[i * width + (j + 1)] != -1 &&
-			   matrix[(i + 1) * width + j] != -1 && matrix[(i + 1) * width + (j + 1)] != -1)
+			const jab_byte* next = row + width;
+			const jab_byte* next_occ = occ + width;
+			for(jab_int32 j=0; j<width-1; j++)
 			{
-				if(matrix[i * width + j] == matrix[i * width + (j + 1)] &&
-				   matrix[i * width + j] == matrix[(i + 1) * width + j] &&
-				   matrix[i * width + j] == matrix[(i + 1) * width + (j + 1)])
-				   score++;
+				rule2 += (occ[j] & occ[j + 1] & next_occ[j] & next_occ[j + 1]) &&
+						 row[j] == row[j + 1] && row[j] == next[j] && row[j] == next[j + 1];
 			}
 		}
-	}
-	return W2 * score;
-}
 
-/**
- * @brief Apply mask penalty rule 3
- * @param matrix the symbol matrix
- * @param width the symbol matrix width
- * @param height the symbol matrix height
- * @return the penalty score
-*/
-jab_int32 applyRule3(jab_int32* matrix, jab_int32 width, jab_int32 height)
-{
-	jab_int32 score = 0;
-	for(jab_int32 k=0; k<2; k++)
-	{
-		jab_int32 maxi, maxj;
-		if(k == 0)	//horizontal scan
-		{
-			maxi = height;
-			maxj = width;
-		}
-		else		//vertical scan
-		{
-			maxi = width;
-			maxj = height;
-		}
-		for(jab_int32 i=0; i<maxi; i++)
+		//rule 1, the crosses centered in this row
+		if(i >= 2 && i <= height - 3)
 		{
-			jab_int32 same_color_count = 0;
-			jab_int32 pre_color = -1;
-			for(jab_int32 j=0; j<maxj; j++)
+			const jab_byte* up2 = row - 2 * width;
+			const jab_byte* up1 = row - width;
+			const jab_byte* dn1 = row + width;
+			const jab_byte* dn2 = row + 2 * width;
+			for(jab_int32 j=2; j<=width-3; j++)
 			{
-				jab_int32 cur_color = ( k == 0 ? matrix[i * width + j] : matrix[j * width + i] );
-				if(cur_color != -1)
-				{
-					if(cur_color == pre_color)
-						same_color_count++;
-					else
-					{
-						if(same_color_count >= 5)
-							score += W3 + (same_color_count - 5);
-						same_color_count = 1;
-						pre_color = cur_color;
-					}
-				}
-				else
-				{
-					if(same_color_count >= 5)
-						score += W3 + (same_color_count - 5);
-					same_color_count = 0;
-					pre_color = -1;
-				}
+				//the gaps between symbols are never finder pattern colors, so they need no occupancy check
+				jab_int32 c1 = row[j];
+				jab_int32 c2 = partner[c1];
+				if(c2 >= 0 &&
+				   row[j - 2] == c1 && row[j - 1] == c2 && row[j + 1] == c2 && row[j + 2] == c1 &&
+				   up2[j] == c1 && up1[j] == c2 && dn1[j] == c2 && dn2[j] == c1)
+				   rule1++;
 			}
-			if(same_color_count >= 5)
-				score += W3 + (same_color_count - 5);
 		}
+
+		//all penalties only grow, so the mask can be discarded once the bound is reached
+		jab_int32 score = W1 * rule1 + W2 * rule2 + rule3;
+		if(score >= bound)
+			return score;
 	}
-	return score;
+	for(jab_int32 j=0; j<width; j++)
+	{
+		if(run_count[j] >= 5)
+			rule3 += W3 + (run_count[j] - 5);
+	}
+	return W1 * rule1 + W2 * rule2 + rule3;
 }
 
 /**
- * @brief Evaluate masking results
- * @param matrix the symbol matrix
- * @param width the symbol matrix width
- * @param height the symbol matrix height
- * @param color_number the number of module colors
- * @return the penalty score
+ * @brief Get the starting coordinates of a symbol in the code matrix
+ * @param enc the encode parameters
+ * @param index the symbol index
+ * @param cp the code parameters
+ * @param startx the x coordinate of the symbol
+ * @param starty the y coordinate of the symbol
 */
-jab_int32 evaluateMask(jab_int32* matrix, jab_int32 width, jab_int32 height, jab_int32 color_number)
+void getSymbolOrigin(jab_encode* enc, jab_int32 index, jab_code* cp, jab_int32* startx, jab_int32* starty)
 {
-	return applyRule1(matrix, width, height, color_number) + applyRule2(matrix, width, height) + applyRule3(matrix, width, height);
+	jab_int32 col = jab_symbol_pos[enc->symbol_positions[index]].x - cp->min_x;
+	jab_int32 row = jab_symbol_pos[enc->symbol_positions[index]].y - cp->min_y;
+	*startx = 0;
+	*starty = 0;
+	for(jab_int32 c=0; c<col; c++)
+		*startx += cp->col_width[c];
+	for(jab_int32 r=0; r<row; r++)
+		*starty += cp->row_height[r];
 }
 
 /**
@@ -285,73 +343,165 @@ jab_int32 evaluateMask(jab_int32* matrix, jab_int32 width, jab_int32 height, jab
  * @param mask_type the mask pattern reference
  * @param masked the masked symbol matrix
  * @param cp the code parameters
+ * @return JAB_SUCCESS | JAB_FAILURE
 */
-void maskSymbols(jab_encode* enc, jab_int32 mask_type, jab_int32* masked, jab_code* cp)
+jab_boolean maskSymbols(jab_encode* enc, jab_int32 mask_type, jab_byte* masked, jab_code* cp)
 {
 	for(jab_int32 k=0; k<enc->symbol_number; k++)
 	{
 		jab_int32 startx = 0, starty = 0;
 		if(masked && cp)
 		{
-			//calculate the starting coordinates of the symbol matrix
-			jab_int32 col = jab_symbol_pos[enc->symbol_positions[k]].x - cp->min_x;
-			jab_int32 row = jab_symbol_pos[enc->symbol_positions[k]].y - cp->min_y;
-			for(jab_int32 c=0; c<col; c++)
-				startx += cp->col_width[c];
-			for(jab_int32 r=0; r<row; r++)
-				starty += cp->row_height[r];
+			getSymbolOrigin(enc, k, cp, &startx, &starty);
 		}
 		jab_int32 symbol_width = enc->symbols[k].side_size.x;
 		jab_int32 symbol_height= enc->symbols[k].side_size.y;
+		const jab_mask_pattern* mp = getMaskPattern(mask_type, enc->symbols[k].side_size, enc->color_number);
+		if(mp == NULL)
+		{
+			return JAB_FAILURE;
+		}
 
-        //apply mask on the symbol
+        //apply mask on the symbol, only data modules are masked
 		for(jab_int32 y=0; y<symbol_height; y++)
 		{
-			for(jab_int32 x=0; x<symbol_width; x++)
+			const jab_byte* src = enc->symbols[k].matrix + y * symbol_width;
+			const jab_byte* map = enc->symbols[k].data_map + y * symbol_width;
+			const jab_byte* pattern = mp->pattern + y * symbol_width;
+			if(masked && cp)
 			{
-				jab_int32 index = enc->symbols[k].matrix[y * symbol_width + x];
-				if(enc->symbols[k].data_map[y * symbol_width + x])
+				jab_byte* dst = masked + (y + starty) * cp->code_size.x + startx;
+				for(jab_int32 x=0; x<symbol_width; x++)
 				{
-					switch(mask_type)
-					{
-						case 0:
-                            index ^= (x + y) % enc->color_number;
-							break;
-						case 1:
-                            index ^= x % enc->color_number;
-							break;
-						case 2:
-                            index ^= y % enc->color_number;
-							break;
-						case 3:
-                            index ^= (x / 2 + y / 3) % enc->color_number;
-							break;
-						case 4:
-                            index ^= (x / 3 + y / 2) % enc->color_number;
-							break;
-						case 5:
-                            index ^= ((x + y) / 2 + (x + y) / 3) % enc->color_number;
-							break;
-						case 6:
-                            index ^= ((x*x * y) % 7 + (2*x*x + 2*y) % 19) % enc->color_number;
-							break;
-						case 7:
-                            index ^= ((x * y*y) % 5 + (2*x + y*y) % 13) % enc->color_number;
-							break;
-					}
-					if(masked && cp)
-						masked[(y + starty) * cp->code_size.x + (x + startx)] = index;
-					else
-						enc->symbols[k].matrix[y * symbol_width + x] = (jab_byte)index;
+					dst[x] = src[x] ^ (map[x] ? pattern[x] : 0);	//non-data modules are copied
 				}
-				else
+			}
+			else
+			{
+				jab_byte* dst = enc->symbols[k].matrix + y * symbol_width;
+				for(jab_int32 x=0; x<symbol_width; x++)
 				{
-                    if(masked && cp)
-                        masked[(y + starty) * cp->code_size.x + (x + startx)] = index; //copy non-data module
+					dst[x] = src[x] ^ (map[x] ? pattern[x] : 0);
 				}
 			}
 		}
+		releaseMaskPattern(mp);
+	}
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Get the window of the code in which the mask patterns are evaluated
+ * @param enc the encode parameters
+ * @param cp the code parameters
+ * @param x the x coordinate of the window
+ * @param y the y coordinate of the window
+ * @param width the window width
+ * @param height the window height
+*/
+void getMaskEvaluationWindow(jab_encode* enc, jab_code* cp, jab_int32* x, jab_int32* y, jab_int32* width, jab_int32* height)
+{
+	*width = cp->code_size.x;
+	*height= cp->code_size.y;
+	if(enc->mask_sample_modules > 0 && cp->code_size.x * cp->code_size.y > enc->mask_sample_modules)
+	{
+		*width = MIN(cp->code_size.x, (jab_int32)sqrt(enc->mask_sample_modules));
+		*height= MIN(cp->code_size.y, enc->mask_sample_modules / *width);
+	}
+	*x = (cp->code_size.x - *width) / 2;
+	*y = (cp->code_size.y - *height) / 2;
+}
+
+/**
+ * @brief Evaluate a subset of the mask patterns
+ * @param arg the mask evaluation
+ * @return NULL
+*/
+void* evaluateMaskPatterns(void* arg)
+{
+	jab_mask_evaluation* eval = (jab_mask_evaluation*)arg;
+	jab_code* cp = eval->cp;
+	eval->success = JAB_FAILURE;
+
+	jab_int32 win_x, win_y, win_width, win_height;
+	getMaskEvaluationWindow(eval->enc, cp, &win_x, &win_y, &win_width, &win_height);
+	jab_boolean sampled = (win_width != cp->code_size.x || win_height != cp->code_size.y);
+
+	//each worker masks into its own buffer, followed by the evaluation window if the code is sampled
+	jab_int32 code_area = cp->code_size.x * cp->code_size.y;
+	jab_int32* runs = (jab_int32 *)malloc(2 * win_width * sizeof(jab_int32));
+	jab_byte* masked = (jab_byte *)malloc(code_area + (sampled ? win_width * win_height : 0));
+	if(runs == NULL || masked == NULL)
+	{
+		reportError("Memory allocation for masked code failed");
+		free(runs);
+		free(masked);
+		return NULL;
+	}
+	memset(masked, 0xFF, code_area);	//the gaps between symbols keep the value 0xFF
+	jab_byte* window = sampled ? masked + code_area : masked;
+
+	//a mask can only be selected if its score is lower than the scores of all masks before it,
+	//so the evaluation can be cut off at the lowest score so far unless the full scores are reported
+	jab_boolean full_scores = (eval->enc->stats != NULL);
+	jab_int32 bound = full_scores ? INT_MAX : 10000;
+	for(jab_int32 t=eval->first; t<NUMBER_OF_MASK_PATTERNS; t+=eval->step)
+	{
+		jab_double start = eval->times ? getStatsTime() : 0;
+		if(!maskSymbols(eval->enc, t, masked, cp))
+		{
+			free(runs);
+			free(masked);
+			return NULL;
+		}
+		if(sampled)
+		{
+			for(jab_int32 i=0; i<win_height; i++)
+				memcpy(window + i * win_width, masked + (i + win_y) * cp->code_size.x + win_x, win_width);
+		}
+		//calculate the penalty score
+		eval->scores[t] = evaluateMask(window, eval->occupied, win_width, win_height, eval->enc->color_number, bound, runs);
+		if(!full_scores) bound = MIN(bound, eval->scores[t]);
+		if(eval->times) eval->times[t] = getStatsTime() - start;
+	}
+	free(runs);
+	free(masked);
+	eval->success = JAB_SUCCESS;
+	return NULL;
+}
+
+/**
+ * @brief Get the module occupancy of the mask evaluation window
+ * @param enc the encode parameters
+ * @param cp the code parameters
+ * @return the occupancy of each module in the window, 0 for the gaps between symbols | NULL if failed
+*/
+jab_byte* getCodeOccupancy(jab_encode* enc, jab_code* cp)
+{
+	jab_int32 win_x, win_y, win_width, win_height;
+	getMaskEvaluationWindow(enc, cp, &win_x, &win_y, &win_width, &win_height);
+	jab_byte* occupied = (jab_byte *)calloc(win_width * win_height, sizeof(jab_byte));
+	if(occupied == NULL)
+	{
+		reportError("Memory allocation for code occupancy failed");
+		return NULL;
+	}
+	for(jab_int32 k=0; k<enc->symbol_number; k++)
+	{
+		jab_int32 startx, starty;
+		getSymbolOrigin(enc, k, cp, &startx, &starty);
+		jab_int32 x0 = MAX(startx - win_x, 0);
+		jab_int32 y0 = MAX(starty - win_y, 0);
+		jab_int32 x1 = MIN(startx + enc->symbols[k].side_size.x - win_x, win_width);
+		jab_int32 y1 = MIN(starty + enc->symbols[k].side_size.y - win_y, win_height);
+		if(x1 <= x0)
+			continue;
+		for(jab_int32 y=y0; y<y1; y++)
+		{
+			memset(occupied + y * win_width + x0, 1, x1 - x0);
+		}
 	}
+	return occupied;
 }
 
 /**
@@ -362,94 +512,102 @@ void maskSymbols(jab_encode* enc, jab_int32 mask_type, jab_int32* masked, jab_co
 */
 jab_int32 maskCode(jab_encode* enc, jab_code* cp)
 {
-	jab_int32 mask_type = 0;
-	jab_int32 min_penalty_score = 10000;
+	jab_byte* occupied = getCodeOccupancy(enc, cp);
+	if(occupied == NULL)
+	{
+		return -1;
+	}
+	jab_int32 scores[NUMBER_OF_MASK_PATTERNS];
+	jab_mask_evaluation eval[MASK_EVALUATION_THREADS];
+	jab_int32 worker_number = (cp->code_size.x * cp->code_size.y >= MASK_PARALLEL_MIN_MODULES) ? MASK_EVALUATION_THREADS : 1;
+	if(enc->mask_threads > 0)
+		worker_number = MIN(worker_number, enc->mask_threads);
+	for(jab_int32 i=0; i<worker_number; i++)
+	{
+		eval[i].enc	  = enc;
+		eval[i].cp	  = cp;
+		eval[i].first = i;
+		eval[i].step  = worker_number;
+		eval[i].occupied = occupied;
+		eval[i].scores= scores;
+		eval[i].times = enc->stats ? enc->stats->mask_times : NULL;
+	}
 
-	//allocate memory for masked code
-    jab_int32* masked = (jab_int32 *)malloc(cp->code_size.x * cp->code_size.y * sizeof(jab_int32));
-    if(masked == NULL)
-    {
-        reportError("Memory allocation for masked code failed");
-        return -1;
-    }
-	memset(masked, -1, cp->code_size.x * cp->code_size.y * sizeof(jab_int32)); //set all bytes in masked as 0xFF
+	//evaluate the mask patterns concurrently, the first subset is evaluated by the calling thread
+	pthread_t threads[MASK_EVALUATION_THREADS];
+	jab_boolean started[MASK_EVALUATION_THREADS] = {0};
+	for(jab_int32 i=1; i<worker_number; i++)
+	{
+		started[i] = (pthread_create(&threads[i], NULL, evaluateMaskPatterns, &eval[i]) == 0);
+	}
+	evaluateMaskPatterns(&eval[0]);
+	jab_boolean success = eval[0].success;
+	for(jab_int32 i=1; i<worker_number; i++)
+	{
+		if(started[i])
+			pthread_join(threads[i], NULL);
+		else
+			evaluateMaskPatterns(&eval[i]);
+		success &= eval[i].success;
+	}
+	free(occupied);
+	if(!success)
+	{
+		return -1;
+	}
 
-	//evaluate each mask pattern
+	//select the mask pattern in the same order as the patterns were evaluated serially
+	jab_int32 mask_type = 0;
+	jab_int32 min_penalty_score = 10000;
 	for(jab_int32 t=0; t<NUMBER_OF_MASK_PATTERNS; t++)
 	{
-		jab_int32 penalty_score = 0;
-		maskSymbols(enc, t, masked, cp);
-		//calculate the penalty score
-		penalty_score = evaluateMask(masked, cp->code_size.x, cp->code_size.y, enc->color_number);
 #if TEST_MODE
-		//JAB_REPORT_INFO(("Penalty score: %d", penalty_score))
+		//JAB_REPORT_INFO(("Penalty score: %d", scores[t]))
 #endif
-		if(penalty_score < min_penalty_score)
+		if(scores[t] < min_penalty_score)
 		{
             mask_type = t;
-			min_penalty_score = penalty_score;
+			min_penalty_score = scores[t];
 		}
 	}
 
-	//mask all symbols with the selected mask pattern
-	maskSymbols(enc, mask_type, 0, 0);
+	if(enc->stats)
+	{
+		memcpy(enc->stats->mask_scores, scores, sizeof(scores));
+		enc->stats->mask_reference = mask_type;
+	}
 
-    //clean memory
-    free(masked);
+	//mask all symbols with the selected mask pattern
+	if(!maskSymbols(enc, mask_type, 0, 0))
+	{
+		return -1;
+	}
 	return mask_type;
 }
 
 /**
  * @brief Demask modules
  * @param data the decoded data module values
- * @param data_map the data module positions
- * @param symbol_size the symbol size in module
+ * @param layout the data module layout
  * @param mask_type the mask pattern reference
  * @param color_number the number of module colors
 */
-void demaskSymbol(jab_data* data, jab_byte* data_map, jab_vector2d symbol_size, jab_int32 mask_type, jab_int32 color_number)
+void demaskSymbol(jab_data* data, const jab_symbol_layout* layout, jab_int32 mask_type, jab_int32 color_number)
 {
-	jab_int32 symbol_width = symbol_size.x;
-	jab_int32 symbol_height= symbol_size.y;
-    jab_int32 count = 0;
-	for(jab_int32 x=0; x<symbol_width; x++)
+	jab_int32 module_number = MIN(layout->data_module_number, data->length);
+	const jab_mask_pattern* mp = getMaskPattern(mask_type, layout->side_size, color_number);
+	if(mp == NULL)
 	{
-		for(jab_int32 y=0; y<symbol_height; y++)
+		//fall back to calculating the mask values module by module
+		for(jab_int32 count=0; count<module_number; count++)
 		{
-			if(data_map[y * symbol_width + x] == 0)
-			{
-				if(count > data->length -1) return;
-				jab_int32 index = data->data[count];
-				switch(mask_type)
-				{
-					case 0:
-                        index ^= (x + y) % color_number;
-						break;
-					case 1:
-                        index ^= x % color_number;
-						break;
-					case 2:
-                        index ^= y % color_number;
-						break;
-					case 3:
-                        index ^= (x / 2 + y / 3) % color_number;
-						break;
-					case 4:
-                        index ^= (x / 3 + y / 2) % color_number;
-						break;
-					case 5:
-                        index ^= ((x + y) / 2 + (x + y) / 3) % color_number;
-						break;
-					case 6:
-                        index ^= ((x*x * y) % 7 + (2*x*x + 2*y) % 19) % color_number;
-						break;
-					case 7:
-                        index ^= ((x * y*y) % 5 + (2*x + y*y) % 13) % color_number;
-						break;
-				}
-				data->data[count] = (jab_char)index;
-				count++;
-			}
+			data->data[count] = (jab_char)(data->data[count] ^ getMaskValue(mask_type, layout->modules[count].x, layout->modules[count].y, color_number));
 		}
+		return;
+	}
+	for(jab_int32 count=0; count<module_number; count++)
+	{
+		data->data[count] ^= mp->pattern[layout->modules[count].y * layout->side_size.x + layout->modules[count].x];
 	}
+	releaseMaskPattern(mp);
 }
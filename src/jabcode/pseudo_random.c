@@ -1,7 +1,5 @@
 #include "pseudo_random.h"
 
-static uint64_t lcg64_seed = 42;
-
 uint32_t temper(uint32_t x)
 {
     x ^= x>>11;
@@ -11,13 +9,9 @@ uint32_t temper(uint32_t x)
     return x;
 }
 
-uint32_t lcg64_temper()
-{
-    lcg64_seed = 6364136223846793005ULL * lcg64_seed + 1;
-    return temper(lcg64_seed >> 32);
-}
-
-void setSeed(uint64_t seed)
+//the generator state is owned by the caller, so that symbols can be encoded and decoded concurrently
+uint32_t lcg64_temper(uint64_t* seed)
 {
-	lcg64_seed = seed;
+    *seed = 6364136223846793005ULL * (*seed) + 1;
+    return temper(*seed >> 32);
 }
@@ -4,5 +4,4 @@
 #define UINT32_MAX 4294967295
 #endif
 
-void setSeed(uint64_t seed);
-uint32_t lcg64_temper();
+uint32_t lcg64_temper(uint64_t* seed);
@@ -17,87 +17,147 @@
 #include "jabcode.h"
 #include "detector.h"
 #include "decoder.h"
+#include "scratch.h"
 
 #define SAMPLE_AREA_WIDTH	(CROSS_AREA_WIDTH / 2 - 2) //width of the columns where the metadata and palette in slave symbol are located
 #define SAMPLE_AREA_HEIGHT	20	//height of the metadata rows including the first row, though it does not contain metadata
 
 /**
- * @brief Sample a symbol
+ * @brief Sample modules from the image into a matrix
  * @param bitmap the image bitmap
  * @param pt the transformation matrix
- * @param side_size the symbol size in module
- * @return the sampled symbol matrix
+ * @param matrix the sampled matrix
+ * @param offset_x the x coordinate in module of the first sampled column
+ * @return JAB_SUCCESS | JAB_FAILURE if a module is mapped out of the image
 */
-jab_bitmap* sampleSymbol(jab_bitmap* bitmap, jab_perspective_transform* pt, jab_vector2d side_size)
+jab_boolean sampleModules(jab_bitmap* bitmap, jab_perspective_transform* pt, jab_bitmap* matrix, jab_int32 offset_x)
 {
-	jab_int32 mtx_bytes_per_pixel = bitmap->bits_per_pixel / 8;
-	jab_int32 mtx_bytes_per_row = side_size.x * mtx_bytes_per_pixel;
-	jab_bitmap* matrix = (jab_bitmap*)malloc(sizeof(jab_bitmap) + side_size.x*side_size.y*mtx_bytes_per_pixel*sizeof(jab_byte));
-	if(matrix == NULL)
-	{
-		reportError("Memory allocation for symbol bitmap matrix failed");
-		return NULL;
-	}
-	matrix->channel_count = bitmap->channel_count;
-	matrix->bits_per_channel = bitmap->bits_per_channel;
-	matrix->bits_per_pixel = matrix->bits_per_channel * matrix->channel_count;
-	matrix->width = side_size.x;
-	matrix->height= side_size.y;
-
+	jab_int32 mtx_bytes_per_pixel = matrix->bits_per_pixel / 8;
+	jab_int32 mtx_bytes_per_row = matrix->width * mtx_bytes_per_pixel;
 	jab_int32 bmp_bytes_per_pixel = bitmap->bits_per_pixel / 8;
 	jab_int32 bmp_bytes_per_row = bitmap->width * bmp_bytes_per_pixel;
+	//only color channels are sampled, the alpha channel is set to opaque
+	jab_int32 color_channels = MIN(matrix->channel_count, 3);
 
-	jab_point points[side_size.x];
-    for(jab_int32 i=0; i<side_size.y; i++)
-    {
-		for(jab_int32 j=0; j<side_size.x; j++)
+	jab_int32 mapped_x[matrix->width];
+	jab_int32 mapped_y[matrix->width];
+	for(jab_int32 i=0; i<matrix->height; i++)
+	{
+		//the numerators and the denominator of the projection are linear along a row
+		jab_float x0 = (jab_float)offset_x + 0.5f;
+		jab_float y = (jab_float)i + 0.5f;
+		jab_float nx0 = pt->a11 * x0 + pt->a21 * y + pt->a31;
+		jab_float ny0 = pt->a12 * x0 + pt->a22 * y + pt->a32;
+		jab_float d0  = pt->a13 * x0 + pt->a23 * y + pt->a33;
+		//no dependency between iterations, so that the divisions can be vectorized
+		for(jab_int32 j=0; j<matrix->width; j++)
 		{
-			points[j].x = (jab_float)j + 0.5f;
-			points[j].y = (jab_float)i + 0.5f;
+			jab_float d = d0 + (jab_float)j * pt->a13;
+			mapped_x[j] = (jab_int32)((nx0 + (jab_float)j * pt->a11) / d);
+			mapped_y[j] = (jab_int32)((ny0 + (jab_float)j * pt->a12) / d);
 		}
-		warpPoints(pt, points, side_size.x);
-		for(jab_int32 j=0; j<side_size.x; j++)
+
+		jab_byte* dst = matrix->pixel + i*mtx_bytes_per_row;
+		for(jab_int32 j=0; j<matrix->width; j++, dst += mtx_bytes_per_pixel)
 		{
-			jab_int32 mapped_x = (jab_int32)points[j].x;
-			jab_int32 mapped_y = (jab_int32)points[j].y;
-			if(mapped_x < 0 || mapped_x > bitmap->width-1)
+			jab_int32 mx = mapped_x[j];
+			jab_int32 my = mapped_y[j];
+			if(mx >= 1 && mx < bitmap->width-1 && my >= 1 && my < bitmap->height-1)
 			{
-				if(mapped_x == -1) mapped_x = 0;
-				else if(mapped_x ==  bitmap->width) mapped_x = bitmap->width - 1;
-				else return NULL;
-			}
-			if(mapped_y < 0 || mapped_y > bitmap->height-1)
-			{
-				if(mapped_y == -1) mapped_y = 0;
-				else if(mapped_y ==  bitmap->height) mapped_y = bitmap->height - 1;
-				else return NULL;
+				//interior module: the 3x3 neighborhood is inside the image
+				jab_byte* src = bitmap->pixel + (my-1)*bmp_bytes_per_row + (mx-1)*bmp_bytes_per_pixel;
+				for(jab_int32 c=0; c<color_channels; c++)
+				{
+					jab_byte* p = src + c;
+					jab_int32 sum = p[0] + p[bmp_bytes_per_pixel] + p[2*bmp_bytes_per_pixel];
+					p += bmp_bytes_per_row;
+					sum += p[0] + p[bmp_bytes_per_pixel] + p[2*bmp_bytes_per_pixel];
+					p += bmp_bytes_per_row;
+					sum += p[0] + p[bmp_bytes_per_pixel] + p[2*bmp_bytes_per_pixel];
+					dst[c] = (jab_byte)((jab_float)sum / 9.0f + 0.5f);
+				}
 			}
-			for(jab_int32 c=0; c<matrix->channel_count; c++)
+			else
 			{
-				//get the average of pixel values in 3x3 neighborhood as the sampled value
-				jab_float sum = 0;
-				for(jab_int32 dx=-1; dx<=1; dx++)
+				if(mx < 0 || mx > bitmap->width-1)
+				{
+					if(mx == -1) mx = 0;
+					else if(mx ==  bitmap->width) mx = bitmap->width - 1;
+					else return JAB_FAILURE;
+				}
+				if(my < 0 || my > bitmap->height-1)
+				{
+					if(my == -1) my = 0;
+					else if(my ==  bitmap->height) my = bitmap->height - 1;
+					else return JAB_FAILURE;
+				}
+				for(jab_int32 c=0; c<color_channels; c++)
 				{
-					for(jab_int32 dy=-1; dy<=1; dy++)
+					//get the average of pixel values in 3x3 neighborhood as the sampled value
+					jab_int32 sum = 0;
+					for(jab_int32 dx=-1; dx<=1; dx++)
 					{
-						jab_int32 px = mapped_x + dx;
-						jab_int32 py = mapped_y + dy;
-						if(px < 0 || px > bitmap->width - 1)  px = mapped_x;
-						if(py < 0 || py > bitmap->height - 1) py = mapped_y;
-						sum += bitmap->pixel[py*bmp_bytes_per_row + px*bmp_bytes_per_pixel + c];
+						for(jab_int32 dy=-1; dy<=1; dy++)
+						{
+							jab_int32 px = mx + dx;
+							jab_int32 py = my + dy;
+							if(px < 0 || px > bitmap->width - 1)  px = mx;
+							if(py < 0 || py > bitmap->height - 1) py = my;
+							sum += bitmap->pixel[py*bmp_bytes_per_row + px*bmp_bytes_per_pixel + c];
+						}
 					}
+					dst[c] = (jab_byte)((jab_float)sum / 9.0f + 0.5f);
 				}
-				jab_byte ave = (jab_byte)(sum / 9.0f + 0.5f);
-				matrix->pixel[i*mtx_bytes_per_row + j*mtx_bytes_per_pixel + c] = ave;
-				//matrix->pixel[i*mtx_bytes_per_row + j*mtx_bytes_per_pixel + c] = bitmap->pixel[mapped_y*bmp_bytes_per_row + mapped_x*bmp_bytes_per_pixel + c];
+			}
+			for(jab_int32 c=color_channels; c<matrix->channel_count; c++)
+			{
+				dst[c] = 255;
+			}
 #if TEST_MODE
-				test_mode_bitmap->pixel[mapped_y*bmp_bytes_per_row + mapped_x*bmp_bytes_per_pixel + c] = test_mode_color;
-				if(c == 3 && test_mode_color == 0)
-                    test_mode_bitmap->pixel[mapped_y*bmp_bytes_per_row + mapped_x*bmp_bytes_per_pixel + c] = 255;
-#endif
+			if(offset_x == 0)
+			{
+				for(jab_int32 c=0; c<matrix->channel_count; c++)
+				{
+					test_mode_bitmap->pixel[my*bmp_bytes_per_row + mx*bmp_bytes_per_pixel + c] = test_mode_color;
+					if(c == 3 && test_mode_color == 0)
+						test_mode_bitmap->pixel[my*bmp_bytes_per_row + mx*bmp_bytes_per_pixel + c] = 255;
+				}
 			}
+#endif
 		}
-    }
+	}
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Sample a symbol
+ * @param bitmap the image bitmap
+ * @param pt the transformation matrix
+ * @param side_size the symbol size in module
+ * @return the sampled symbol matrix
+*/
+jab_bitmap* sampleSymbol(jab_bitmap* bitmap, jab_perspective_transform* pt, jab_vector2d side_size)
+{
+	DECODE_STATS_START(start)
+	jab_int32 mtx_bytes_per_pixel = bitmap->bits_per_pixel / 8;
+	jab_bitmap* matrix = (jab_bitmap*)scratchMalloc(sizeof(jab_bitmap) + side_size.x*side_size.y*mtx_bytes_per_pixel*sizeof(jab_byte));
+	if(matrix == NULL)
+	{
+		reportError("Memory allocation for symbol bitmap matrix failed");
+		return NULL;
+	}
+	matrix->channel_count = bitmap->channel_count;
+	matrix->bits_per_channel = bitmap->bits_per_channel;
+	matrix->bits_per_pixel = matrix->bits_per_channel * matrix->channel_count;
+	matrix->width = side_size.x;
+	matrix->height= side_size.y;
+
+	if(!sampleModules(bitmap, pt, matrix, 0))
+	{
+		scratchFree(matrix);
+		return NULL;
+	}
+	DECODE_STATS_STOP(start, sample_time)
 	return matrix;
 }
 
@@ -110,8 +170,7 @@ jab_bitmap* sampleSymbol(jab_bitmap* bitmap, jab_perspective_transform* pt, jab_
 jab_bitmap* sampleCrossArea(jab_bitmap* bitmap, jab_perspective_transform* pt)
 {
 	jab_int32 mtx_bytes_per_pixel = bitmap->bits_per_pixel / 8;
-	jab_int32 mtx_bytes_per_row = SAMPLE_AREA_WIDTH * mtx_bytes_per_pixel;
-	jab_bitmap* matrix = (jab_bitmap*)malloc(sizeof(jab_bitmap) + SAMPLE_AREA_WIDTH*SAMPLE_AREA_HEIGHT*mtx_bytes_per_pixel*sizeof(jab_byte));
+	jab_bitmap* matrix = (jab_bitmap*)scratchMalloc(sizeof(jab_bitmap) + SAMPLE_AREA_WIDTH*SAMPLE_AREA_HEIGHT*mtx_bytes_per_pixel*sizeof(jab_byte));
 	if(matrix == NULL)
 	{
 		reportError("Memory allocation for cross area bitmap matrix failed");
@@ -123,56 +182,11 @@ jab_bitmap* sampleCrossArea(jab_bitmap* bitmap, jab_perspective_transform* pt)
 	matrix->width = SAMPLE_AREA_WIDTH;
 	matrix->height= SAMPLE_AREA_HEIGHT;
 
-	jab_int32 bmp_bytes_per_pixel = bitmap->bits_per_pixel / 8;
-	jab_int32 bmp_bytes_per_row = bitmap->width * bmp_bytes_per_pixel;
-
 	//only sample the area where the metadata and palette are located
-	jab_point points[SAMPLE_AREA_WIDTH];
-    for(jab_int32 i=0; i<SAMPLE_AREA_HEIGHT; i++)
-    {
-		for(jab_int32 j=0; j<SAMPLE_AREA_WIDTH; j++)
-		{
-			points[j].x = (jab_float)j + CROSS_AREA_WIDTH / 2 + 0.5f;
-			points[j].y = (jab_float)i + 0.5f;
-		}
-		warpPoints(pt, points, SAMPLE_AREA_WIDTH);
-		for(jab_int32 j=0; j<SAMPLE_AREA_WIDTH; j++)
-		{
-			jab_int32 mapped_x = (jab_int32)points[j].x;
-			jab_int32 mapped_y = (jab_int32)points[j].y;
-			if(mapped_x < 0 || mapped_x > bitmap->width-1)
-			{
-				if(mapped_x == -1) mapped_x = 0;
-				else if(mapped_x ==  bitmap->width) mapped_x = bitmap->width - 1;
-				else return NULL;
-			}
-			if(mapped_y < 0 || mapped_y > bitmap->height-1)
-			{
-				if(mapped_y == -1) mapped_y = 0;
-				else if(mapped_y ==  bitmap->height) mapped_y = bitmap->height - 1;
-				else return NULL;
-			}
-			for(jab_int32 c=0; c<matrix->channel_count; c++)
-			{
-				//get the average of pixel values in 3x3 neighborhood as the sampled value
-				jab_float sum = 0;
-				for(jab_int32 dx=-1; dx<=1; dx++)
-				{
-					for(jab_int32 dy=-1; dy<=1; dy++)
-					{
-						jab_int32 px = mapped_x + dx;
-						jab_int32 py = mapped_y + dy;
-						if(px < 0 || px > bitmap->width - 1)  px = mapped_x;
-						if(py < 0 || py > bitmap->height - 1) py = mapped_y;
-						sum += bitmap->pixel[py*bmp_bytes_per_row + px*bmp_bytes_per_pixel + c];
-					}
-				}
-				jab_byte ave = (jab_byte)(sum / 9.0f + 0.5f);
-				matrix->pixel[i*mtx_bytes_per_row + j*mtx_bytes_per_pixel + c] = ave;
-				//matrix->pixel[i*mtx_bytes_per_row + j*mtx_bytes_per_pixel + c] = bitmap->pixel[mapped_y*bmp_bytes_per_row + mapped_x*bmp_bytes_per_pixel + c];
-			}
-		}
-    }
+	if(!sampleModules(bitmap, pt, matrix, CROSS_AREA_WIDTH / 2))
+	{
+		scratchFree(matrix);
+		return NULL;
+	}
 	return matrix;
 }
-
@@ -0,0 +1,144 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file scratch.c
+ * @brief Scratch memory reused between decodings
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "jabcode.h"
+#include "detector.h"
+#include "scratch.h"
+
+#define SCRATCH_HEADER_SIZE	((sizeof(jab_scratch_block) + 15) & ~(size_t)15)	//keeps the blocks aligned as by malloc
+
+/**
+ * @brief Header in front of each scratch block
+*/
+struct jab_scratch_block {
+	jab_scratch*	scratch;		//the scratch memory the block is returned to, NULL if it is returned to the heap
+	jab_scratch_block* next;		//the next released block of the same size class
+	jab_int32		size_class;
+};
+
+_Thread_local jab_scratch* decode_scratch = NULL;	//the scratch memory of the decoding running on this thread
+
+/**
+ * @brief Initialize empty scratch memory
+ * @param scratch the scratch memory
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean initScratch(jab_scratch* scratch)
+{
+	memset(scratch->free_blocks, 0, sizeof(scratch->free_blocks));
+	if(pthread_mutex_init(&scratch->lock, NULL) != 0)
+	{
+		reportError("Initializing scratch memory failed");
+		return JAB_FAILURE;
+	}
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Free the released blocks of scratch memory
+ * @param scratch the scratch memory
+ * @note No block of the scratch memory may be in use
+*/
+void releaseScratch(jab_scratch* scratch)
+{
+	for(jab_int32 i=0; i<SCRATCH_SIZE_CLASSES; i++)
+	{
+		while(scratch->free_blocks[i])
+		{
+			jab_scratch_block* block = scratch->free_blocks[i];
+			scratch->free_blocks[i] = block->next;
+			free(block);
+		}
+	}
+	pthread_mutex_destroy(&scratch->lock);
+}
+
+/**
+ * @brief Allocate a block from the scratch memory of the decoding running on this thread, or from the heap if there is none
+ * @param size the number of bytes
+ * @return the block, to be freed by scratchFree | NULL if failed
+*/
+void* scratchMalloc(size_t size)
+{
+	jab_int32 size_class = 0;
+	while(size_class < SCRATCH_SIZE_CLASSES - 1 && ((size_t)16 << size_class) < size)
+	{
+		size_class++;
+	}
+	if(((size_t)16 << size_class) < size)
+	{
+		reportError("Scratch block too large");
+		return NULL;
+	}
+	jab_scratch* scratch = decode_scratch;
+	jab_scratch_block* block = NULL;
+	if(scratch)
+	{
+		pthread_mutex_lock(&scratch->lock);
+		block = scratch->free_blocks[size_class];
+		if(block)
+			scratch->free_blocks[size_class] = block->next;
+		pthread_mutex_unlock(&scratch->lock);
+	}
+	if(block == NULL)
+	{
+		//blocks are allocated in whole size classes, so that they can serve any later request of their class
+		block = (jab_scratch_block*)malloc(SCRATCH_HEADER_SIZE + ((size_t)16 << size_class));
+		if(block == NULL)
+		{
+			reportError("Memory allocation for scratch block failed");
+			return NULL;
+		}
+		block->size_class = size_class;
+		DECODE_STATS_ADD(bytes_allocated, (jab_int64)(SCRATCH_HEADER_SIZE + ((size_t)16 << size_class)))
+	}
+	block->scratch = scratch;
+	block->next = NULL;
+	return (jab_byte*)block + SCRATCH_HEADER_SIZE;
+}
+
+/**
+ * @brief Allocate a cleared block from the scratch memory of the decoding running on this thread, or from the heap if there is none
+ * @param number the number of elements
+ * @param size the size of an element
+ * @return the block, to be freed by scratchFree | NULL if failed
+*/
+void* scratchCalloc(size_t number, size_t size)
+{
+	void* ptr = scratchMalloc(number * size);
+	if(ptr)
+		memset(ptr, 0, number * size);
+	return ptr;
+}
+
+/**
+ * @brief Return a block to the scratch memory it was allocated from, or to the heap
+ * @param ptr the block | NULL
+*/
+void scratchFree(void* ptr)
+{
+	if(ptr == NULL) return;
+	jab_scratch_block* block = (jab_scratch_block*)((jab_byte*)ptr - SCRATCH_HEADER_SIZE);
+	jab_scratch* scratch = block->scratch;
+	if(scratch == NULL)
+	{
+		free(block);
+		return;
+	}
+	pthread_mutex_lock(&scratch->lock);
+	block->next = scratch->free_blocks[block->size_class];
+	scratch->free_blocks[block->size_class] = block;
+	pthread_mutex_unlock(&scratch->lock);
+}
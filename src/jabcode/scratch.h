@@ -0,0 +1,40 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file scratch.h
+ * @brief Scratch memory reused between decodings header
+ */
+
+#ifndef JABCODE_SCRATCH_H
+#define JABCODE_SCRATCH_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define SCRATCH_SIZE_CLASSES	32		//the number of block size classes, class i holding blocks of (16 << i) bytes
+
+typedef struct jab_scratch_block jab_scratch_block;
+
+/**
+ * @brief Scratch memory keeping the released blocks of each size class for the next allocations of that class
+*/
+typedef struct jab_scratch {
+	jab_scratch_block* free_blocks[SCRATCH_SIZE_CLASSES];
+	pthread_mutex_t	lock;
+}jab_scratch;
+
+extern _Thread_local jab_scratch* decode_scratch;
+
+extern jab_boolean initScratch(jab_scratch* scratch);
+extern void releaseScratch(jab_scratch* scratch);
+extern void* scratchMalloc(size_t size);
+extern void* scratchCalloc(size_t number, size_t size);
+extern void scratchFree(void* ptr);
+
+#endif
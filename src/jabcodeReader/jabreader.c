@@ -1,8 +1,93 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <pthread.h>
+#include <glob.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "jabcode.h"
 
+#define DEFAULT_READ_THREADS	4
+#define MAX_READ_THREADS		64
+
+/**
+ * @brief List of input images
+*/
+typedef struct {
+	jab_char**	files;
+	jab_int32	count;
+	jab_int32	capacity;
+}jab_file_list;
+
+/**
+ * @brief States of a frame slot in stream mode
+*/
+typedef enum
+{
+	FRAME_FREE = 0,
+	FRAME_FILLED,
+	FRAME_DECODING,
+	FRAME_DONE
+}jab_frame_state;
+
+/**
+ * @brief Raw frame formats in stream mode, named as the pixel formats of ffmpeg
+*/
+typedef struct {
+	const jab_char*	name;
+	jab_boolean		yuv;			//set if the frame is planar YUV
+	jab_int32		format;			//jab_pixel_format or jab_yuv_format
+	jab_int32		bytes_per_pixel;//the number of bytes per pixel of packed formats
+}jab_frame_format;
+
+/**
+ * @brief Slot holding a frame from being read until its record is written
+*/
+typedef struct {
+	jab_byte*		frame;
+	jab_int32		index;			//the frame index
+	jab_frame_state	state;
+	jab_int32		status;			//the decoding status
+	jab_char*		result;			//the decoded data
+	jab_int32		length;			//the length of the decoded data
+	jab_int32		capacity;		//the size of the result buffer
+}jab_frame_slot;
+
+/**
+ * @brief Stream of raw frames read, decoded and reported in a pipeline
+*/
+typedef struct {
+	jab_frame_slot*	slots;
+	jab_int32		slot_number;
+	const jab_frame_format* format;
+	jab_int32		width;
+	jab_int32		height;
+	size_t			frame_size;
+	FILE*			records;		//the stream of the result records
+	jab_int32		next;			//the index of the next frame to be decoded
+	jab_int32		frame_number;	//the number of frames read so far
+	jab_boolean		end;			//set if no more frame will be read
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+}jab_frame_stream;
+
+/**
+ * @brief Batch of images decoded by a worker pool
+*/
+typedef struct {
+	jab_file_list*	list;
+	jab_char*		output_dir;		//the directory for decoded data, NULL to embed the data in base64
+	FILE*			records;		//the stream of the result records
+	jab_double*		latencies;		//the decoding time of each image in milliseconds
+	jab_int32		next;			//the index of the next image to be decoded
+	jab_int32		decoded;		//the number of decoded images
+	pthread_mutex_t	lock;
+}jab_read_batch;
+
 /**
  * @brief Print usage of JABCode reader
 */
@@ -12,12 +97,745 @@ void printUsage()
 	printf("jabcodeReader (Version %s Build date: %s) - Fraunhofer SIT\n\n", VERSION, BUILD_DATE);
 	printf("Usage:\n\n");
 	printf("jabcodeReader input-image(png) [--output output-file]\n");
+	printf("jabcodeReader --batch input... [--threads number] [--output-dir directory]\n");
+	printf("jabcodeReader --stream --width width --height height [--pixel-format format] [--threads number]\n");
 	printf("\n");
 	printf("--output\tOutput file for decoded data.\n");
+	printf("--batch\t\tDecode many images in one process. Each input is a\n\t\t"
+					  "directory of PNG images, a glob pattern, an image,\n\t\t"
+					  "or @list-file with one image per line. One JSON line\n\t\t"
+					  "is printed per image, followed by a summary line.\n");
+	printf("--threads\tNumber of decoding threads in batch and stream mode\n\t\t"
+						"(1-%d, default:%d).\n", MAX_READ_THREADS, DEFAULT_READ_THREADS);
+	printf("--output-dir\tDirectory for decoded data, one file per image\n\t\t"
+						  "named after the input index and the image. Without\n\t\t"
+						  "it, decoded data is embedded in the records in base64.\n");
+	printf("--stream\tDecode raw frames of fixed size read from stdin, such\n\t\t"
+					   "as rawvideo output of ffmpeg. A record is written to\n\t\t"
+					   "stdout per frame in frame order: the frame index, the\n\t\t"
+					   "status code and the data length as 4-byte big-endian\n\t\t"
+					   "integers, followed by the decoded data.\n");
+	printf("--width\t\tFrame width in stream mode.\n");
+	printf("--height\tFrame height in stream mode.\n");
+	printf("--pixel-format\tFrame pixel format in stream mode (rgba, bgra, rgb24,\n\t\t"
+							"bgr24, nv12, nv21, yuv420p, default:rgb24).\n");
 	printf("--help\t\tPrint this help.\n");
 	printf("\n");
 }
 
+/**
+ * @brief Get the current time in milliseconds
+ * @return the time
+*/
+jab_double getTimeMs()
+{
+	struct timespec t;
+	timespec_get(&t, TIME_UTC);
+	return (jab_double)t.tv_sec * 1000.0 + (jab_double)t.tv_nsec / 1000000.0;
+}
+
+/**
+ * @brief Add an image to the input list
+ * @param list the input list
+ * @param file the image file name
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean addInputFile(jab_file_list* list, const jab_char* file)
+{
+	if(list->count == list->capacity)
+	{
+		jab_int32 capacity = list->capacity > 0 ? list->capacity * 2 : 64;
+		jab_char** files = (jab_char**)realloc(list->files, capacity * sizeof(jab_char*));
+		if(files == NULL)
+		{
+			reportError("Memory allocation for input list failed");
+			return JAB_FAILURE;
+		}
+		list->files = files;
+		list->capacity = capacity;
+	}
+	list->files[list->count] = strdup(file);
+	if(list->files[list->count] == NULL)
+	{
+		reportError("Memory allocation for input list failed");
+		return JAB_FAILURE;
+	}
+	list->count++;
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Compare two file names for sorting
+*/
+int compareFileNames(const void* a, const void* b)
+{
+	return strcmp(*(jab_char* const*)a, *(jab_char* const*)b);
+}
+
+/**
+ * @brief Add the images given by an input argument to the input list
+ * @param list the input list
+ * @param input a directory, a glob pattern, an image or @list-file
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean collectInputFiles(jab_file_list* list, const jab_char* input)
+{
+	//list file with one image per line
+	if(input[0] == '@')
+	{
+		FILE* fp = fopen(input + 1, "r");
+		if(fp == NULL)
+		{
+			reportError("Can not open the list file");
+			return JAB_FAILURE;
+		}
+		jab_char* line = NULL;
+		size_t line_size = 0;
+		jab_boolean res = JAB_SUCCESS;
+		while(res && getline(&line, &line_size, fp) >= 0)
+		{
+			line[strcspn(line, "\r\n")] = 0;
+			if(line[0] != 0)
+				res = addInputFile(list, line);
+		}
+		free(line);
+		fclose(fp);
+		return res;
+	}
+
+	//directory of PNG images, sorted by name
+	struct stat st;
+	if(stat(input, &st) == 0 && S_ISDIR(st.st_mode))
+	{
+		DIR* dir = opendir(input);
+		if(dir == NULL)
+		{
+			reportError("Can not open the input directory");
+			return JAB_FAILURE;
+		}
+		jab_int32 first = list->count;
+		jab_boolean res = JAB_SUCCESS;
+		struct dirent* entry;
+		while(res && (entry = readdir(dir)) != NULL)
+		{
+			size_t length = strlen(entry->d_name);
+			if(length < 4 || strcasecmp(entry->d_name + length - 4, ".png") != 0)
+				continue;
+			jab_char path[strlen(input) + length + 2];
+			sprintf(path, "%s/%s", input, entry->d_name);
+			res = addInputFile(list, path);
+		}
+		closedir(dir);
+		qsort(list->files + first, list->count - first, sizeof(jab_char*), compareFileNames);
+		return res;
+	}
+
+	//glob pattern, or a single image if nothing matches
+	glob_t matches;
+	if(glob(input, 0, NULL, &matches) == 0)
+	{
+		jab_boolean res = JAB_SUCCESS;
+		for(size_t i=0; i<matches.gl_pathc && res; i++)
+			res = addInputFile(list, matches.gl_pathv[i]);
+		globfree(&matches);
+		return res;
+	}
+	globfree(&matches);
+	return addInputFile(list, input);
+}
+
+/**
+ * @brief Write a string as JSON string
+ * @param out the output stream
+ * @param str the string
+*/
+void writeJSONString(FILE* out, const jab_char* str)
+{
+	fputc('"', out);
+	for(const jab_byte* c=(const jab_byte*)str; *c; c++)
+	{
+		if(*c == '"' || *c == '\\')
+			fprintf(out, "\\%c", *c);
+		else if(*c < 0x20)
+			fprintf(out, "\\u%04x", *c);
+		else
+			fputc(*c, out);
+	}
+	fputc('"', out);
+}
+
+/**
+ * @brief Write data in base64
+ * @param out the output stream
+ * @param data the data
+ * @param length the data length
+*/
+void writeBase64(FILE* out, const jab_byte* data, jab_int32 length)
+{
+	static const jab_char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	for(jab_int32 i=0; i<length; i+=3)
+	{
+		jab_uint32 word = (jab_uint32)data[i] << 16;
+		if(i + 1 < length) word |= (jab_uint32)data[i+1] << 8;
+		if(i + 2 < length) word |= (jab_uint32)data[i+2];
+		fputc(table[(word >> 18) & 0x3F], out);
+		fputc(table[(word >> 12) & 0x3F], out);
+		fputc(i + 1 < length ? table[(word >> 6) & 0x3F] : '=', out);
+		fputc(i + 2 < length ? table[word & 0x3F] : '=', out);
+	}
+}
+
+/**
+ * @brief Write the decoded data of an image into the output directory
+ * @param output_dir the output directory
+ * @param index the index of the image in the batch, which keeps the names of images with the same base name apart
+ * @param file the image file name
+ * @param data the decoded data
+ * @param output_file the written file name
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean writeDecodedFile(const jab_char* output_dir, jab_int32 index, const jab_char* file, jab_data* data, jab_char* output_file)
+{
+	const jab_char* name = strrchr(file, '/');
+	name = name ? name + 1 : file;
+	size_t length = strlen(name);
+	if(length >= 4 && strcasecmp(name + length - 4, ".png") == 0)
+		length -= 4;
+	sprintf(output_file, "%s/%06d_%.*s.txt", output_dir, index, (int)length, name);
+	FILE* fp = fopen(output_file, "wb");
+	if(fp == NULL)
+	{
+		reportError("Can not open the output file");
+		return JAB_FAILURE;
+	}
+	fwrite(data->data, data->length, 1, fp);
+	fclose(fp);
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Open the record stream on stdout and move the library messages to stderr
+ * @return the record stream | NULL if failed
+*/
+FILE* openRecordStream()
+{
+	fflush(stdout);
+	FILE* records = fdopen(dup(STDOUT_FILENO), "w");
+	if(records == NULL || dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+	{
+		reportError("Can not open the record stream");
+		return NULL;
+	}
+	return records;
+}
+
+/**
+ * @brief Decode the images of a batch, each worker thread using its own decoder
+ * @param args the batch
+*/
+void* decodeBatchWorker(void* args)
+{
+	jab_read_batch* batch = (jab_read_batch*)args;
+	jab_decoder* dec = createDecoder();
+	if(dec == NULL)
+		return NULL;
+	//the batch is already decoded by the worker threads, so the slave symbols are decoded inline
+	setDecoderSlaveThreads(dec, 1);
+	for(;;)
+	{
+		pthread_mutex_lock(&batch->lock);
+		jab_int32 index = batch->next++;
+		pthread_mutex_unlock(&batch->lock);
+		if(index >= batch->list->count)
+			break;
+		jab_char* file = batch->list->files[index];
+
+		jab_double start = getTimeMs();
+		jab_int32 decode_status = 0;
+		jab_data* decoded_data = NULL;
+		jab_bitmap* bitmap = readImage(file);
+		if(bitmap)
+			decoded_data = decodeJABCodeWithDecoder(dec, bitmap, NORMAL_DECODE, &decode_status);
+		jab_double latency = getTimeMs() - start;
+
+		jab_char output_file[batch->output_dir ? strlen(batch->output_dir) + strlen(file) + 17 : 1];
+		jab_boolean written = decoded_data && batch->output_dir && writeDecodedFile(batch->output_dir, index, file, decoded_data, output_file);
+
+		pthread_mutex_lock(&batch->lock);
+		batch->latencies[index] = latency;
+		if(decoded_data)
+			batch->decoded++;
+		fprintf(batch->records, "{\"file\":");
+		writeJSONString(batch->records, file);
+		fprintf(batch->records, ",\"status\":%d,\"symbols\":%d,\"time_ms\":%.3f", decode_status, bitmap ? getDecodedSymbolNumber(dec) : 0, latency);
+		if(bitmap == NULL)
+			fprintf(batch->records, ",\"error\":\"image not readable\"");
+		if(written)
+		{
+			fprintf(batch->records, ",\"output\":");
+			writeJSONString(batch->records, output_file);
+		}
+		else if(decoded_data && batch->output_dir == NULL)
+		{
+			fprintf(batch->records, ",\"data\":\"");
+			writeBase64(batch->records, (jab_byte*)decoded_data->data, decoded_data->length);
+			fputc('"', batch->records);
+		}
+		fprintf(batch->records, "}\n");
+		pthread_mutex_unlock(&batch->lock);
+		free(bitmap);
+	}
+	destroyDecoder(dec);
+	return NULL;
+}
+
+/**
+ * @brief Compare two latencies for sorting
+*/
+int compareLatencies(const void* a, const void* b)
+{
+	jab_double x = *(const jab_double*)a;
+	jab_double y = *(const jab_double*)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Get a latency percentile with the nearest-rank method
+ * @param sorted the sorted latencies
+ * @param count the number of latencies
+ * @param percent the percentile
+ * @return the latency
+*/
+jab_double getPercentile(const jab_double* sorted, jab_int32 count, jab_double percent)
+{
+	jab_int32 rank = (jab_int32)(percent / 100.0 * count + 0.999999);
+	if(rank < 1) rank = 1;
+	if(rank > count) rank = count;
+	return sorted[rank - 1];
+}
+
+/**
+ * @brief Decode many images with a worker pool
+ * @param argc the number of arguments after --batch
+ * @param argv the arguments after --batch
+ * @return 0: all images decoded | 1: some images not decoded | 255: invalid parameters
+*/
+int decodeBatch(int argc, char *argv[])
+{
+	jab_file_list list = {0};
+	jab_int32 thread_number = DEFAULT_READ_THREADS;
+	jab_char* output_dir = NULL;
+	for(jab_int32 i=0; i<argc; i++)
+	{
+		if(0 == strcmp(argv[i], "--threads") && i + 1 < argc)
+		{
+			char* endptr;
+			thread_number = (jab_int32)strtol(argv[++i], &endptr, 10);
+			if(*endptr || thread_number < 1 || thread_number > MAX_READ_THREADS)
+			{
+				reportError("Invalid number of threads");
+				return 255;
+			}
+		}
+		else if(0 == strcmp(argv[i], "--output-dir") && i + 1 < argc)
+		{
+			output_dir = argv[++i];
+		}
+		else if(0 == strncmp(argv[i], "--", 2))
+		{
+			printf("Unknown parameter: %s\n", argv[i]);
+			return 255;
+		}
+		else if(!collectInputFiles(&list, argv[i]))
+		{
+			return 255;
+		}
+	}
+	if(list.count == 0)
+	{
+		reportError("No input image");
+		return 255;
+	}
+
+	FILE* records = openRecordStream();
+	if(records == NULL)
+	{
+		return 255;
+	}
+
+	jab_read_batch batch = {0};
+	batch.list = &list;
+	batch.output_dir = output_dir;
+	batch.records = records;
+	batch.latencies = (jab_double*)calloc(list.count, sizeof(jab_double));
+	if(batch.latencies == NULL)
+	{
+		reportError("Memory allocation for latencies failed");
+		return 255;
+	}
+	pthread_mutex_init(&batch.lock, NULL);
+
+	jab_double start = getTimeMs();
+	if(thread_number > list.count)
+		thread_number = list.count;
+	pthread_t threads[MAX_READ_THREADS];
+	jab_int32 started = 0;
+	for(jab_int32 i=0; i<thread_number; i++)
+	{
+		if(pthread_create(&threads[started], NULL, decodeBatchWorker, &batch) == 0)
+			started++;
+	}
+	if(started == 0)
+		decodeBatchWorker(&batch);
+	for(jab_int32 i=0; i<started; i++)
+		pthread_join(threads[i], NULL);
+	jab_double seconds = (getTimeMs() - start) / 1000.0;
+	pthread_mutex_destroy(&batch.lock);
+
+	//summary of throughput and latency percentiles
+	qsort(batch.latencies, list.count, sizeof(jab_double), compareLatencies);
+	fprintf(records, "{\"summary\":{\"images\":%d,\"decoded\":%d,\"threads\":%d,\"seconds\":%.3f,\"images_per_second\":%.1f,"
+					 "\"latency_ms\":{\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f}}}\n",
+			list.count, batch.decoded, thread_number, seconds, seconds > 0 ? list.count / seconds : 0.0,
+			getPercentile(batch.latencies, list.count, 50), getPercentile(batch.latencies, list.count, 90),
+			getPercentile(batch.latencies, list.count, 99), batch.latencies[list.count - 1]);
+	fclose(records);
+
+	jab_int32 ret = batch.decoded == list.count ? 0 : 1;
+	free(batch.latencies);
+	for(jab_int32 i=0; i<list.count; i++)
+		free(list.files[i]);
+	free(list.files);
+	return ret;
+}
+
+/**
+ * @brief Write a 32-bit integer in big-endian byte order
+ * @param out the output stream
+ * @param value the value
+*/
+void writeUint32BE(FILE* out, jab_uint32 value)
+{
+	jab_byte bytes[4] = {(jab_byte)(value >> 24), (jab_byte)(value >> 16), (jab_byte)(value >> 8), (jab_byte)value};
+	fwrite(bytes, 1, 4, out);
+}
+
+/**
+ * @brief Decode a raw frame
+ * @param stream the frame stream
+ * @param dec the decoder
+ * @param slot the slot holding the frame, receiving the decoded data
+*/
+void decodeFrame(jab_frame_stream* stream, jab_decoder* dec, jab_frame_slot* slot)
+{
+	jab_data* decoded_data;
+	if(stream->format->yuv)
+	{
+		jab_int32 chroma_width  = (stream->width + 1) / 2;
+		jab_int32 chroma_height = (stream->height + 1) / 2;
+		jab_yuv_view yuv;
+		memset(&yuv, 0, sizeof(jab_yuv_view));
+		yuv.width = stream->width;
+		yuv.height= stream->height;
+		yuv.format= (jab_yuv_format)stream->format->format;
+		yuv.planes[0] = slot->frame;
+		yuv.planes[1] = slot->frame + (size_t)stream->width * stream->height;
+		yuv.strides[0]= stream->width;
+		if(yuv.format == JAB_YUV_I420)
+		{
+			yuv.planes[2] = yuv.planes[1] + (size_t)chroma_width * chroma_height;
+			yuv.strides[1]= chroma_width;
+			yuv.strides[2]= chroma_width;
+		}
+		else
+		{
+			yuv.strides[1]= chroma_width * 2;
+		}
+		decoded_data = decodeJABCodeYUV(dec, &yuv, NORMAL_DECODE, &slot->status);
+	}
+	else
+	{
+		jab_bitmap_view view;
+		view.width = stream->width;
+		view.height= stream->height;
+		view.stride= stream->width * stream->format->bytes_per_pixel;
+		view.format= (jab_pixel_format)stream->format->format;
+		view.pixels= slot->frame;
+		decoded_data = decodeJABCodeView(dec, &view, NORMAL_DECODE, &slot->status);
+	}
+
+	//the decoded data is owned by the decoder, so it is kept in the slot until the record is written
+	slot->length = 0;
+	if(decoded_data)
+	{
+		if(decoded_data->length > slot->capacity)
+		{
+			jab_char* result = (jab_char*)realloc(slot->result, decoded_data->length);
+			if(result == NULL)
+			{
+				reportError("Memory allocation for decoded data failed");
+				slot->status = 1;
+				return;
+			}
+			slot->result = result;
+			slot->capacity = decoded_data->length;
+		}
+		memcpy(slot->result, decoded_data->data, decoded_data->length);
+		slot->length = decoded_data->length;
+	}
+}
+
+/**
+ * @brief Decode the frames of a stream in frame order, each worker thread using its own decoder
+ * @param args the frame stream
+*/
+void* decodeFrameWorker(void* args)
+{
+	jab_frame_stream* stream = (jab_frame_stream*)args;
+	jab_decoder* dec = createDecoder();
+	if(dec == NULL)
+		return NULL;
+	//the frames are already decoded by the worker threads, so the slave symbols are decoded inline
+	setDecoderSlaveThreads(dec, 1);
+	pthread_mutex_lock(&stream->lock);
+	for(;;)
+	{
+		//wait until the next frame is read or the stream ends
+		jab_frame_slot* slot = &stream->slots[stream->next % stream->slot_number];
+		while(!(slot->state == FRAME_FILLED && slot->index == stream->next) && !(stream->end && stream->next >= stream->frame_number))
+		{
+			pthread_cond_wait(&stream->cond, &stream->lock);
+			slot = &stream->slots[stream->next % stream->slot_number];
+		}
+		if(slot->state != FRAME_FILLED || slot->index != stream->next)
+			break;
+		stream->next++;
+		slot->state = FRAME_DECODING;
+		pthread_mutex_unlock(&stream->lock);
+
+		decodeFrame(stream, dec, slot);
+
+		pthread_mutex_lock(&stream->lock);
+		slot->state = FRAME_DONE;
+		pthread_cond_broadcast(&stream->cond);
+	}
+	pthread_mutex_unlock(&stream->lock);
+	destroyDecoder(dec);
+	return NULL;
+}
+
+/**
+ * @brief Write the records of the decoded frames in frame order
+ * @param args the frame stream
+*/
+void* writeFrameRecords(void* args)
+{
+	jab_frame_stream* stream = (jab_frame_stream*)args;
+	pthread_mutex_lock(&stream->lock);
+	for(jab_int32 index=0; ; index++)
+	{
+		jab_frame_slot* slot = &stream->slots[index % stream->slot_number];
+		while(!(slot->state == FRAME_DONE && slot->index == index) && !(stream->end && index >= stream->frame_number))
+			pthread_cond_wait(&stream->cond, &stream->lock);
+		if(slot->state != FRAME_DONE || slot->index != index)
+			break;
+		pthread_mutex_unlock(&stream->lock);
+
+		writeUint32BE(stream->records, (jab_uint32)index);
+		writeUint32BE(stream->records, (jab_uint32)slot->status);
+		writeUint32BE(stream->records, (jab_uint32)slot->length);
+		fwrite(slot->result, 1, slot->length, stream->records);
+		fflush(stream->records);
+
+		pthread_mutex_lock(&stream->lock);
+		slot->state = FRAME_FREE;
+		pthread_cond_broadcast(&stream->cond);
+	}
+	pthread_mutex_unlock(&stream->lock);
+	return NULL;
+}
+
+/**
+ * @brief Decode raw frames read from stdin in a pipeline, reading, decoding and writing the records concurrently
+ * @param argc the number of arguments after --stream
+ * @param argv the arguments after --stream
+ * @return 0: success | 1: the stream ends with an incomplete frame | 255: invalid parameters
+*/
+int decodeStream(int argc, char *argv[])
+{
+	static const jab_frame_format formats[] = {
+		{"rgba",	0, JAB_PIXEL_RGBA, 4},
+		{"bgra",	0, JAB_PIXEL_BGRA, 4},
+		{"rgb24",	0, JAB_PIXEL_RGB,  3},
+		{"bgr24",	0, JAB_PIXEL_BGR,  3},
+		{"nv12",	1, JAB_YUV_NV12,   0},
+		{"nv21",	1, JAB_YUV_NV21,   0},
+		{"yuv420p",	1, JAB_YUV_I420,   0}
+	};
+	jab_frame_stream stream;
+	memset(&stream, 0, sizeof(jab_frame_stream));
+	stream.format = &formats[2];
+	jab_int32 thread_number = DEFAULT_READ_THREADS;
+	for(jab_int32 i=0; i<argc; i++)
+	{
+		if(i + 1 >= argc)
+		{
+			printf("Value for option '%s' missing.\n", argv[i]);
+			return 255;
+		}
+		char* endptr;
+		if(0 == strcmp(argv[i], "--width"))
+		{
+			stream.width = (jab_int32)strtol(argv[++i], &endptr, 10);
+			if(*endptr || stream.width <= 0 || stream.width > 32768)
+			{
+				reportError("Invalid frame width");
+				return 255;
+			}
+		}
+		else if(0 == strcmp(argv[i], "--height"))
+		{
+			stream.height = (jab_int32)strtol(argv[++i], &endptr, 10);
+			if(*endptr || stream.height <= 0 || stream.height > 32768)
+			{
+				reportError("Invalid frame height");
+				return 255;
+			}
+		}
+		else if(0 == strcmp(argv[i], "--pixel-format"))
+		{
+			i++;
+			stream.format = NULL;
+			for(jab_int32 j=0; j<(jab_int32)(sizeof(formats)/sizeof(formats[0])); j++)
+			{
+				if(0 == strcmp(argv[i], formats[j].name))
+					stream.format = &formats[j];
+			}
+			if(stream.format == NULL)
+			{
+				reportError("Unknown pixel format");
+				return 255;
+			}
+		}
+		else if(0 == strcmp(argv[i], "--threads"))
+		{
+			thread_number = (jab_int32)strtol(argv[++i], &endptr, 10);
+			if(*endptr || thread_number < 1 || thread_number > MAX_READ_THREADS)
+			{
+				reportError("Invalid number of threads");
+				return 255;
+			}
+		}
+		else
+		{
+			printf("Unknown parameter: %s\n", argv[i]);
+			return 255;
+		}
+	}
+	if(stream.width == 0 || stream.height == 0)
+	{
+		reportError("Frame width and height missing");
+		return 255;
+	}
+	if(stream.format->yuv)
+		stream.frame_size = (size_t)stream.width * stream.height + 2 * (size_t)((stream.width + 1) / 2) * ((stream.height + 1) / 2);
+	else
+		stream.frame_size = (size_t)stream.width * stream.height * stream.format->bytes_per_pixel;
+
+	//two spare slots let the next frames be read while all workers are busy and the oldest record is written
+	stream.slot_number = thread_number + 2;
+	stream.slots = (jab_frame_slot*)calloc(stream.slot_number, sizeof(jab_frame_slot));
+	if(stream.slots == NULL)
+	{
+		reportError("Memory allocation for frame slots failed");
+		return 255;
+	}
+	for(jab_int32 i=0; i<stream.slot_number; i++)
+	{
+		stream.slots[i].index = -1;
+		stream.slots[i].frame = (jab_byte*)malloc(stream.frame_size);
+		if(stream.slots[i].frame == NULL)
+		{
+			reportError("Memory allocation for frame slots failed");
+			for(jab_int32 j=0; j<i; j++)
+				free(stream.slots[j].frame);
+			free(stream.slots);
+			return 255;
+		}
+	}
+	stream.records = openRecordStream();
+	if(stream.records == NULL)
+	{
+		for(jab_int32 i=0; i<stream.slot_number; i++)
+			free(stream.slots[i].frame);
+		free(stream.slots);
+		return 255;
+	}
+	pthread_mutex_init(&stream.lock, NULL);
+	pthread_cond_init(&stream.cond, NULL);
+
+	pthread_t writer;
+	pthread_t workers[MAX_READ_THREADS];
+	jab_int32 started = 0;
+	jab_boolean writer_started = (pthread_create(&writer, NULL, writeFrameRecords, &stream) == 0);
+	for(jab_int32 i=0; i<thread_number && writer_started; i++)
+	{
+		if(pthread_create(&workers[started], NULL, decodeFrameWorker, &stream) == 0)
+			started++;
+	}
+	jab_int32 ret = 0;
+	if(!writer_started || started == 0)
+	{
+		reportError("Starting stream threads failed");
+		ret = 255;
+	}
+
+	//read the frames into free slots in frame order
+	while(ret == 0)
+	{
+		jab_frame_slot* slot = &stream.slots[stream.frame_number % stream.slot_number];
+		pthread_mutex_lock(&stream.lock);
+		while(slot->state != FRAME_FREE)
+			pthread_cond_wait(&stream.cond, &stream.lock);
+		pthread_mutex_unlock(&stream.lock);
+
+		size_t read = fread(slot->frame, 1, stream.frame_size, stdin);
+		if(read < stream.frame_size)
+		{
+			if(read > 0)
+			{
+				reportError("The stream ends with an incomplete frame");
+				ret = 1;
+			}
+			break;
+		}
+		pthread_mutex_lock(&stream.lock);
+		slot->index = stream.frame_number++;
+		slot->state = FRAME_FILLED;
+		pthread_cond_broadcast(&stream.cond);
+		pthread_mutex_unlock(&stream.lock);
+	}
+	pthread_mutex_lock(&stream.lock);
+	stream.end = 1;
+	pthread_cond_broadcast(&stream.cond);
+	pthread_mutex_unlock(&stream.lock);
+
+	for(jab_int32 i=0; i<started; i++)
+		pthread_join(workers[i], NULL);
+	if(writer_started)
+		pthread_join(writer, NULL);
+	pthread_cond_destroy(&stream.cond);
+	pthread_mutex_destroy(&stream.lock);
+	fclose(stream.records);
+	for(jab_int32 i=0; i<stream.slot_number; i++)
+	{
+		free(stream.slots[i].frame);
+		free(stream.slots[i].result);
+	}
+	free(stream.slots);
+	return ret;
+}
+
 /**
  * @brief JABCode reader main function
  * @return 0: success | 255: not detectable | other non-zero: decoding failed
@@ -29,6 +847,14 @@ int main(int argc, char *argv[])
 		printUsage();
 		return 255;
 	}
+	if(0 == strcmp(argv[1], "--batch"))
+	{
+		return decodeBatch(argc - 2, argv + 2);
+	}
+	if(0 == strcmp(argv[1], "--stream"))
+	{
+		return decodeStream(argc - 2, argv + 2);
+	}
 
 	jab_boolean output_as_file = 0;
 	if(argc > 2)
@@ -1,6 +1,11 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include "jabcode.h"
 #include "jabwriter.h"
 
@@ -18,6 +23,11 @@ jab_int32 		symbol_versions_number = 0;
 jab_int32* 		symbol_ecc_levels = 0;
 jab_int32 		symbol_ecc_levels_number = 0;
 jab_int32		color_space = 0;
+jab_int32		compression_level = -1;
+jab_char*		batch_input = 0;
+jab_int32		batch_format = 0;
+jab_int32		thread_number = 0;
+jab_boolean		print_stats = 0;
 
 /**
  * @brief Print usage of JABCode writer
@@ -49,6 +59,17 @@ void printUsage()
 							  "multi-symbol code.\n");
 	printf("--color-space\t\tColor space of output image (0:RGB,1:CMYK,default:0).\n\t\t\t"
 							"RGB image is saved as PNG and CMYK image as TIFF.\n");
+	printf("--compression-level\tCompression level of PNG image (0-9, default:6).\n");
+	printf("--batch-lines\t\tBatch input file with one message per non-empty line\n\t\t\t"
+							"(- for stdin).\n");
+	printf("--batch-records\t\tBatch input file of records, each a 4-byte big-endian\n\t\t\t"
+							"length followed by the message (- for stdin).\n");
+	printf("--batch-dir\t\tBatch input directory, each file being one message,\n\t\t\t"
+							"taken in the order of file names.\n");
+	printf("--threads\t\tNumber of encoding threads in batch mode (1-%d,\n\t\t\t"
+							"default:%d).\n", MAX_ENCODE_THREADS, DEFAULT_ENCODE_THREADS);
+	printf("--stats\t\t\tPrint the time of each encoding stage and the chosen\n\t\t\t"
+							"symbol parameters (single code only).\n");
     printf("--help\t\t\tPrint this help.\n");
     printf("\n");
     printf("Example for 1-symbol-code: \n");
@@ -57,6 +78,68 @@ void printUsage()
     printf("Example for 3-symbol-code: \n" );
     printf("jabcodeWriter --input 'Hello world' --output test.png --symbol-number 3 --symbol-position 0 3 2 --symbol-version 3 2 4 2 3 2\n");
     printf("\n");
+    printf("Example for batch mode, the output file name containing one %%d conversion for the message index: \n" );
+    printf("jabcodeWriter --batch-lines messages.txt --output code_%%06d.png --threads 8\n");
+    printf("\n");
+}
+
+/**
+ * @brief Check if an output file name pattern contains exactly one %d conversion with an optional zero-padded width
+ * @param pattern the output file name pattern
+ * @return 1: valid | 0: invalid
+*/
+jab_boolean checkOutputPattern(jab_char* pattern)
+{
+	jab_int32 conversions = 0;
+	for(jab_char* c=pattern; *c; c++)
+	{
+		if(*c != '%')
+			continue;
+		c++;
+		if(*c == '%')
+			continue;
+		while(*c >= '0' && *c <= '9')
+			c++;
+		if(*c != 'd')
+			return 0;
+		conversions++;
+	}
+	return conversions == 1;
+}
+
+/**
+ * @brief Read a whole file
+ * @param path the file name
+ * @return the file content | NULL if failed
+*/
+jab_data* readDataFile(jab_char* path)
+{
+	FILE* fp = fopen(path, "rb");
+	if(!fp)
+	{
+		reportError("Opening input data file failed");
+		return NULL;
+	}
+	fseek(fp, 0, SEEK_END);
+	jab_int32 file_size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	jab_data* payload = (jab_data *)malloc(sizeof(jab_data) + file_size * sizeof(jab_char));
+	if(!payload)
+	{
+		reportError("Memory allocation for input data failed");
+		fclose(fp);
+		return NULL;
+	}
+	if(fread(payload->data, 1, file_size, fp) != (size_t)file_size)
+	{
+		reportError("Reading input data file failed");
+		free(payload);
+		fclose(fp);
+		return NULL;
+	}
+	fclose(fp);
+	payload->length = file_size;
+	return payload;
 }
 
 /**
@@ -93,32 +176,12 @@ jab_boolean parseCommandLineParameters(jab_int32 para_number, jab_char* para[])
 				printf("Value for option '%s' missing.\n", para[loop]);
 				return 0;
 			}
-            FILE* fp = fopen(para[++loop], "rb");
-            if(!fp)
-            {
-				reportError("Opening input data file failed");
-                return 0;
-            }
-			jab_int32 file_size;
-			fseek(fp, 0, SEEK_END);
-			file_size = ftell(fp);
 			if(data) free(data);
-            data = (jab_data *)malloc(sizeof(jab_data) + file_size * sizeof(jab_char));
-            if(!data)
-            {
-                reportError("Memory allocation for input data failed");
-                return 0;
-            }
-            fseek(fp, 0, SEEK_SET);
-            if(fread(data->data, 1, file_size, fp) != file_size)
-            {
-				reportError("Reading input data file failed");
-				free(data);
-				fclose(fp);
+			data = readDataFile(para[++loop]);
+			if(!data)
+			{
 				return 0;
 			}
-			fclose(fp);
-			data->length = file_size;
         }
 		else if (0 == strcmp(para[loop],"--output"))
         {
@@ -239,11 +302,80 @@ jab_boolean parseCommandLineParameters(jab_int32 para_number, jab_char* para[])
 				reportError("Invalid color space (must be 0 or 1).");
 				return 0;
             }
+        }
+		else if (0 == strcmp(para[loop],"--batch-lines") || 0 == strcmp(para[loop],"--batch-records") || 0 == strcmp(para[loop],"--batch-dir"))
+		{
+			if(loop + 1 > para_number - 1)
+			{
+				printf("Value for option '%s' missing.\n", para[loop]);
+				return 0;
+			}
+			if(0 == strcmp(para[loop],"--batch-lines"))
+				batch_format = BATCH_LINES;
+			else if(0 == strcmp(para[loop],"--batch-records"))
+				batch_format = BATCH_RECORDS;
+			else
+				batch_format = BATCH_DIRECTORY;
+			batch_input = para[++loop];
+		}
+		else if (0 == strcmp(para[loop],"--stats"))
+		{
+			print_stats = 1;
+		}
+		else if (0 == strcmp(para[loop],"--threads"))
+		{
+        	char* option = para[loop];
+			if(loop + 1 > para_number - 1)
+			{
+				printf("Value for option '%s' missing.\n", option);
+                return 0;
+			}
+			char* endptr;
+			thread_number = strtol(para[++loop], &endptr, 10);
+            if(*endptr)
+			{
+				printf("Invalid or missing values for option '%s'.\n", option);
+				return 0;
+			}
+            if(thread_number < 1 || thread_number > MAX_ENCODE_THREADS)
+            {
+				reportError("Invalid number of threads.");
+				return 0;
+            }
+        }
+		else if (0 == strcmp(para[loop],"--compression-level"))
+		{
+        	char* option = para[loop];
+			if(loop + 1 > para_number - 1)
+			{
+				printf("Value for option '%s' missing.\n", option);
+                return 0;
+			}
+			char* endptr;
+			compression_level = strtol(para[++loop], &endptr, 10);
+            if(*endptr)
+			{
+				printf("Invalid or missing values for option '%s'.\n", option);
+				return 0;
+			}
+            if(compression_level < 0 || compression_level > 9)
+            {
+				reportError("Invalid compression level (must be 0 - 9).");
+				return 0;
+            }
         }
 	}
 
 	//check input
-    if(!data)
+	if(batch_input)
+	{
+		if(data)
+		{
+			reportError("Input data can not be given in batch mode");
+			return 0;
+		}
+	}
+    else if(!data)
     {
 		reportError("Input data missing");
 		return 0;
@@ -258,6 +390,11 @@ jab_boolean parseCommandLineParameters(jab_int32 para_number, jab_char* para[])
 		reportError("Output file missing");
 		return 0;
     }
+    if(batch_input && !checkOutputPattern(filename))
+    {
+		reportError("Output file name in batch mode must contain one %d conversion for the message index");
+		return 0;
+    }
     if(symbol_number == 0)
     {
 		symbol_number = 1;
@@ -423,28 +560,16 @@ void cleanMemory()
 }
 
 /**
- * @brief JABCode writer main function
- * @return 0: success | 1: failure
+ * @brief Create the encode parameter object from the command line parameters
+ * @return the encode parameter object | NULL if failed
 */
-int main(int argc, char *argv[])
+jab_encode* createEncodeFromParameters()
 {
-    if(argc < 2 || (0 == strcmp(argv[1],"--help")))
-	{
-		printUsage();
-		return 1;
-	}
-	if(!parseCommandLineParameters(argc, argv))
-	{
-		return 1;
-	}
-
-    //create encode parameter object
     jab_encode* enc = createEncode(color_number, symbol_number);
     if(enc == NULL)
     {
-		cleanMemory();
 		reportError("Creating encode parameter failed");
-        return 1;
+        return NULL;
     }
     if(module_size > 0)
     {
@@ -467,37 +592,380 @@ int main(int argc, char *argv[])
 		if(symbol_positions)
 			enc->symbol_positions[loop] = symbol_positions[loop];
 	}
+	return enc;
+}
 
-	//generate JABCode
-	if(generateJABCode(enc, data) != 0)
-	{
-		reportError("Creating jab code failed");
-		destroyEncode(enc);
-		cleanMemory();
-		return 1;
-	}
-
-	//save bitmap in image file
-	jab_int32 result = 0;
+/**
+ * @brief Save the generated code matrix in an image file
+ * @param enc the encode parameter object holding the code matrix
+ * @param output the output file name
+ * @return 1: success | 0: failure
+*/
+jab_boolean saveCode(jab_encode* enc, jab_char* output)
+{
 	if(color_space == 0)
 	{
-		if(!saveImage(enc->bitmap, filename))
+		jab_png_options options = {compression_level, 0, 0};
+		if(!saveImagePalette(enc->code_matrix, &options, output))
 		{
 			reportError("Saving png image failed");
-			result = 1;
+			return 0;
 		}
 	}
 	else if(color_space == 1)
 	{
-		if(!saveImageCMYK(enc->bitmap, 0, filename))
+		if(!saveImageCMYKFromMatrix(enc->code_matrix, output))
 		{
 			reportError("Saving tiff image failed");
-			result = 1;
+			return 0;
 		}
 	}
+	return 1;
+}
+
+/**
+ * @brief Print the encoding stats
+ * @param stats the encoding stats
+ * @param save_time the time of writing the image in milliseconds
+*/
+void printEncodeStats(jab_encode_stats* stats, jab_double save_time)
+{
+	printf("Encoding stages (ms):\n");
+	printf("  analyze input data\t%.3f\n", stats->analyze_time);
+	printf("  encode data\t\t%.3f\n", stats->encode_time);
+	printf("  fit data into symbols\t%.3f\n", stats->fit_time);
+	printf("  LDPC encoding\t\t%.3f\n", stats->ldpc_time);
+	for(jab_int32 i=0; i<stats->symbol_number; i++)
+		printf("    symbol %d\t\t%.3f\n", i, stats->symbol_ldpc_time[i]);
+	printf("  interleave data\t%.3f\n", stats->interleave_time);
+	printf("  create matrix\t\t%.3f\n", stats->matrix_time);
+	printf("  mask code\t\t%.3f\n", stats->mask_time);
+	printf("  create code matrix\t%.3f\n", stats->bitmap_time);
+	printf("  total\t\t\t%.3f\n", stats->total_time);
+	printf("  save image\t\t%.3f\n", save_time);
+	printf("Mask patterns:\n");
+	for(jab_int32 t=0; t<NUMBER_OF_MASK_PATTERNS; t++)
+	{
+		if(stats->mask_scores[t] < 0)
+			printf("  %d\tnot evaluated%s\n", t, t == stats->mask_reference ? " (chosen)" : "");
+		else
+			printf("  %d\tpenalty %d, %.3f ms%s\n", t, stats->mask_scores[t], stats->mask_times[t], t == stats->mask_reference ? " (chosen)" : "");
+	}
+	printf("Code: %d colors, %d symbols, %dx%d modules, %d encoded bits\n", stats->color_number, stats->symbol_number, stats->code_size.x, stats->code_size.y, stats->encoded_length);
+	for(jab_int32 i=0; i<stats->symbol_number; i++)
+	{
+		printf("  symbol %d\tside version %dx%d, ecc level %d (wc %d, wr %d), capacity %d bits\n", i,
+				stats->symbol_versions[i].x, stats->symbol_versions[i].y, stats->symbol_ecc_levels[i],
+				stats->symbol_wcwr[i][0], stats->symbol_wcwr[i][1], stats->symbol_capacity[i]);
+	}
+}
+
+/**
+ * @brief Compare two file names for sorting
+*/
+int compareFileNames(const void* a, const void* b)
+{
+	return strcmp(*(jab_char* const*)a, *(jab_char* const*)b);
+}
+
+/**
+ * @brief List the regular files of a directory in the order of file names
+ * @param dir_name the directory
+ * @param files the file names
+ * @param file_number the number of files
+ * @return 1: success | 0: failure
+*/
+jab_boolean listDataFiles(jab_char* dir_name, jab_char*** files, jab_int32* file_number)
+{
+	DIR* dir = opendir(dir_name);
+	if(dir == NULL)
+	{
+		reportError("Opening batch input directory failed");
+		return 0;
+	}
+	jab_int32 capacity = 0;
+	*files = NULL;
+	*file_number = 0;
+	struct dirent* entry;
+	while((entry = readdir(dir)) != NULL)
+	{
+		jab_char* path = (jab_char*)malloc(strlen(dir_name) + strlen(entry->d_name) + 2);
+		if(path == NULL)
+			break;
+		sprintf(path, "%s/%s", dir_name, entry->d_name);
+		struct stat st;
+		if(stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+		{
+			free(path);
+			continue;
+		}
+		if(*file_number == capacity)
+		{
+			capacity = capacity > 0 ? capacity * 2 : 64;
+			jab_char** tmp = (jab_char**)realloc(*files, capacity * sizeof(jab_char*));
+			if(tmp == NULL)
+			{
+				free(path);
+				break;
+			}
+			*files = tmp;
+		}
+		(*files)[(*file_number)++] = path;
+	}
+	jab_boolean complete = (entry == NULL);
+	closedir(dir);
+	if(!complete)
+	{
+		reportError("Memory allocation for batch input list failed");
+		return 0;
+	}
+	qsort(*files, *file_number, sizeof(jab_char*), compareFileNames);
+	return 1;
+}
+
+/**
+ * @brief Read the next message of the batch input
+ * @param source the batch input source
+ * @param error set if reading failed
+ * @return the message | NULL if no message is left or reading failed
+*/
+jab_data* readNextMessage(jab_batch_source* source, jab_boolean* error)
+{
+	*error = 0;
+	if(batch_format == BATCH_DIRECTORY)
+	{
+		if(source->next_file >= source->file_number)
+			return NULL;
+		jab_data* payload = readDataFile(source->files[source->next_file++]);
+		if(payload == NULL)
+			*error = 1;
+		return payload;
+	}
+	if(batch_format == BATCH_RECORDS)
+	{
+		jab_byte prefix[4];
+		size_t read = fread(prefix, 1, 4, source->fp);
+		if(read == 0 && feof(source->fp))
+			return NULL;
+		if(read != 4)
+		{
+			reportError("Reading batch record length failed");
+			*error = 1;
+			return NULL;
+		}
+		jab_uint32 length = ((jab_uint32)prefix[0] << 24) | ((jab_uint32)prefix[1] << 16) | ((jab_uint32)prefix[2] << 8) | (jab_uint32)prefix[3];
+		if(length > 0x7FFFFFFF - sizeof(jab_data))
+		{
+			reportError("Invalid batch record length");
+			*error = 1;
+			return NULL;
+		}
+		jab_data* payload = (jab_data *)malloc(sizeof(jab_data) + length * sizeof(jab_char));
+		if(!payload)
+		{
+			reportError("Memory allocation for input data failed");
+			*error = 1;
+			return NULL;
+		}
+		if(fread(payload->data, 1, length, source->fp) != length)
+		{
+			reportError("Reading batch record failed");
+			free(payload);
+			*error = 1;
+			return NULL;
+		}
+		payload->length = length;
+		return payload;
+	}
+	//one message per non-empty line
+	for(;;)
+	{
+		ssize_t length = getline(&source->line, &source->line_size, source->fp);
+		if(length < 0)
+			return NULL;
+		while(length > 0 && (source->line[length-1] == '\n' || source->line[length-1] == '\r'))
+			length--;
+		if(length == 0)
+			continue;
+		jab_data* payload = (jab_data *)malloc(sizeof(jab_data) + length * sizeof(jab_char));
+		if(!payload)
+		{
+			reportError("Memory allocation for input data failed");
+			*error = 1;
+			return NULL;
+		}
+		memcpy(payload->data, source->line, length);
+		payload->length = length;
+		return payload;
+	}
+}
+
+/**
+ * @brief Save each code generated in batch mode, called concurrently from the encoding threads
+ * @param index the index of the message in the current chunk
+ * @param status the return value of generateJABCodeMatrix
+ * @param enc the encode parameter object holding the code matrix
+ * @param user_data the batch input source
+ * @return 1 to continue
+*/
+jab_boolean saveBatchCode(jab_int32 index, jab_int32 status, jab_encode* enc, void* user_data)
+{
+	jab_batch_source* source = (jab_batch_source*)user_data;
+	jab_int32 message_index = source->offset + index;
+	jab_boolean saved = 0;
+	if(status == 0)
+	{
+		//the width of the conversion is not limited, so the file name is sized by a first formatting pass
+		jab_int32 length = snprintf(NULL, 0, filename, message_index);
+		jab_char* output = (length < 0) ? NULL : (jab_char *)malloc(length + 1);
+		if(output && snprintf(output, length + 1, filename, message_index) == length)
+		{
+			saved = saveCode(enc, output);
+		}
+		else
+		{
+			JAB_REPORT_ERROR(("Creating the output file name for message %d failed", message_index))
+		}
+		free(output);
+	}
+	else
+	{
+		JAB_REPORT_ERROR(("Creating jab code for message %d failed", message_index))
+	}
+	if(saved)
+	{
+		pthread_mutex_lock(&source->lock);
+		source->saved++;
+		pthread_mutex_unlock(&source->lock);
+	}
+	return 1;
+}
+
+/**
+ * @brief Encode the messages of the batch input in chunks on multiple threads
+ * @return 0: success | 1: failure
+*/
+jab_int32 encodeBatch()
+{
+	jab_batch_source source;
+	memset(&source, 0, sizeof(jab_batch_source));
+	if(batch_format == BATCH_DIRECTORY)
+	{
+		if(!listDataFiles(batch_input, &source.files, &source.file_number))
+			return 1;
+	}
+	else
+	{
+		source.fp = (0 == strcmp(batch_input, "-")) ? stdin : fopen(batch_input, "rb");
+		if(source.fp == NULL)
+		{
+			reportError("Opening batch input file failed");
+			return 1;
+		}
+	}
+	jab_encode* enc = createEncodeFromParameters();
+	jab_data** chunk = (jab_data**)malloc(BATCH_CHUNK_SIZE * sizeof(jab_data*));
+	if(enc == NULL || chunk == NULL)
+	{
+		reportError("Memory allocation for batch failed");
+		destroyEncode(enc);
+		free(chunk);
+		return 1;
+	}
+	pthread_mutex_init(&source.lock, NULL);
+
+	struct timespec start, end;
+	timespec_get(&start, TIME_UTC);
+	jab_boolean error = 0;
+	while(!error)
+	{
+		//read a chunk of messages, which bounds the memory for an input of any size
+		jab_int32 count = 0;
+		while(count < BATCH_CHUNK_SIZE)
+		{
+			jab_data* payload = readNextMessage(&source, &error);
+			if(payload == NULL)
+				break;
+			chunk[count++] = payload;
+		}
+		if(count > 0)
+			generateJABCodeMatrixBatch(enc, chunk, count, thread_number, saveBatchCode, &source, NULL);
+		for(jab_int32 i=0; i<count; i++)
+			free(chunk[i]);
+		source.offset += count;
+		if(count < BATCH_CHUNK_SIZE)
+			break;
+	}
+	timespec_get(&end, TIME_UTC);
+	jab_double seconds = (jab_double)(end.tv_sec - start.tv_sec) + (jab_double)(end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%d of %d codes generated in %.3f seconds (%.1f codes per second)\n", source.saved, source.offset, seconds, seconds > 0 ? source.saved / seconds : 0.0);
+
+	pthread_mutex_destroy(&source.lock);
+	if(source.fp && source.fp != stdin)
+		fclose(source.fp);
+	for(jab_int32 i=0; i<source.file_number; i++)
+		free(source.files[i]);
+	free(source.files);
+	free(source.line);
+	free(chunk);
+	destroyEncode(enc);
+	return (error || source.saved != source.offset) ? 1 : 0;
+}
+
+/**
+ * @brief JABCode writer main function
+ * @return 0: success | 1: failure
+*/
+int main(int argc, char *argv[])
+{
+    if(argc < 2 || (0 == strcmp(argv[1],"--help")))
+	{
+		printUsage();
+		return 1;
+	}
+	if(!parseCommandLineParameters(argc, argv))
+	{
+		return 1;
+	}
+	if(batch_input)
+	{
+		jab_int32 result = encodeBatch();
+		cleanMemory();
+		return result;
+	}
+
+    //create encode parameter object
+    jab_encode* enc = createEncodeFromParameters();
+    if(enc == NULL)
+    {
+		cleanMemory();
+        return 1;
+    }
+
+	jab_encode_stats stats;
+	if(print_stats)
+		enc->stats = &stats;
+
+	//generate JABCode, the image is written directly from the code matrix
+	if(generateJABCodeMatrix(enc, data) != 0)
+	{
+		reportError("Creating jab code failed");
+		destroyEncode(enc);
+		cleanMemory();
+		return 1;
+	}
+
+	//save bitmap in image file
+	struct timespec start, end;
+	timespec_get(&start, TIME_UTC);
+	jab_int32 result = saveCode(enc, filename) ? 0 : 1;
+	timespec_get(&end, TIME_UTC);
+	if(print_stats && result == 0)
+	{
+		printEncodeStats(&stats, (jab_double)(end.tv_sec - start.tv_sec) * 1000.0 + (jab_double)(end.tv_nsec - start.tv_nsec) / 1e6);
+	}
 
 	destroyEncode(enc);
 	cleanMemory();
 	return result;
 }
-
@@ -0,0 +1,43 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * @file jabwriter.h
+ * @brief JABCode writer header
+ */
+
+#ifndef JABCODE_WRITER_H
+#define JABCODE_WRITER_H
+
+#include <pthread.h>
+
+#define BATCH_CHUNK_SIZE	4096	//the number of messages read and encoded at a time in batch mode
+
+/**
+ * @brief Batch input formats
+*/
+typedef enum
+{
+	BATCH_LINES = 0,
+	BATCH_RECORDS,
+	BATCH_DIRECTORY
+}jab_batch_format;
+
+/**
+ * @brief Batch input source
+*/
+typedef struct {
+	FILE*			fp;				//the input file of lines or records
+	jab_char*		line;			//the line buffer
+	size_t			line_size;
+	jab_char**		files;			//the input files of the directory
+	jab_int32		file_number;
+	jab_int32		next_file;
+	jab_int32		offset;			//the index of the first message of the current chunk
+	jab_int32		saved;			//the number of saved codes
+	pthread_mutex_t	lock;
+}jab_batch_source;
+
+#endif